@@ -0,0 +1,191 @@
+#pragma once
+#include <CpuTopology.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> //_mm_pause
+#endif
+
+/*
+Helpers shared by the benchmarks. Results are written as CSV to stdout, or to the file given with --csv, so runs on different commits can be diffed.
+*/
+namespace BenchmarkUtil
+{
+	using Clock = std::chrono::steady_clock;
+
+	class Options
+	{
+	public:
+		const char* csvPath = nullptr;
+		unsigned int maxThreads;
+		unsigned int repetitions = 5u;
+		bool pin = true;
+		double scale = 1.0; //multiplies the amount of work done by every benchmark
+
+		Options(int argc, char** argv, unsigned int defaultMaxThreads = std::max(1u, std::thread::hardware_concurrency())) : maxThreads(defaultMaxThreads)
+		{
+			for (int i = 1; i < argc; ++i)
+			{
+				const bool hasValue = i + 1 < argc;
+				if (std::strcmp(argv[i], "--csv") == 0 && hasValue) csvPath = argv[++i];
+				else if (std::strcmp(argv[i], "--max-threads") == 0 && hasValue) maxThreads = std::max(1, std::atoi(argv[++i]));
+				else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue) repetitions = std::max(1, std::atoi(argv[++i]));
+				else if (std::strcmp(argv[i], "--scale") == 0 && hasValue) scale = std::atof(argv[++i]);
+				else if (std::strcmp(argv[i], "--no-pin") == 0) pin = false;
+				else
+				{
+					std::fprintf(stderr, "usage: %s [--csv file] [--max-threads n] [--repetitions n] [--scale x] [--no-pin]\n", argv[0]);
+					std::exit(1);
+				}
+			}
+		}
+
+		std::size_t scaled(std::size_t count) const noexcept
+		{
+			const double result = static_cast<double>(count) * scale;
+			return result < 1.0 ? 1u : static_cast<std::size_t>(result);
+		}
+	};
+
+	class CsvWriter
+	{
+		std::FILE* mFile;
+	public:
+		CsvWriter(const Options& options, const char* header) : mFile(stdout)
+		{
+			if (options.csvPath != nullptr)
+			{
+				mFile = std::fopen(options.csvPath, "w");
+				if (mFile == nullptr)
+				{
+					std::perror(options.csvPath);
+					std::exit(1);
+				}
+			}
+			std::fprintf(mFile, "%s\n", header);
+		}
+
+		CsvWriter(const CsvWriter&) = delete;
+		CsvWriter& operator=(const CsvWriter&) = delete;
+
+		~CsvWriter()
+		{
+			if (mFile != stdout) std::fclose(mFile);
+		}
+
+		template<class... Args>
+		void row(const char* format, Args... args)
+		{
+			std::fprintf(mFile, format, args...);
+			std::fputc('\n', mFile);
+			std::fflush(mFile);
+		}
+	};
+
+	/*
+	Pins thread index to a processor using the engine's topology order, so threads with close indices share caches like they do in TaskShedular.
+	*/
+	class Pinning
+	{
+		CpuTopology mTopology;
+		bool mEnabled;
+	public:
+		Pinning(const Options& options) : mEnabled(options.pin) {}
+
+		void pin(unsigned int index) const noexcept
+		{
+			if (mEnabled) mTopology.pinCurrentThread(index);
+		}
+
+		unsigned int processorCount() const noexcept
+		{
+			return mTopology.processorCount();
+		}
+	};
+
+	/*
+	1, 2, 4, ... up to maxThreads, always including maxThreads.
+	*/
+	inline std::vector<unsigned int> threadCounts(unsigned int maxThreads)
+	{
+		std::vector<unsigned int> counts;
+		for (unsigned int count = 1u; count < maxThreads; count *= 2u)
+		{
+			counts.push_back(count);
+		}
+		counts.push_back(maxThreads);
+		return counts;
+	}
+
+	/*
+	values must be sorted. Uses the nearest rank method.
+	*/
+	template<class T>
+	T percentile(const std::vector<T>& values, double fraction)
+	{
+		if (values.empty()) return T{};
+		std::size_t rank = static_cast<std::size_t>(fraction * static_cast<double>(values.size()));
+		if (rank >= values.size()) rank = values.size() - 1u;
+		return values[rank];
+	}
+
+	inline double milliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	/*
+	Spins for a while then yields so threads waiting on each other still make progress when there are more threads than processors.
+	*/
+	class Backoff
+	{
+		constexpr static unsigned int spinCount = 64u;
+		unsigned int mCount = 0u;
+	public:
+		void pause() noexcept
+		{
+			if (mCount < spinCount)
+			{
+				++mCount;
+#if defined(__x86_64__) || defined(__i386__)
+				_mm_pause();
+#endif
+				return;
+			}
+			std::this_thread::yield();
+		}
+
+		void reset() noexcept
+		{
+			mCount = 0u;
+		}
+	};
+
+	/*
+	Makes every thread in a run start at the same time.
+	*/
+	class StartFlag
+	{
+		std::atomic<unsigned int> mReadyCount{0u};
+		std::atomic<bool> mGo{false};
+	public:
+		void arriveAndWait() noexcept
+		{
+			mReadyCount.fetch_add(1u, std::memory_order_acq_rel);
+			while (!mGo.load(std::memory_order_acquire)) std::this_thread::yield();
+		}
+
+		void waitForAndStart(unsigned int threadCount) noexcept
+		{
+			while (mReadyCount.load(std::memory_order_acquire) != threadCount) std::this_thread::yield();
+			mGo.store(true, std::memory_order_release);
+		}
+	};
+}
@@ -0,0 +1,505 @@
+#include "BenchmarkUtil.h"
+#include <PageResourceLocation.h>
+#include <ResizingArray.h>
+#include <SwissHashSet.h>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#if defined(FEEDBACK_GATHER_SCALAR)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+Times gathering the page requests from a virtual texture feedback buffer, with the serial loop PageProvider used before and with
+PageProvider::startGatheringPageRequests, gatherPageRequestParts and finishGatheringPageRequests.
+PageProvider needs Direct3D 12 so the gathering code is copied here, with texturesByID replaced by an array of lowest pinned mips.
+The runs of identical texels are found with whatever instruction set the benchmark is built for. FeedbackGatherBenchmarkAvx2 is built with AVX2 and BMI2,
+which also changes PageResourceLocation::Hash, and FeedbackGatherBenchmarkScalar is built with FEEDBACK_GATHER_SCALAR defined so only the scalar loop is used.
+There are no recorded feedback buffers so they are made up: one looks like a frame of textured surfaces and one has random texels as a worst case.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+#if defined(FEEDBACK_GATHER_SCALAR)
+	constexpr const char* instructionSet = "scalar";
+#elif defined(__AVX2__)
+	constexpr const char* instructionSet = "AVX2";
+#elif defined(__SSE2__)
+	constexpr const char* instructionSet = "SSE2";
+#else
+	constexpr const char* instructionSet = "scalar";
+#endif
+
+	class PageRequestData
+	{
+	public:
+		unsigned long long count = 0u;
+	};
+
+	using UniqueRequests = std::unordered_map<PageResourceLocation, PageRequestData, PageResourceLocation::Hash>;
+
+	class TexturesByID
+	{
+	public:
+		unsigned int lowestPinnedMips[256];
+
+		TexturesByID()
+		{
+			for (unsigned int i = 0u; i != 256u; ++i) lowestPinnedMips[i] = 6u + i % 6u;
+		}
+	};
+
+	namespace Baseline
+	{
+		/*
+		Walks the whole feedback buffer on one thread, looking up every texel.
+		*/
+		template<class HashMap>
+		void requestMipLevels(const unsigned int lowestPinnedMip, unsigned char textureId, unsigned char mipLevel, unsigned short x, unsigned short y, HashMap& uniqueRequests)
+		{
+			if (mipLevel >= lowestPinnedMip) return;
+			x >>= mipLevel;
+			y >>= mipLevel;
+			while (true)
+			{
+				unsigned long long& count = uniqueRequests[{textureId, mipLevel, x, y}].count;
+				++count;
+				++mipLevel;
+				if (count != 1u || mipLevel == lowestPinnedMip) return;
+				x >>= 1u;
+				y >>= 1u;
+			}
+		}
+
+		void gatherPageRequests(const TexturesByID& texturesByID, UniqueRequests& uniqueRequests, const void* feadBackBuffer, unsigned long sizeInBytes)
+		{
+			const uint64_t* current = static_cast<const uint64_t*>(feadBackBuffer);
+			const uint64_t* const end = current + sizeInBytes / sizeof(uint64_t);
+			for (; current != end; ++current)
+			{
+				const uint64_t value = *current;
+				// pages are stored as textureId2, textureId3, textureId1, miplevel, y, x
+				const unsigned char mipLevel = static_cast<unsigned char>((value & 0x000000ff00000000) >> 32u);
+				const unsigned short x = static_cast<unsigned short>(value & 0x000000000000ffff);
+				const unsigned short y = static_cast<unsigned short>((value & 0x00000000ffff0000) >> 16u);
+				const unsigned char textureId1 = static_cast<unsigned char>((value & 0x0000ff0000000000) >> 40u);
+				const unsigned char textureId2 = static_cast<unsigned char>((value & 0xff00000000000000) >> 56u);
+				const unsigned char textureId3 = static_cast<unsigned char>((value & 0x00ff000000000000) >> 48u);
+				if (textureId1 != 255u) requestMipLevels(texturesByID.lowestPinnedMips[textureId1], textureId1, mipLevel, x, y, uniqueRequests);
+				if (textureId2 != 255u) requestMipLevels(texturesByID.lowestPinnedMips[textureId2], textureId2, mipLevel, x, y, uniqueRequests);
+				if (textureId3 != 255u) requestMipLevels(texturesByID.lowestPinnedMips[textureId3], textureId3, mipLevel, x, y, uniqueRequests);
+			}
+		}
+	}
+
+	template<class HashMap>
+	inline void requestMipLevels(const unsigned int lowestPinnedMip, unsigned char textureId, unsigned char mipLevel, unsigned short x, unsigned short y, unsigned long long count,
+		HashMap& uniqueRequests)
+	{
+		while (true)
+		{
+			unsigned long long& totalCount = uniqueRequests[{textureId, mipLevel, x, y}].count;
+			const bool alreadyRequested = totalCount != 0u;
+			totalCount += count;
+			++mipLevel;
+			if (alreadyRequested || mipLevel == lowestPinnedMip) return;
+			x >>= 1u;
+			y >>= 1u;
+			count = 1u;
+		}
+	}
+
+	template<class AddRun>
+	inline void forEachRun(const uint64_t* current, const uint64_t* end, AddRun&& addRun)
+	{
+		if (current == end) return;
+		uint64_t runValue = *current;
+		unsigned long long runLength = 1u;
+		++current;
+#if defined(FEEDBACK_GATHER_SCALAR)
+#elif defined(__AVX2__)
+		constexpr unsigned int laneCount = 4u;
+		constexpr unsigned int allEqual = 0xf;
+		for (; end - current >= static_cast<std::ptrdiff_t>(laneCount); current += laneCount)
+		{
+			const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+			const __m256i previousValues = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current - 1));
+			const unsigned int equal = static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(values, previousValues))));
+#elif defined(__SSE2__)
+		constexpr unsigned int laneCount = 2u;
+		constexpr unsigned int allEqual = 0x3;
+		for (; end - current >= static_cast<std::ptrdiff_t>(laneCount); current += laneCount)
+		{
+			const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+			const __m128i previousValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current - 1));
+			//SSE2 has no 64 bit compare so a lane is equal when all 8 of its bytes are
+			const unsigned int equalBytes = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi32(values, previousValues)));
+			const unsigned int equal = ((equalBytes & 0xffu) == 0xffu ? 1u : 0u) | ((equalBytes >> 8u) == 0xffu ? 2u : 0u);
+#endif
+#if !defined(FEEDBACK_GATHER_SCALAR) && (defined(__AVX2__) || defined(__SSE2__))
+			if (equal == allEqual)
+			{
+				runLength += laneCount;
+				continue;
+			}
+			for (unsigned int i = 0u; i != laneCount; ++i)
+			{
+				if (equal & (1u << i))
+				{
+					++runLength;
+				}
+				else
+				{
+					addRun(runValue, runLength);
+					runValue = current[i];
+					runLength = 1u;
+				}
+			}
+		}
+#endif
+		for (; current != end; ++current)
+		{
+			if (*current == runValue)
+			{
+				++runLength;
+			}
+			else
+			{
+				addRun(runValue, runLength);
+				runValue = *current;
+				runLength = 1u;
+			}
+		}
+		addRun(runValue, runLength);
+	}
+
+	/*
+	The gathering members of PageProvider.
+	*/
+	class FeedbackGatherer
+	{
+		class PartPageRequest
+		{
+		public:
+			PageResourceLocation location;
+			unsigned long long count;
+		};
+
+		class PartPageRequestHash
+		{
+		public:
+			std::size_t operator()(const PartPageRequest& request) const
+			{
+				return PageResourceLocation::Hash{}(request.location);
+			}
+
+			std::size_t operator()(PageResourceLocation location) const
+			{
+				return PageResourceLocation::Hash{}(location);
+			}
+		};
+
+		class PartPageRequestEqual
+		{
+		public:
+			bool operator()(const PartPageRequest& lhs, const PartPageRequest& rhs) const
+			{
+				return lhs.location == rhs.location;
+			}
+
+			bool operator()(const PartPageRequest& lhs, PageResourceLocation rhs) const
+			{
+				return lhs.location == rhs;
+			}
+		};
+
+		using PartPageRequests = SwissHashSet<PartPageRequest, PartPageRequestHash, PartPageRequestEqual>;
+		constexpr static unsigned long minTexelsPerGatherPart = 16384u;
+
+		ResizingArray<PartPageRequests> partPageRequests;
+		const uint64_t* gatherFeadBackBuffer;
+		unsigned long gatherTexelCount;
+		unsigned int gatherPartCount;
+		std::atomic<unsigned int> gatherPartsLeft{0u};
+		std::atomic<unsigned int> gatherPartsFinished{0u};
+	public:
+		const TexturesByID& texturesByID;
+		UniqueRequests uniqueRequests;
+
+		FeedbackGatherer(const TexturesByID& texturesByID) : texturesByID(texturesByID) {}
+
+		unsigned int startGatheringPageRequests(const void* feadBackBuffer, unsigned long sizeInBytes, unsigned int maxPartCount)
+		{
+			const unsigned long texelCount = sizeInBytes / sizeof(uint64_t);
+			unsigned long partCount = texelCount / minTexelsPerGatherPart;
+			if (partCount > maxPartCount) partCount = maxPartCount;
+			if (partCount == 0u) partCount = 1u;
+			while (partPageRequests.size() < partCount)
+			{
+				partPageRequests.emplace_back();
+			}
+
+			gatherFeadBackBuffer = static_cast<const uint64_t*>(feadBackBuffer);
+			gatherTexelCount = texelCount;
+			gatherPartCount = static_cast<unsigned int>(partCount);
+			gatherPartsFinished.store(0u, std::memory_order_relaxed);
+			gatherPartsLeft.store(static_cast<unsigned int>(partCount), std::memory_order_release);
+			return static_cast<unsigned int>(partCount);
+		}
+
+		bool gatherPageRequestParts()
+		{
+			bool gatheredLastPart = false;
+			unsigned int partsLeft = gatherPartsLeft.load(std::memory_order_acquire);
+			while (true)
+			{
+				if (partsLeft == 0u) return gatheredLastPart;
+				if (!gatherPartsLeft.compare_exchange_weak(partsLeft, partsLeft - 1u, std::memory_order_acquire, std::memory_order_acquire)) continue;
+				const unsigned int part = partsLeft - 1u;
+
+				const uint64_t* begin = gatherFeadBackBuffer + static_cast<std::size_t>(static_cast<unsigned long long>(gatherTexelCount) * part / gatherPartCount);
+				const uint64_t* end = gatherFeadBackBuffer + static_cast<std::size_t>(static_cast<unsigned long long>(gatherTexelCount) * (part + 1u) / gatherPartCount);
+				PartPageRequests& requests = partPageRequests[part];
+				forEachRun(begin, end, [this, &requests](uint64_t value, unsigned long long count)
+					{
+						// pages are stored as textureId2, textureId3, textureId1, miplevel, y, x
+						const unsigned char mipLevel = static_cast<unsigned char>((value & 0x000000ff00000000) >> 32u);
+						const unsigned short x = static_cast<unsigned short>(value & 0x000000000000ffff);
+						const unsigned short y = static_cast<unsigned short>((value & 0x00000000ffff0000) >> 16u);
+						const unsigned char textureIds[3] =
+						{
+							static_cast<unsigned char>((value & 0x0000ff0000000000) >> 40u),
+							static_cast<unsigned char>((value & 0xff00000000000000) >> 56u),
+							static_cast<unsigned char>((value & 0x00ff000000000000) >> 48u)
+						};
+						for (const unsigned char textureId : textureIds)
+						{
+							if (textureId == 255u) continue;
+							const unsigned int lowestPinnedMip = texturesByID.lowestPinnedMips[textureId];
+							if (mipLevel >= lowestPinnedMip) continue;
+							const unsigned short pageX = static_cast<unsigned short>(x >> mipLevel);
+							const unsigned short pageY = static_cast<unsigned short>(y >> mipLevel);
+							if (gatherPartCount == 1u)
+							{
+								//nothing to merge with so skip the part's table
+								requestMipLevels(lowestPinnedMip, textureId, mipLevel, pageX, pageY, count, uniqueRequests);
+								continue;
+							}
+							const PageResourceLocation page{ textureId, mipLevel, pageX, pageY };
+							auto request = requests.find(page);
+							if (request != requests.end())
+							{
+								request->count += count;
+							}
+							else
+							{
+								requests.insert({ page, count });
+							}
+						}
+					});
+
+				gatheredLastPart = gatherPartsFinished.fetch_add(1u, std::memory_order_acq_rel) + 1u == gatherPartCount;
+				partsLeft = gatherPartsLeft.load(std::memory_order_acquire);
+			}
+		}
+
+		void finishGatheringPageRequests()
+		{
+			for (unsigned int i = 0u; i != gatherPartCount; ++i)
+			{
+				partPageRequests[i].consume([this](PartPageRequest&& request)
+					{
+						const PageResourceLocation page = request.location;
+						requestMipLevels(texturesByID.lowestPinnedMips[page.textureId], page.textureId, page.mipLevel, page.x, page.y, request.count, uniqueRequests);
+					});
+			}
+		}
+	};
+
+	uint64_t packTexel(unsigned int x, unsigned int y, unsigned int mipLevel, unsigned int textureId1, unsigned int textureId2, unsigned int textureId3)
+	{
+		return static_cast<uint64_t>(x) | static_cast<uint64_t>(y) << 16u | static_cast<uint64_t>(mipLevel) << 32u | static_cast<uint64_t>(textureId1) << 40u |
+			static_cast<uint64_t>(textureId3) << 48u | static_cast<uint64_t>(textureId2) << 56u;
+	}
+
+	/*
+	40 rectangles of textured surfaces that get further away towards the bottom of the screen, some with a second texture.
+	*/
+	std::vector<uint64_t> makeSceneBuffer(unsigned int width, unsigned int height, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<uint64_t> buffer(width * height, packTexel(0u, 0u, 0u, 255u, 255u, 255u));
+		for (unsigned int surface = 0u; surface != 40u; ++surface)
+		{
+			const unsigned int left = random() % width;
+			const unsigned int top = random() % height;
+			const unsigned int right = std::min(width, left + 20u + static_cast<unsigned int>(random() % (width / 2u)));
+			const unsigned int bottom = std::min(height, top + 20u + static_cast<unsigned int>(random() % (height / 2u)));
+			const unsigned int textureId1 = random() % 20u;
+			const unsigned int textureId2 = random() % 3u == 0u ? 20u + random() % 10u : 255u;
+			const double scale = 0.5 + static_cast<double>(random() % 100u) / 25.0;
+			const double offsetX = static_cast<double>(random() % 4096u);
+			const double offsetY = static_cast<double>(random() % 4096u);
+			for (unsigned int y = top; y != bottom; ++y)
+			{
+				const double depth = 1.0 + static_cast<double>(y - top) * 0.02;
+				const unsigned int mipLevel = std::min(10u, static_cast<unsigned int>(std::log2(depth * scale)));
+				for (unsigned int x = left; x != right; ++x)
+				{
+					const double u = offsetX + static_cast<double>(x - left) * scale * depth * 4.0;
+					const double v = offsetY + static_cast<double>(y - top) * scale * depth * 4.0;
+					buffer[y * width + x] = packTexel(static_cast<unsigned int>(u / 128.0) & 0xffffu, static_cast<unsigned int>(v / 128.0) & 0xffffu, mipLevel, textureId1, textureId2, 255u);
+				}
+			}
+		}
+		return buffer;
+	}
+
+	std::vector<uint64_t> makeRandomBuffer(std::size_t texelCount, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<uint64_t> buffer(texelCount);
+		for (auto& texel : buffer)
+		{
+			const unsigned int x = random() % 512u;
+			const unsigned int y = random() % 512u;
+			const unsigned int mipLevel = random() % 12u;
+			const unsigned int textureId1 = random() % 5u == 0u ? 255u : random() % 30u;
+			const unsigned int textureId2 = random() % 2u != 0u ? 255u : random() % 30u;
+			const unsigned int textureId3 = random() % 3u != 0u ? 255u : random() % 30u;
+			texel = packTexel(x, y, mipLevel, textureId1, textureId2, textureId3);
+		}
+		return buffer;
+	}
+
+	Clock::duration runOld(const BenchmarkUtil::Pinning& pinning, const TexturesByID& texturesByID, const std::vector<uint64_t>& buffer, unsigned int, std::size_t frameCount,
+		UniqueRequests& uniqueRequests)
+	{
+		pinning.pin(0u);
+		const Clock::time_point startTime = Clock::now();
+		for (std::size_t frame = 0u; frame != frameCount; ++frame)
+		{
+			uniqueRequests.clear();
+			Baseline::gatherPageRequests(texturesByID, uniqueRequests, buffer.data(), static_cast<unsigned long>(buffer.size() * sizeof(uint64_t)));
+		}
+		return Clock::now() - startTime;
+	}
+
+	/*
+	Every thread gathers parts until none are left, like the tasks the renderer starts, and the one that gathers the last part finishes.
+	*/
+	Clock::duration runNew(const BenchmarkUtil::Pinning& pinning, const TexturesByID& texturesByID, const std::vector<uint64_t>& buffer, unsigned int threadCount,
+		std::size_t frameCount, UniqueRequests& uniqueRequests)
+	{
+		FeedbackGatherer gatherer(texturesByID);
+		Clock::duration time = Clock::duration::zero();
+		for (std::size_t frame = 0u; frame != frameCount; ++frame)
+		{
+			gatherer.uniqueRequests.clear();
+			const unsigned int partCount = gatherer.startGatheringPageRequests(buffer.data(), static_cast<unsigned long>(buffer.size() * sizeof(uint64_t)), threadCount);
+			if (partCount == 1u)
+			{
+				pinning.pin(0u);
+				const Clock::time_point startTime = Clock::now();
+				if (gatherer.gatherPageRequestParts()) gatherer.finishGatheringPageRequests();
+				time += Clock::now() - startTime;
+				continue;
+			}
+
+			BenchmarkUtil::StartFlag startFlag;
+			std::vector<std::thread> threads;
+			for (unsigned int i = 0u; i != partCount; ++i)
+			{
+				threads.emplace_back([&, i]()
+					{
+						pinning.pin(i);
+						startFlag.arriveAndWait();
+						if (gatherer.gatherPageRequestParts()) gatherer.finishGatheringPageRequests();
+					});
+			}
+			startFlag.waitForAndStart(partCount);
+			const Clock::time_point startTime = Clock::now();
+			for (auto& thread : threads) thread.join();
+			time += Clock::now() - startTime;
+		}
+		uniqueRequests = std::move(gatherer.uniqueRequests);
+		return time;
+	}
+
+	using Run = Clock::duration(*)(const BenchmarkUtil::Pinning& pinning, const TexturesByID& texturesByID, const std::vector<uint64_t>& buffer, unsigned int threadCount,
+		std::size_t frameCount, UniqueRequests& uniqueRequests);
+
+	bool sameRequests(const UniqueRequests& expected, const UniqueRequests& actual)
+	{
+		if (expected.size() != actual.size()) return false;
+		for (const auto& request : expected)
+		{
+			const auto pos = actual.find(request.first);
+			if (pos == actual.end() || pos->second.count != request.second.count) return false;
+		}
+		return true;
+	}
+
+	/*
+	The old and new gathering are run alternately so both see the same machine state.
+	The new gathering must give exactly the same page counts as the old one.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning, const TexturesByID& texturesByID,
+		const char* bufferName, const std::vector<uint64_t>& buffer, unsigned int threadCount, std::size_t frameCount)
+	{
+		const char* names[2] = { "Baseline::gatherPageRequests", "gatherPageRequestParts" };
+		const Run runs[2] = { runOld, runNew };
+		std::vector<double> times[2];
+		UniqueRequests uniqueRequests[2];
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			for (unsigned int i = 0u; i != 2u; ++i)
+			{
+				times[i].push_back(BenchmarkUtil::milliseconds(runs[i](pinning, texturesByID, buffer, threadCount, frameCount, uniqueRequests[i])) / static_cast<double>(frameCount));
+			}
+			if (!sameRequests(uniqueRequests[0], uniqueRequests[1]))
+			{
+				std::fprintf(stderr, "%s with %u threads gave different page counts to %s on the %s buffer\n", names[1], threadCount, names[0], bufferName);
+				succeeded = false;
+			}
+		}
+
+		//startGatheringPageRequests makes at most one part per thread and per 16384 texels.
+		const std::size_t partCounts[2] = { 1u, std::min<std::size_t>(threadCount, std::max<std::size_t>(1u, buffer.size() / 16384u)) };
+		for (unsigned int i = 0u; i != 2u; ++i)
+		{
+			std::sort(times[i].begin(), times[i].end());
+			csv.row("%s,%s,%s,%zu,%u,%zu,%u,%.3f,%zu", names[i], instructionSet, bufferName, buffer.size(), threadCount, partCounts[i], options.repetitions,
+				BenchmarkUtil::percentile(times[i], 0.5), uniqueRequests[i].size());
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "gather,instruction_set,buffer,texels,threads,parts,repetitions,median_milliseconds,unique_pages");
+
+	//The feedback buffer is a quarter of the width and height of a 1080p frame.
+	constexpr unsigned int width = 480u;
+	constexpr unsigned int height = 270u;
+	const TexturesByID texturesByID;
+	const std::vector<uint64_t> sceneBuffer = makeSceneBuffer(width, height, 0u);
+	const std::vector<uint64_t> randomBuffer = makeRandomBuffer(width * height, 9u);
+	const std::size_t frameCount = options.scaled(20u);
+	bool succeeded = true;
+	for (unsigned int threadCount : BenchmarkUtil::threadCounts(options.maxThreads))
+	{
+		succeeded = measure(csv, options, pinning, texturesByID, "scene", sceneBuffer, threadCount, frameCount) && succeeded;
+		succeeded = measure(csv, options, pinning, texturesByID, "random", randomBuffer, threadCount, std::max<std::size_t>(1u, frameCount / 10u)) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+#include "BenchmarkUtil.h"
+#include <HashSet.h>
+#include <SwissHashSet.h>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+/*
+Compares SwissHashSet, HashSet and std::unordered_map on 128 byte values looked up by a 64 bit key, like components looked up by entity.
+Each run inserts the keys into an empty container, looks every key up in a shuffled order, looks up the same number of missing keys and then erases every key.
+The element counts go up in quarter octaves so each container is measured at several load factors, and at sizes that fit in L2, in L3 and in neither.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	class Value
+	{
+	public:
+		unsigned long long key;
+		unsigned char bytes[120];
+	};
+
+	class ValueHasher
+	{
+	public:
+		std::size_t operator()(unsigned long long key) const noexcept
+		{
+			return std::hash<unsigned long long>()(key);
+		}
+
+		std::size_t operator()(const Value& value) const noexcept
+		{
+			return (*this)(value.key);
+		}
+	};
+
+	class ValueEqualTo
+	{
+	public:
+		bool operator()(const Value& value1, const Value& value2) const noexcept
+		{
+			return value1.key == value2.key;
+		}
+
+		bool operator()(const Value& value, unsigned long long key) const noexcept
+		{
+			return value.key == key;
+		}
+	};
+
+	using Payload = decltype(Value::bytes);
+
+	/*
+	Gives the three containers the same interface.
+	*/
+	template<class Set>
+	class SetAdapter
+	{
+		Set mSet;
+	public:
+		void insert(unsigned long long key)
+		{
+			Value value;
+			value.key = key;
+			std::memset(value.bytes, static_cast<int>(key), sizeof(value.bytes));
+			mSet.insert(value);
+		}
+
+		//Returns 0 if key isn't in the set, otherwise reads the value like a real lookup would.
+		unsigned int find(unsigned long long key)
+		{
+			auto pos = mSet.find(key);
+			return pos == mSet.end() ? 0u : 1u + pos->bytes[0];
+		}
+
+		void erase(unsigned long long key)
+		{
+			mSet.erase(key);
+		}
+
+		std::size_t size() const noexcept
+		{
+			return mSet.size();
+		}
+
+		//The sets don't expose their bucket count but it is loadThreshold divided by the maximum load factor.
+		double loadFactor(double maxLoadFactor) const noexcept
+		{
+			return static_cast<double>(mSet.size()) * maxLoadFactor / static_cast<double>(mSet.loadThreshold());
+		}
+	};
+
+	class HashSetAdapter : public SetAdapter<HashSet<Value, ValueHasher, ValueEqualTo>>
+	{
+	public:
+		constexpr static const char* name = "HashSet";
+
+		double loadFactor() const noexcept
+		{
+			return SetAdapter::loadFactor(0.5);
+		}
+	};
+
+	class SwissHashSetAdapter : public SetAdapter<SwissHashSet<Value, ValueHasher, ValueEqualTo>>
+	{
+	public:
+		constexpr static const char* name = "SwissHashSet";
+
+		double loadFactor() const noexcept
+		{
+			return SetAdapter::loadFactor(0.875);
+		}
+	};
+
+	class UnorderedMapAdapter
+	{
+		std::unordered_map<unsigned long long, Payload> mMap;
+	public:
+		constexpr static const char* name = "std::unordered_map";
+
+		void insert(unsigned long long key)
+		{
+			Payload& bytes = mMap[key];
+			std::memset(bytes, static_cast<int>(key), sizeof(bytes));
+		}
+
+		unsigned int find(unsigned long long key)
+		{
+			const auto pos = mMap.find(key);
+			return pos == mMap.end() ? 0u : 1u + pos->second[0];
+		}
+
+		void erase(unsigned long long key)
+		{
+			mMap.erase(key);
+		}
+
+		std::size_t size() const noexcept
+		{
+			return mMap.size();
+		}
+
+		double loadFactor() const noexcept
+		{
+			return static_cast<double>(mMap.load_factor());
+		}
+	};
+
+	class Keys
+	{
+	public:
+		std::vector<unsigned long long> inserted;
+		std::vector<unsigned long long> shuffled;
+		std::vector<unsigned long long> missing;
+
+		Keys(std::size_t count, std::mt19937_64& random) : inserted(count), missing(count)
+		{
+			//The low bit splits present and missing keys so they can't collide.
+			for (auto& key : inserted) key = random() | 1u;
+			for (auto& key : missing) key = random() & ~1ull;
+			shuffled = inserted;
+			std::shuffle(shuffled.begin(), shuffled.end(), random);
+		}
+	};
+
+	class RunResult
+	{
+	public:
+		double insertTime;
+		double hitTime;
+		double missTime;
+		double eraseTime;
+		double loadFactor;
+		bool succeeded;
+	};
+
+	double nanosecondsPerItem(Clock::duration duration, std::size_t count)
+	{
+		return std::chrono::duration<double, std::nano>(duration).count() / static_cast<double>(count);
+	}
+
+	template<class Adapter>
+	RunResult run(const Keys& keys)
+	{
+		const std::size_t count = keys.inserted.size();
+		std::unique_ptr<Adapter> adapter(new Adapter());
+		RunResult result;
+
+		const Clock::time_point insertStartTime = Clock::now();
+		for (unsigned long long key : keys.inserted) adapter->insert(key);
+		const Clock::time_point hitStartTime = Clock::now();
+		unsigned long long hitSum = 0u;
+		for (unsigned long long key : keys.shuffled) hitSum += adapter->find(key);
+		const Clock::time_point missStartTime = Clock::now();
+		unsigned long long missSum = 0u;
+		for (unsigned long long key : keys.missing) missSum += adapter->find(key);
+		const Clock::time_point eraseStartTime = Clock::now();
+		result.loadFactor = adapter->loadFactor();
+		for (unsigned long long key : keys.shuffled) adapter->erase(key);
+		const Clock::time_point endTime = Clock::now();
+
+		unsigned long long expectedHitSum = 0u;
+		for (unsigned long long key : keys.inserted) expectedHitSum += 1u + static_cast<unsigned char>(key);
+		result.succeeded = hitSum == expectedHitSum && missSum == 0u && adapter->size() == 0u;
+		result.insertTime = nanosecondsPerItem(hitStartTime - insertStartTime, count);
+		result.hitTime = nanosecondsPerItem(missStartTime - hitStartTime, count);
+		result.missTime = nanosecondsPerItem(eraseStartTime - missStartTime, count);
+		result.eraseTime = nanosecondsPerItem(endTime - eraseStartTime, count);
+		return result;
+	}
+
+	class Measurement
+	{
+	public:
+		const char* name;
+		RunResult (*run)(const Keys& keys);
+		std::vector<double> insertTimes;
+		std::vector<double> hitTimes;
+		std::vector<double> missTimes;
+		std::vector<double> eraseTimes;
+		double loadFactor;
+	};
+
+	template<class Adapter>
+	Measurement makeMeasurement()
+	{
+		Measurement measurement;
+		measurement.name = Adapter::name;
+		measurement.run = run<Adapter>;
+		return measurement;
+	}
+
+	double median(std::vector<double>& values)
+	{
+		std::sort(values.begin(), values.end());
+		return BenchmarkUtil::percentile(values, 0.5);
+	}
+
+	/*
+	The containers are run alternately so all of them see the same machine state.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, std::size_t count, std::mt19937_64& random)
+	{
+		const Keys keys(count, random);
+		Measurement measurements[] = { makeMeasurement<HashSetAdapter>(), makeMeasurement<SwissHashSetAdapter>(), makeMeasurement<UnorderedMapAdapter>() };
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			for (Measurement& measurement : measurements)
+			{
+				const RunResult result = measurement.run(keys);
+				if (!result.succeeded)
+				{
+					std::fprintf(stderr, "%s gave the wrong result with %zu values\n", measurement.name, count);
+					succeeded = false;
+				}
+				measurement.insertTimes.push_back(result.insertTime);
+				measurement.hitTimes.push_back(result.hitTime);
+				measurement.missTimes.push_back(result.missTime);
+				measurement.eraseTimes.push_back(result.eraseTime);
+				measurement.loadFactor = result.loadFactor;
+			}
+		}
+
+		for (Measurement& measurement : measurements)
+		{
+			csv.row("%s,%zu,%.3f,%u,%.1f,%.1f,%.1f,%.1f", measurement.name, count, measurement.loadFactor, options.repetitions,
+				median(measurement.insertTimes), median(measurement.hitTimes), median(measurement.missTimes), median(measurement.eraseTimes));
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	BenchmarkUtil::CsvWriter csv(options, "container,values,load_factor,repetitions,median_insert_ns,median_hit_ns,median_miss_ns,median_erase_ns");
+
+	std::mt19937_64 random(1u);
+	bool succeeded = true;
+	//4096 128 byte values are 512KiB, 32768 are 4MiB and 262144 are 32MiB.
+	for (std::size_t octave : { 4096u, 32768u, 262144u })
+	{
+		for (double step : { 1.0, 1.19, 1.41, 1.68 })
+		{
+			const std::size_t count = options.scaled(static_cast<std::size_t>(static_cast<double>(octave) * step));
+			succeeded = measure(csv, options, count, random) && succeeded;
+		}
+	}
+	return succeeded ? 0 : 1;
+}
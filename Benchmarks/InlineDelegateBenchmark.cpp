@@ -0,0 +1,246 @@
+#include "BenchmarkUtil.h"
+#include <Delegate.h>
+#include <InlineDelegate.h>
+#include <WorkStealingQueue.h>
+#include <cstdlib>
+#include <linux/perf_event.h>
+#include <new>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+Compares carrying a task's data inline in an InlineDelegate with carrying it in a Delegate that points to a request object made with new, like tasks were before InlineDelegate.
+The owner pushes a batch of tasks to a WorkStealingQueue and then pops and runs them, until every task has run. Each task carries a 24 byte range, the size ParallelFor captures.
+The heap backed tasks delete their request when they run.
+Allocations are counted by replacing the global operator new. Cache misses are read from the kernel's performance counters and left empty when they aren't available.
+*/
+namespace
+{
+	std::atomic<unsigned long long> allocationCount{0u};
+}
+
+void* operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1u, std::memory_order_relaxed);
+	void* memory = std::malloc(size == 0u ? 1u : size);
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	class ThreadResources
+	{
+	public:
+		unsigned long long sum = 0u;
+	};
+
+	class Range
+	{
+	public:
+		std::size_t begin;
+		std::size_t end;
+		void* owner;
+	};
+
+	using InlineTask = InlineDelegate<void(ThreadResources& threadResources)>;
+	using HeapTask = Delegate<void(ThreadResources& threadResources)>;
+
+	/*
+	Counts the last level cache misses of the calling thread. isAvailable is false when the kernel or machine has no hardware counters.
+	*/
+	class CacheMissCounter
+	{
+		int fileDescriptor;
+	public:
+		CacheMissCounter()
+		{
+			perf_event_attr attributes{};
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			fileDescriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+		}
+
+		~CacheMissCounter()
+		{
+			if (fileDescriptor != -1) close(fileDescriptor);
+		}
+
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+		bool isAvailable() const noexcept
+		{
+			return fileDescriptor != -1;
+		}
+
+		void start() noexcept
+		{
+			if (fileDescriptor == -1) return;
+			ioctl(fileDescriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+		}
+
+		unsigned long long stop() noexcept
+		{
+			if (fileDescriptor == -1) return 0u;
+			ioctl(fileDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+			unsigned long long count = 0u;
+			if (read(fileDescriptor, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) return 0u;
+			return count;
+		}
+	};
+
+	class InlineTasks
+	{
+	public:
+		using Task = InlineTask;
+		constexpr static const char* name = "InlineDelegate";
+
+		static Task make(std::size_t index)
+		{
+			return Task::withCaptures(Range{ index, index + 1u, nullptr }, [](void* captures, ThreadResources& threadResources)
+				{
+					const Range& range = *static_cast<const Range*>(captures);
+					threadResources.sum += range.end - range.begin;
+				});
+		}
+	};
+
+	class HeapTasks
+	{
+	public:
+		using Task = HeapTask;
+		constexpr static const char* name = "Delegate+new";
+
+		static Task make(std::size_t index)
+		{
+			return Task(new Range{ index, index + 1u, nullptr }, [](void* context, ThreadResources& threadResources)
+				{
+					Range* range = static_cast<Range*>(context);
+					threadResources.sum += range->end - range->begin;
+					delete range;
+				});
+		}
+	};
+
+	class RunResult
+	{
+	public:
+		Clock::duration time;
+		unsigned long long allocationCount;
+		unsigned long long cacheMissCount;
+		unsigned long long sum;
+	};
+
+	template<class Tasks>
+	RunResult run(CacheMissCounter& cacheMissCounter, std::size_t taskCount, std::size_t batchSize)
+	{
+		using Task = typename Tasks::Task;
+		WorkStealingQueue<Task> queue(static_cast<std::ptrdiff_t>(batchSize) + 2);
+		ThreadResources threadResources;
+		const unsigned long long startAllocationCount = allocationCount.load(std::memory_order_relaxed);
+		cacheMissCounter.start();
+		const Clock::time_point startTime = Clock::now();
+		for (std::size_t pushed = 0u; pushed != taskCount;)
+		{
+			const std::size_t count = std::min(batchSize, taskCount - pushed);
+			for (std::size_t i = 0u; i != count; ++i)
+			{
+				queue.push(Tasks::make(pushed + i));
+			}
+			pushed += count;
+			Task task;
+			while (queue.pop(task))
+			{
+				task(threadResources);
+			}
+			queue.resetIfInvalid();
+		}
+
+		RunResult result;
+		result.time = Clock::now() - startTime;
+		result.cacheMissCount = cacheMissCounter.stop();
+		result.allocationCount = allocationCount.load(std::memory_order_relaxed) - startAllocationCount;
+		result.sum = threadResources.sum;
+		return result;
+	}
+
+	using Run = RunResult(*)(CacheMissCounter& cacheMissCounter, std::size_t taskCount, std::size_t batchSize);
+
+	/*
+	The inline and heap backed tasks are run alternately so both see the same machine state.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, CacheMissCounter& cacheMissCounter, std::size_t taskCount, std::size_t batchSize)
+	{
+		const char* names[2] = { InlineTasks::name, HeapTasks::name };
+		const Run runs[2] = { run<InlineTasks>, run<HeapTasks> };
+		const std::size_t taskSizes[2] = { sizeof(InlineTask), sizeof(HeapTask) };
+		std::vector<double> times[2];
+		std::vector<double> cacheMissCounts[2];
+		unsigned long long allocationCounts[2] = {};
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			for (unsigned int i = 0u; i != 2u; ++i)
+			{
+				const RunResult result = runs[i](cacheMissCounter, taskCount, batchSize);
+				if (result.sum != taskCount)
+				{
+					std::fprintf(stderr, "%s ran %llu of %zu tasks\n", names[i], result.sum, taskCount);
+					succeeded = false;
+				}
+				times[i].push_back(BenchmarkUtil::milliseconds(result.time));
+				cacheMissCounts[i].push_back(static_cast<double>(result.cacheMissCount));
+				allocationCounts[i] = result.allocationCount;
+			}
+		}
+
+		for (unsigned int i = 0u; i != 2u; ++i)
+		{
+			std::sort(times[i].begin(), times[i].end());
+			std::sort(cacheMissCounts[i].begin(), cacheMissCounts[i].end());
+			char cacheMisses[32] = "";
+			if (cacheMissCounter.isAvailable()) std::snprintf(cacheMisses, sizeof(cacheMisses), "%.0f", BenchmarkUtil::percentile(cacheMissCounts[i], 0.5));
+			csv.row("%s,%zu,%zu,%zu,%u,%.3f,%llu,%s", names[i], taskSizes[i], batchSize, taskCount, options.repetitions, BenchmarkUtil::percentile(times[i], 0.5),
+				allocationCounts[i], cacheMisses);
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "task,task_bytes,batch,tasks,repetitions,median_milliseconds,allocations,median_cache_misses");
+
+	pinning.pin(0u);
+	CacheMissCounter cacheMissCounter;
+	if (!cacheMissCounter.isAvailable()) std::fprintf(stderr, "hardware performance counters aren't available so cache misses won't be counted\n");
+	const std::size_t taskCount = options.scaled(1u << 22);
+	bool succeeded = true;
+	//The largest batch of tasks doesn't fit in cache.
+	for (std::size_t batchSize : { 64u, 1u << 16, 1u << 20 })
+	{
+		succeeded = measure(csv, options, cacheMissCounter, taskCount, std::min(batchSize, taskCount)) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
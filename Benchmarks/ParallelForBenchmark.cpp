@@ -0,0 +1,326 @@
+#include "BenchmarkUtil.h"
+#include <InlineDelegate.h>
+#include <WorkStealingQueue.h>
+#include <BackgroundPriority.h>
+#include <cmath>
+#include <memory>
+#include <random>
+
+/*
+Measures how ParallelFor, ParallelReduce and ParallelScan scale from 1 to N threads.
+Each worker owns a WorkStealingQueue and steals from random victims when it is empty, like primary threads in TaskShedular do during a phase.
+The ParallelFor workload is the tangent and bitangent calculation MeshManager runs on loaded meshes, started both in the current phase and as background tasks.
+*/
+namespace
+{
+	class ThreadResources;
+	using Task = InlineDelegate<void(ThreadResources& threadResources)>;
+
+	class Workers;
+
+	/*
+	The parts of TaskShedular::ThreadLocal that the parallel algorithms use.
+	Background tasks go in the same queue as the benchmark only measures one phase.
+	*/
+	class TaskShedularFacade
+	{
+	public:
+		Workers* workers;
+		WorkStealingQueue<Task>* queue;
+		unsigned int threadIndex;
+
+		void pushCurrentPhaseTask(Task task) { queue->push(task); }
+		void pushBackgroundTask(Task task, BackgroundPriority) { queue->push(task); }
+		std::ptrdiff_t currentPhaseTaskCount() const noexcept { return queue->size(); }
+		bool backgroundQueueEmpty() const noexcept { return queue->size() == 0; }
+		unsigned int index() const noexcept { return threadIndex; }
+	};
+
+	class ThreadResources
+	{
+	public:
+		TaskShedularFacade taskShedular;
+	};
+}
+
+#include <ParallelFor.h>
+#include <ParallelReduce.h>
+#include <ParallelScan.h>
+
+namespace
+{
+	class Workers
+	{
+		std::unique_ptr<WorkStealingQueue<Task>[]> mQueues;
+		std::unique_ptr<ThreadResources[]> mThreadResources;
+		unsigned int mThreadCount;
+		std::atomic<bool> mDone;
+		BenchmarkUtil::Clock::time_point mEndTime;
+
+		void work(unsigned int index, const BenchmarkUtil::Pinning& pinning, BenchmarkUtil::StartFlag& startFlag)
+		{
+			pinning.pin(index);
+			ThreadResources& threadResources = mThreadResources[index];
+			std::minstd_rand random(index + 1u);
+			startFlag.arriveAndWait();
+			Task task;
+			while (!mDone.load(std::memory_order_acquire))
+			{
+				if (mQueues[index].pop(task))
+				{
+					task(threadResources);
+					continue;
+				}
+				if (mThreadCount == 1u) continue;
+				unsigned int victim = static_cast<unsigned int>(random() % (mThreadCount - 1u));
+				if (victim >= index) ++victim;
+				if (mQueues[victim].steal(task))
+				{
+					task(threadResources);
+				}
+			}
+		}
+	public:
+		Workers(unsigned int threadCount) :
+			mQueues(new WorkStealingQueue<Task>[threadCount]),
+			mThreadResources(new ThreadResources[threadCount]),
+			mThreadCount(threadCount),
+			mDone(false)
+		{
+			for (unsigned int i = 0u; i != threadCount; ++i)
+			{
+				mThreadResources[i].taskShedular = { this, &mQueues[i], i };
+			}
+		}
+
+		/*
+		Called from the callback of the algorithm being measured.
+		*/
+		void finish() noexcept
+		{
+			mEndTime = BenchmarkUtil::Clock::now();
+			mDone.store(true, std::memory_order_release);
+		}
+
+		/*
+		Runs start on thread 0 as a task, the way it would be called from a primary task, and returns the time until finish is called.
+		*/
+		template<class Start>
+		BenchmarkUtil::Clock::duration run(const BenchmarkUtil::Pinning& pinning, Start start)
+		{
+			mDone.store(false, std::memory_order_relaxed);
+			for (unsigned int i = 0u; i != mThreadCount; ++i) mQueues[i].reset();
+			BenchmarkUtil::Clock::time_point startTime;
+			auto kickOff = [&](ThreadResources& threadResources)
+			{
+				startTime = BenchmarkUtil::Clock::now();
+				start(threadResources);
+			};
+			mQueues[0].push(Task(&kickOff, [](void* context, ThreadResources& threadResources)
+				{
+					(*static_cast<decltype(kickOff)*>(context))(threadResources);
+				}));
+
+			BenchmarkUtil::StartFlag startFlag;
+			std::vector<std::thread> threads;
+			for (unsigned int i = 0u; i != mThreadCount; ++i)
+			{
+				threads.emplace_back([this, i, &pinning, &startFlag]() { work(i, pinning, startFlag); });
+			}
+			startFlag.waitForAndStart(mThreadCount);
+			for (auto& thread : threads) thread.join();
+			return mEndTime - startTime;
+		}
+	};
+
+	class Vertex
+	{
+	public:
+		float x, y, z;
+		float tu, tv;
+		float nx, ny, nz;
+	};
+
+	class VertexWithTangents
+	{
+	public:
+		float x, y, z;
+		float tu, tv;
+		float nx, ny, nz;
+		float tx, ty, tz;
+		float bx, by, bz;
+	};
+
+	/*
+	The same calculation as MeshManager::CalculateTangentBitangent.
+	*/
+	void calculateTangentBitangent(const Vertex* triangles, VertexWithTangents* output, std::size_t begin, std::size_t end)
+	{
+		for (std::size_t triangle = begin; triangle != end; ++triangle)
+		{
+			const Vertex* vertices = triangles + triangle * 3u;
+			const float vector1[3] = { vertices[1].x - vertices[0].x, vertices[1].y - vertices[0].y, vertices[1].z - vertices[0].z };
+			const float vector2[3] = { vertices[2].x - vertices[0].x, vertices[2].y - vertices[0].y, vertices[2].z - vertices[0].z };
+			const float tuVector[2] = { vertices[1].tu - vertices[0].tu, vertices[2].tu - vertices[0].tu };
+			const float tvVector[2] = { vertices[1].tv - vertices[0].tv, vertices[2].tv - vertices[0].tv };
+
+			float tangent[3], bitangent[3];
+			for (unsigned int i = 0u; i != 3u; ++i)
+			{
+				tangent[i] = tvVector[1] * vector1[i] - tvVector[0] * vector2[i];
+				bitangent[i] = tuVector[0] * vector2[i] - tuVector[1] * vector1[i];
+			}
+			const float oneOverTangentLength = 1.0f / std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+			const float oneOverBitangentLength = 1.0f / std::sqrt(bitangent[0] * bitangent[0] + bitangent[1] * bitangent[1] + bitangent[2] * bitangent[2]);
+
+			for (unsigned int i = 0u; i != 3u; ++i)
+			{
+				VertexWithTangents& out = output[triangle * 3u + i];
+				out.x = vertices[i].x; out.y = vertices[i].y; out.z = vertices[i].z;
+				out.tu = vertices[i].tu; out.tv = vertices[i].tv;
+				out.nx = vertices[i].nx; out.ny = vertices[i].ny; out.nz = vertices[i].nz;
+				out.tx = tangent[0] * oneOverTangentLength; out.ty = tangent[1] * oneOverTangentLength; out.tz = tangent[2] * oneOverTangentLength;
+				out.bx = bitangent[0] * oneOverBitangentLength; out.by = bitangent[1] * oneOverBitangentLength; out.bz = bitangent[2] * oneOverBitangentLength;
+			}
+		}
+	}
+
+	class Data
+	{
+	public:
+		std::vector<Vertex> triangles;
+		std::vector<VertexWithTangents> vertices;
+		std::vector<unsigned int> values;
+		std::vector<unsigned long long> prefixSums;
+		Workers* workers;
+	};
+	Data data;
+
+	class Result
+	{
+	public:
+		const char* benchmark;
+		std::size_t iterations;
+		std::size_t grainSize;
+	};
+
+	void writeRow(BenchmarkUtil::CsvWriter& csv, const Result& result, unsigned int threadCount, std::vector<BenchmarkUtil::Clock::duration>& times, double& singleThreadMedian)
+	{
+		std::sort(times.begin(), times.end());
+		const double minimum = BenchmarkUtil::milliseconds(times.front());
+		const double median = BenchmarkUtil::milliseconds(BenchmarkUtil::percentile(times, 0.5));
+		if (threadCount == 1u) singleThreadMedian = median;
+		const double speedup = singleThreadMedian / median;
+		csv.row("%s,%u,%zu,%zu,%zu,%.4f,%.4f,%.3f,%.3f", result.benchmark, threadCount, result.iterations, result.grainSize, times.size(),
+			minimum, median, speedup, speedup / threadCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "benchmark,threads,iterations,grain_size,repetitions,min_ms,median_ms,speedup,efficiency");
+
+	const std::size_t triangleCount = options.scaled(1u << 20);
+	const std::size_t valueCount = options.scaled(1u << 24);
+	std::minstd_rand random(1u);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	data.triangles.resize(triangleCount * 3u);
+	for (Vertex& vertex : data.triangles)
+	{
+		vertex = { distribution(random), distribution(random), distribution(random), distribution(random), distribution(random),
+			distribution(random), distribution(random), distribution(random) };
+	}
+	data.vertices.resize(triangleCount * 3u);
+	data.values.resize(valueCount);
+	for (unsigned int& value : data.values) value = static_cast<unsigned int>(random() & 0xffu);
+	data.prefixSums.resize(valueCount);
+
+	constexpr std::size_t trianglesPerTask = 1024u; //the same as MeshManager
+	constexpr std::size_t reduceGrainSize = 16384u;
+	constexpr std::size_t scanBlockSize = 16384u;
+	unsigned long long expectedSum = 0u;
+	for (unsigned int value : data.values) expectedSum += value;
+
+	std::vector<unsigned int> threadCounts = BenchmarkUtil::threadCounts(options.maxThreads);
+	double parallelForBaseline = 0.0, backgroundParallelForBaseline = 0.0, parallelReduceBaseline = 0.0, parallelScanBaseline = 0.0;
+	for (unsigned int threadCount : threadCounts)
+	{
+		Workers workers(threadCount);
+		data.workers = &workers;
+
+		ParallelFor<ThreadResources> parallelFor(trianglesPerTask,
+			[](ParallelFor<ThreadResources>&, ThreadResources&, std::size_t begin, std::size_t end)
+			{
+				calculateTangentBitangent(data.triangles.data(), data.vertices.data(), begin, end);
+			},
+			[](ParallelFor<ThreadResources>&, ThreadResources&)
+			{
+				data.workers->finish();
+			});
+
+		unsigned long long reduceResult = 0u;
+		ParallelReduce<ThreadResources, unsigned long long> parallelReduce(threadCount, reduceGrainSize, 0u,
+			[](ParallelReduce<ThreadResources, unsigned long long>&, ThreadResources&, std::size_t begin, std::size_t end, unsigned long long& accumulator)
+			{
+				for (std::size_t i = begin; i != end; ++i) accumulator += data.values[i];
+			},
+			[](const unsigned long long& lhs, const unsigned long long& rhs) { return lhs + rhs; },
+			[](ParallelReduce<ThreadResources, unsigned long long>&, ThreadResources&, unsigned long long result)
+			{
+				data.prefixSums[0] = result; //checked after the run
+				data.workers->finish();
+			});
+
+		ParallelScan<ThreadResources, unsigned long long> parallelScan(threadCount, scanBlockSize, 0u,
+			[](ParallelScan<ThreadResources, unsigned long long>&, ThreadResources&, std::size_t begin, std::size_t end)
+			{
+				unsigned long long sum = 0u;
+				for (std::size_t i = begin; i != end; ++i) sum += data.values[i];
+				return sum;
+			},
+			[](ParallelScan<ThreadResources, unsigned long long>&, ThreadResources&, std::size_t begin, std::size_t end, const unsigned long long& prefix)
+			{
+				unsigned long long sum = prefix;
+				for (std::size_t i = begin; i != end; ++i)
+				{
+					sum += data.values[i];
+					data.prefixSums[i] = sum;
+				}
+			},
+			[](const unsigned long long& lhs, const unsigned long long& rhs) { return lhs + rhs; },
+			[](ParallelScan<ThreadResources, unsigned long long>&, ThreadResources&, const unsigned long long&)
+			{
+				data.workers->finish();
+			});
+
+		std::vector<BenchmarkUtil::Clock::duration> parallelForTimes, backgroundParallelForTimes, parallelReduceTimes, parallelScanTimes;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			parallelForTimes.push_back(workers.run(pinning, [&](ThreadResources& threadResources) { parallelFor.start(threadResources, 0u, triangleCount); }));
+			backgroundParallelForTimes.push_back(workers.run(pinning, [&](ThreadResources& threadResources) { parallelFor.startBackground(threadResources, 0u, triangleCount); }));
+
+			parallelReduceTimes.push_back(workers.run(pinning, [&](ThreadResources& threadResources) { parallelReduce.start(threadResources, 0u, valueCount); }));
+			reduceResult = data.prefixSums[0];
+			if (reduceResult != expectedSum)
+			{
+				std::fprintf(stderr, "ParallelReduce returned %llu instead of %llu\n", reduceResult, expectedSum);
+				return 1;
+			}
+
+			parallelScanTimes.push_back(workers.run(pinning, [&](ThreadResources& threadResources) { parallelScan.start(threadResources, 0u, valueCount); }));
+			if (data.prefixSums[valueCount - 1u] != expectedSum)
+			{
+				std::fprintf(stderr, "ParallelScan ended with %llu instead of %llu\n", data.prefixSums[valueCount - 1u], expectedSum);
+				return 1;
+			}
+		}
+
+		writeRow(csv, { "ParallelFor tangents", triangleCount, trianglesPerTask }, threadCount, parallelForTimes, parallelForBaseline);
+		writeRow(csv, { "ParallelFor tangents background", triangleCount, trianglesPerTask }, threadCount, backgroundParallelForTimes, backgroundParallelForBaseline);
+		writeRow(csv, { "ParallelReduce sum", valueCount, reduceGrainSize }, threadCount, parallelReduceTimes, parallelReduceBaseline);
+		writeRow(csv, { "ParallelScan prefix sum", valueCount, scanBlockSize }, threadCount, parallelScanTimes, parallelScanBaseline);
+	}
+	return 0;
+}
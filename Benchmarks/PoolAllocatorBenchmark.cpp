@@ -0,0 +1,155 @@
+#include "BenchmarkUtil.h"
+#include <PoolAllocated.h>
+#include <SinglyLinked.h>
+#include <UnorderedMultiProducerSingleConsumerQueue.h>
+#include <memory>
+
+/*
+Measures PoolAllocated against the global operator new when objects are made on one thread and deleted on another, like streaming requests.
+Each pair of threads has a producer that news requests and pushes them to a queue and a consumer that pops and deletes them.
+Producers stop when too many of their requests haven't been deleted yet so memory use stays bounded.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	template<std::size_t size>
+	class HeapRequest : public SinglyLinked
+	{
+	public:
+		unsigned char bytes[size - sizeof(SinglyLinked)];
+	};
+
+	template<std::size_t size>
+	class PoolRequest : public HeapRequest<size>, public PoolAllocated {};
+
+	/*
+	Everything one producer and consumer pair share, on its own cache lines.
+	*/
+	class alignas(64) Pair
+	{
+	public:
+		UnorderedMultiProducerSingleConsumerQueue queue;
+		alignas(64) std::atomic<std::size_t> deletedCount{0u};
+		unsigned long long checksum = 0u;
+	};
+
+	template<class Request>
+	Clock::duration run(const BenchmarkUtil::Pinning& pinning, unsigned int pairCount, std::size_t requestsPerPair, bool& succeeded)
+	{
+		constexpr std::size_t maxLiveRequests = 4096u;
+		constexpr std::size_t publishInterval = 64u;
+		std::unique_ptr<Pair[]> pairs(new Pair[pairCount]);
+		const unsigned int threadCount = pairCount * 2u;
+		BenchmarkUtil::StartFlag startFlag;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0u; i != threadCount; ++i)
+		{
+			threads.emplace_back([&, i]()
+				{
+					pinning.pin(i);
+					Pair& pair = pairs[i / 2u];
+					BenchmarkUtil::Backoff backoff;
+					startFlag.arriveAndWait();
+					if (i % 2u == 0u)
+					{
+						for (std::size_t made = 0u; made != requestsPerPair; ++made)
+						{
+							while (made - pair.deletedCount.load(std::memory_order_acquire) >= maxLiveRequests) backoff.pause();
+							backoff.reset();
+							Request* request = new Request;
+							request->bytes[0] = static_cast<unsigned char>(made);
+							pair.queue.push(request);
+						}
+					}
+					else
+					{
+						std::size_t deletedCount = 0u;
+						std::size_t unpublishedCount = 0u;
+						while (deletedCount != requestsPerPair)
+						{
+							SinglyLinked* node = pair.queue.popAll();
+							if (node == nullptr)
+							{
+								backoff.pause();
+								continue;
+							}
+							backoff.reset();
+							while (node != nullptr)
+							{
+								Request* request = static_cast<Request*>(node);
+								node = node->next;
+								pair.checksum += request->bytes[0];
+								delete request;
+								++deletedCount;
+								if (++unpublishedCount == publishInterval)
+								{
+									pair.deletedCount.fetch_add(unpublishedCount, std::memory_order_release);
+									unpublishedCount = 0u;
+								}
+							}
+						}
+						pair.deletedCount.fetch_add(unpublishedCount, std::memory_order_release);
+					}
+				});
+		}
+		startFlag.waitForAndStart(threadCount);
+		const Clock::time_point startTime = Clock::now();
+		for (auto& thread : threads) thread.join();
+		const Clock::duration time = Clock::now() - startTime;
+
+		//Requests are numbered from 0 on every pair and only the low byte is kept.
+		unsigned long long expectedChecksum = 0u;
+		for (std::size_t i = 0u; i != requestsPerPair; ++i) expectedChecksum += static_cast<unsigned char>(i);
+		for (unsigned int i = 0u; i != pairCount; ++i)
+		{
+			if (pairs[i].checksum != expectedChecksum) succeeded = false;
+		}
+		return time;
+	}
+
+	/*
+	The global heap and the pool are run alternately so both see the same machine state.
+	*/
+	template<std::size_t size>
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning, unsigned int pairCount, std::size_t requestsPerPair)
+	{
+		std::vector<double> throughputs[2];
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			const Clock::duration times[2] = { run<HeapRequest<size>>(pinning, pairCount, requestsPerPair, succeeded), run<PoolRequest<size>>(pinning, pairCount, requestsPerPair, succeeded) };
+			for (unsigned int i = 0u; i != 2u; ++i)
+			{
+				throughputs[i].push_back(static_cast<double>(requestsPerPair * pairCount) / BenchmarkUtil::milliseconds(times[i]) / 1000.0);
+			}
+		}
+		if (!succeeded) std::fprintf(stderr, "a consumer didn't delete the requests its producer made\n");
+
+		const char* names[2] = { "new", "PoolAllocated" };
+		for (unsigned int i = 0u; i != 2u; ++i)
+		{
+			std::sort(throughputs[i].begin(), throughputs[i].end());
+			csv.row("%s,%u,%zu,%zu,%u,%.3f", names[i], pairCount, sizeof(PoolRequest<size>), requestsPerPair, options.repetitions, BenchmarkUtil::percentile(throughputs[i], 0.5));
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "allocator,pairs,object_bytes,objects_per_pair,repetitions,median_million_objects_per_second");
+
+	const std::size_t requestsPerPair = options.scaled(1u << 20);
+	bool succeeded = true;
+	for (unsigned int pairCount : BenchmarkUtil::threadCounts(std::max(1u, options.maxThreads / 2u)))
+	{
+		//The sizes fall in the smallest, a middle and the largest of PoolAllocated's size classes.
+		succeeded = measure<64u>(csv, options, pinning, pairCount, requestsPerPair) && succeeded;
+		succeeded = measure<224u>(csv, options, pinning, pairCount, requestsPerPair) && succeeded;
+		succeeded = measure<1024u>(csv, options, pinning, pairCount, requestsPerPair) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,440 @@
+#include "BenchmarkUtil.h"
+#include <ActorQueue.h>
+#include <UnorderedMultiProducerSingleConsumerQueue.h>
+#include <MultiProducerSingleConsumerQueue.h>
+#include <SingleProducerSingleConsumerQueue.h>
+#include <SingleProducerMultiConsumerQueue.h>
+#include <WorkStealingQueue.h>
+#include <memory>
+
+/*
+Measures the throughput and latency of the engine's concurrent queues with different numbers of producers, consumers and payload sizes.
+Producers stamp each payload with the time it was pushed and consumers record how long it took to reach them, so latency includes time spent queued.
+Linked queues are given nodes allocated before the run so allocation isn't measured.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	template<std::size_t size>
+	class Payload
+	{
+		static_assert(size > sizeof(Clock::rep), "A payload needs room for its push time");
+	public:
+		Clock::rep pushTime;
+		unsigned char bytes[size - sizeof(Clock::rep)];
+
+		void fill(Clock::rep time) noexcept
+		{
+			pushTime = time;
+			std::memset(bytes, static_cast<int>(time), sizeof(bytes));
+		}
+	};
+
+	template<std::size_t size>
+	class Node : public SinglyLinked
+	{
+	public:
+		Payload<size> payload;
+	};
+
+	template<std::size_t size>
+	class AtomicNode : public AtomicSinglyLinked
+	{
+	public:
+		Payload<size> payload;
+	};
+
+	/*
+	What one consumer saw during a run.
+	*/
+	class Consumer
+	{
+	public:
+		std::vector<Clock::rep> latencies;
+		unsigned long long checksum = 0u;
+
+		Consumer(std::size_t expectedCount)
+		{
+			latencies.reserve(expectedCount);
+		}
+
+		template<std::size_t size>
+		void receive(const Payload<size>& payload, Clock::rep now)
+		{
+			latencies.push_back(now - payload.pushTime);
+			checksum += payload.bytes[sizeof(payload.bytes) - 1u];
+		}
+	};
+
+	class Config
+	{
+	public:
+		const char* queue;
+		unsigned int producerCount;
+		unsigned int consumerCount;
+		std::size_t messageCount; //total over all producers
+	};
+
+	class RunResult
+	{
+	public:
+		Clock::duration time;
+		std::vector<std::unique_ptr<Consumer>> consumers;
+	};
+
+	Clock::rep now() noexcept
+	{
+		return Clock::now().time_since_epoch().count();
+	}
+
+	/*
+	Starts the consumers on thread indices 0 to consumerCount - 1 and the producers after them and times from when they are all ready until they have all finished.
+	*/
+	template<class Produce, class Consume>
+	RunResult runThreads(const BenchmarkUtil::Pinning& pinning, const Config& config, Produce produce, Consume consume)
+	{
+		RunResult result;
+		for (unsigned int i = 0u; i != config.consumerCount; ++i)
+		{
+			result.consumers.emplace_back(new Consumer(config.messageCount));
+		}
+		const unsigned int threadCount = config.consumerCount + config.producerCount;
+		BenchmarkUtil::StartFlag startFlag;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0u; i != threadCount; ++i)
+		{
+			threads.emplace_back([&, i]()
+				{
+					pinning.pin(i);
+					startFlag.arriveAndWait();
+					if (i < config.consumerCount) consume(i, *result.consumers[i]);
+					else produce(i - config.consumerCount);
+				});
+		}
+		startFlag.waitForAndStart(threadCount);
+		const Clock::time_point startTime = Clock::now();
+		for (auto& thread : threads) thread.join();
+		result.time = Clock::now() - startTime;
+		return result;
+	}
+
+	template<std::size_t size>
+	RunResult runSingleProducerSingleConsumer(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		using Queue = SingleProducerSingleConsumerQueue<Payload<size>, 1024u>;
+		std::unique_ptr<Queue> queue(new Queue());
+		return runThreads(pinning, config,
+			[&](unsigned int)
+			{
+				BenchmarkUtil::Backoff backoff;
+				Payload<size> payload;
+				for (std::size_t i = 0u; i != config.messageCount; ++i)
+				{
+					payload.fill(now());
+					while (!queue->tryPush(payload)) backoff.pause();
+					backoff.reset();
+				}
+			},
+			[&](unsigned int, Consumer& consumer)
+			{
+				BenchmarkUtil::Backoff backoff;
+				Payload<size> payload;
+				std::size_t receivedCount = 0u;
+				while (receivedCount != config.messageCount)
+				{
+					if (queue->pop(payload))
+					{
+						consumer.receive(payload, now());
+						++receivedCount;
+						backoff.reset();
+					}
+					else backoff.pause();
+				}
+			});
+	}
+
+	template<std::size_t size>
+	RunResult runSingleProducerMultiConsumer(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		constexpr std::size_t capacity = 1u << 16;
+		//Consumers add to consumedCount in batches so it doesn't become the most contended line. It never exceeds the real count so the producer stays in bounds.
+		constexpr std::size_t publishInterval = 32u;
+		SingleProducerMultiConsumerQueue<Payload<size>> queue(capacity);
+		std::atomic<std::size_t> consumedCount{0u};
+		std::atomic<bool> producerDone{false};
+		return runThreads(pinning, config,
+			[&](unsigned int)
+			{
+				BenchmarkUtil::Backoff backoff;
+				Payload<size> payload;
+				for (std::size_t i = 0u; i != config.messageCount; ++i)
+				{
+					while (i - consumedCount.load(std::memory_order_acquire) >= capacity - publishInterval * config.consumerCount) backoff.pause();
+					backoff.reset();
+					payload.fill(now());
+					queue.push(payload);
+				}
+				producerDone.store(true, std::memory_order_release);
+			},
+			[&](unsigned int, Consumer& consumer)
+			{
+				BenchmarkUtil::Backoff backoff;
+				Payload<size> payload;
+				std::size_t unpublishedCount = 0u;
+				while (true)
+				{
+					const bool done = producerDone.load(std::memory_order_acquire);
+					if (queue.pop(payload))
+					{
+						consumer.receive(payload, now());
+						if (++unpublishedCount == publishInterval)
+						{
+							consumedCount.fetch_add(unpublishedCount, std::memory_order_release);
+							unpublishedCount = 0u;
+						}
+						backoff.reset();
+					}
+					else if (done) break;
+					else backoff.pause();
+				}
+			});
+	}
+
+	/*
+	The owner pushes a batch of tasks and then pops until its queue is empty while the other consumers steal, like a primary thread in a phase.
+	The owner is consumer 0 and there is no separate producer.
+	*/
+	template<std::size_t size>
+	RunResult runWorkStealing(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		constexpr std::size_t batchSize = 64u;
+		WorkStealingQueue<Payload<size>> queue(batchSize * 2u);
+		std::atomic<bool> ownerDone{false};
+		Config ownerConfig = config;
+		ownerConfig.producerCount = 0u;
+		return runThreads(pinning, ownerConfig,
+			[](unsigned int) {},
+			[&](unsigned int index, Consumer& consumer)
+			{
+				Payload<size> payload;
+				if (index == 0u)
+				{
+					for (std::size_t pushed = 0u; pushed != config.messageCount;)
+					{
+						const std::size_t batchEnd = std::min(config.messageCount, pushed + batchSize);
+						for (; pushed != batchEnd; ++pushed)
+						{
+							payload.fill(now());
+							queue.push(payload);
+						}
+						while (queue.pop(payload)) consumer.receive(payload, now());
+					}
+					ownerDone.store(true, std::memory_order_release);
+					return;
+				}
+				BenchmarkUtil::Backoff backoff;
+				while (true)
+				{
+					const bool done = ownerDone.load(std::memory_order_acquire);
+					if (queue.steal(payload))
+					{
+						consumer.receive(payload, now());
+						backoff.reset();
+					}
+					else if (done) break;
+					else backoff.pause();
+				}
+			});
+	}
+
+	template<std::size_t size>
+	RunResult runMultiProducerSingleConsumer(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		const std::size_t messagesPerProducer = config.messageCount / config.producerCount;
+		std::unique_ptr<AtomicNode<size>[]> nodes(new AtomicNode<size>[config.messageCount + 1u]);
+		MultiProducerSingleConsumerQueue queue(&nodes[config.messageCount]);
+		return runThreads(pinning, config,
+			[&](unsigned int index)
+			{
+				AtomicNode<size>* producerNodes = &nodes[index * messagesPerProducer];
+				for (std::size_t i = 0u; i != messagesPerProducer; ++i)
+				{
+					producerNodes[i].payload.fill(now());
+					queue.push(&producerNodes[i]);
+				}
+			},
+			[&](unsigned int, Consumer& consumer)
+			{
+				BenchmarkUtil::Backoff backoff;
+				std::size_t receivedCount = 0u;
+				while (receivedCount != config.messageCount)
+				{
+					const auto result = queue.pop();
+					if (result.dataNode != nullptr)
+					{
+						consumer.receive(static_cast<AtomicNode<size>*>(result.dataNode)->payload, now());
+						++receivedCount;
+						backoff.reset();
+					}
+					else backoff.pause();
+				}
+			});
+	}
+
+	template<std::size_t size>
+	RunResult runUnorderedMultiProducerSingleConsumer(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		const std::size_t messagesPerProducer = config.messageCount / config.producerCount;
+		std::unique_ptr<Node<size>[]> nodes(new Node<size>[config.messageCount]);
+		UnorderedMultiProducerSingleConsumerQueue queue;
+		return runThreads(pinning, config,
+			[&](unsigned int index)
+			{
+				Node<size>* producerNodes = &nodes[index * messagesPerProducer];
+				for (std::size_t i = 0u; i != messagesPerProducer; ++i)
+				{
+					producerNodes[i].payload.fill(now());
+					queue.push(&producerNodes[i]);
+				}
+			},
+			[&](unsigned int, Consumer& consumer)
+			{
+				BenchmarkUtil::Backoff backoff;
+				std::size_t receivedCount = 0u;
+				while (receivedCount != config.messageCount)
+				{
+					SinglyLinked* node = queue.popAll();
+					if (node == nullptr)
+					{
+						backoff.pause();
+						continue;
+					}
+					backoff.reset();
+					const Clock::rep receiveTime = now();
+					for (; node != nullptr; node = node->next)
+					{
+						consumer.receive(static_cast<Node<size>*>(node)->payload, receiveTime);
+						++receivedCount;
+					}
+				}
+			});
+	}
+
+	/*
+	The producer whose push finds the actor stopped resumes it by setting a flag the consumer waits on, standing in for starting the actor's task.
+	*/
+	template<std::size_t size>
+	RunResult runActor(const BenchmarkUtil::Pinning& pinning, const Config& config)
+	{
+		const std::size_t messagesPerProducer = config.messageCount / config.producerCount;
+		std::unique_ptr<Node<size>[]> nodes(new Node<size>[config.messageCount]);
+		ActorQueue queue;
+		std::atomic<bool> resumed{false};
+		return runThreads(pinning, config,
+			[&](unsigned int index)
+			{
+				Node<size>* producerNodes = &nodes[index * messagesPerProducer];
+				for (std::size_t i = 0u; i != messagesPerProducer; ++i)
+				{
+					producerNodes[i].payload.fill(now());
+					if (queue.push(&producerNodes[i])) resumed.store(true, std::memory_order_release);
+				}
+			},
+			[&](unsigned int, Consumer& consumer)
+			{
+				BenchmarkUtil::Backoff backoff;
+				std::size_t receivedCount = 0u;
+				while (receivedCount != config.messageCount)
+				{
+					while (!resumed.exchange(false, std::memory_order_acquire)) backoff.pause();
+					backoff.reset();
+					while (true)
+					{
+						SinglyLinked* node = queue.popAll();
+						if (node == nullptr)
+						{
+							if (queue.stop()) break;
+							continue;
+						}
+						const Clock::rep receiveTime = now();
+						for (; node != nullptr; node = node->next)
+						{
+							consumer.receive(static_cast<Node<size>*>(node)->payload, receiveTime);
+							++receivedCount;
+						}
+					}
+				}
+			});
+	}
+
+	double nanoseconds(Clock::rep ticks)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::duration(ticks)).count();
+	}
+
+	template<std::size_t size, class Run>
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning, Config config, Run run)
+	{
+		config.messageCount -= config.messageCount % config.producerCount;
+		std::vector<double> throughputs;
+		std::vector<Clock::rep> latencies;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			RunResult result = run(pinning, config);
+			std::size_t receivedCount = 0u;
+			for (auto& consumer : result.consumers)
+			{
+				receivedCount += consumer->latencies.size();
+				latencies.insert(latencies.end(), consumer->latencies.begin(), consumer->latencies.end());
+			}
+			if (receivedCount != config.messageCount)
+			{
+				std::fprintf(stderr, "%s received %zu of %zu messages\n", config.queue, receivedCount, config.messageCount);
+				return false;
+			}
+			throughputs.push_back(static_cast<double>(config.messageCount) / BenchmarkUtil::milliseconds(result.time) / 1000.0);
+		}
+		std::sort(throughputs.begin(), throughputs.end());
+		std::sort(latencies.begin(), latencies.end());
+		csv.row("%s,%u,%u,%zu,%zu,%u,%.3f,%.0f,%.0f,%.0f", config.queue, config.producerCount, config.consumerCount, size, config.messageCount, options.repetitions,
+			BenchmarkUtil::percentile(throughputs, 0.5), nanoseconds(BenchmarkUtil::percentile(latencies, 0.5)),
+			nanoseconds(BenchmarkUtil::percentile(latencies, 0.99)), nanoseconds(BenchmarkUtil::percentile(latencies, 0.999)));
+		return true;
+	}
+
+	template<std::size_t size>
+	bool measureAll(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning)
+	{
+		const std::size_t messageCount = options.scaled(1u << 18);
+		//One thread is left for the other side of the queue.
+		const std::vector<unsigned int> sideCounts = BenchmarkUtil::threadCounts(std::max(1u, options.maxThreads - 1u));
+
+		bool succeeded = measure<size>(csv, options, pinning, { "SingleProducerSingleConsumerQueue", 1u, 1u, messageCount }, runSingleProducerSingleConsumer<size>);
+		for (unsigned int consumerCount : sideCounts)
+		{
+			succeeded = succeeded && measure<size>(csv, options, pinning, { "SingleProducerMultiConsumerQueue", 1u, consumerCount, messageCount }, runSingleProducerMultiConsumer<size>);
+		}
+		for (unsigned int threadCount : BenchmarkUtil::threadCounts(options.maxThreads))
+		{
+			succeeded = succeeded && measure<size>(csv, options, pinning, { "WorkStealingQueue", 1u, threadCount, messageCount }, runWorkStealing<size>);
+		}
+		for (unsigned int producerCount : sideCounts)
+		{
+			succeeded = succeeded && measure<size>(csv, options, pinning, { "MultiProducerSingleConsumerQueue", producerCount, 1u, messageCount }, runMultiProducerSingleConsumer<size>);
+			succeeded = succeeded && measure<size>(csv, options, pinning, { "UnorderedMultiProducerSingleConsumerQueue", producerCount, 1u, messageCount }, runUnorderedMultiProducerSingleConsumer<size>);
+			succeeded = succeeded && measure<size>(csv, options, pinning, { "ActorQueue", producerCount, 1u, messageCount }, runActor<size>);
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "queue,producers,consumers,payload_bytes,messages,repetitions,median_million_messages_per_second,p50_latency_ns,p99_latency_ns,p999_latency_ns");
+
+	const bool succeeded = measureAll<16u>(csv, options, pinning) && measureAll<64u>(csv, options, pinning) && measureAll<256u>(csv, options, pinning);
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include "BenchmarkUtil.h"
+#include "Baseline/ThreadBarrier.h"
+#include <ThreadBarrier.h>
+#include <memory>
+
+/*
+Compares how long ThreadBarrier::sync takes with the mutex and condition variable barrier it replaced.
+Every thread calls sync in a loop with no work in between, so the time per phase is the cost of the barrier itself.
+Each thread also times its own calls to sync. The last thread to arrive returns quickly, the others measure how long it takes to be woken.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	class RunResult
+	{
+	public:
+		Clock::duration time;
+		std::vector<Clock::rep> syncTimes;
+		bool succeeded;
+	};
+
+	template<class Barrier>
+	RunResult run(const BenchmarkUtil::Pinning& pinning, unsigned int threadCount, std::size_t phaseCount)
+	{
+		std::unique_ptr<Barrier> barrier(new Barrier(threadCount));
+		std::vector<std::vector<Clock::rep>> syncTimes(threadCount);
+		std::atomic<std::size_t> arrivedCount{0u};
+		std::size_t finishedPhaseCount = 0u;
+		bool succeeded = true;
+		BenchmarkUtil::StartFlag startFlag;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0u; i != threadCount; ++i)
+		{
+			threads.emplace_back([&, i]()
+				{
+					pinning.pin(i);
+					std::vector<Clock::rep>& times = syncTimes[i];
+					times.reserve(phaseCount);
+					typename Barrier::ThreadLocal threadLocal;
+					barrier->startCannotLeave(threadLocal);
+					startFlag.arriveAndWait();
+					for (std::size_t phase = 0u; phase != phaseCount; ++phase)
+					{
+						arrivedCount.fetch_add(1u, std::memory_order_relaxed);
+						const Clock::time_point syncStartTime = Clock::now();
+						barrier->sync([&]()
+							{
+								//Every thread must have arrived before the last one ends the phase.
+								++finishedPhaseCount;
+								if (arrivedCount.load(std::memory_order_relaxed) != finishedPhaseCount * threadCount) succeeded = false;
+							});
+						times.push_back((Clock::now() - syncStartTime).count());
+					}
+				});
+		}
+		startFlag.waitForAndStart(threadCount);
+		const Clock::time_point startTime = Clock::now();
+		for (auto& thread : threads) thread.join();
+
+		RunResult result;
+		result.time = Clock::now() - startTime;
+		result.succeeded = succeeded && finishedPhaseCount == phaseCount;
+		for (auto& times : syncTimes)
+		{
+			result.syncTimes.insert(result.syncTimes.end(), times.begin(), times.end());
+		}
+		return result;
+	}
+
+	using Run = RunResult(*)(const BenchmarkUtil::Pinning& pinning, unsigned int threadCount, std::size_t phaseCount);
+
+	double nanoseconds(Clock::rep ticks)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::duration(ticks)).count();
+	}
+
+	/*
+	The old and new barriers are run alternately so both see the same machine state.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning, unsigned int threadCount, std::size_t phaseCount)
+	{
+		const char* names[2] = { "Baseline::ThreadBarrier", "ThreadBarrier" };
+		const Run runs[2] = { run<Baseline::ThreadBarrier>, run<ThreadBarrier> };
+		std::vector<double> phaseTimes[2];
+		std::vector<Clock::rep> syncTimes[2];
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			for (unsigned int i = 0u; i != 2u; ++i)
+			{
+				RunResult result = runs[i](pinning, threadCount, phaseCount);
+				if (!result.succeeded)
+				{
+					std::fprintf(stderr, "%s ended a phase before every thread arrived\n", names[i]);
+					succeeded = false;
+				}
+				phaseTimes[i].push_back(BenchmarkUtil::milliseconds(result.time) * 1000000.0 / static_cast<double>(phaseCount));
+				syncTimes[i].insert(syncTimes[i].end(), result.syncTimes.begin(), result.syncTimes.end());
+			}
+		}
+
+		for (unsigned int i = 0u; i != 2u; ++i)
+		{
+			std::sort(phaseTimes[i].begin(), phaseTimes[i].end());
+			std::sort(syncTimes[i].begin(), syncTimes[i].end());
+			csv.row("%s,%u,%zu,%u,%.0f,%.0f,%.0f,%.0f", names[i], threadCount, phaseCount, options.repetitions, BenchmarkUtil::percentile(phaseTimes[i], 0.5),
+				nanoseconds(BenchmarkUtil::percentile(syncTimes[i], 0.5)), nanoseconds(BenchmarkUtil::percentile(syncTimes[i], 0.99)),
+				nanoseconds(BenchmarkUtil::percentile(syncTimes[i], 0.999)));
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "barrier,threads,phases,repetitions,median_ns_per_phase,p50_sync_ns,p99_sync_ns,p999_sync_ns");
+
+	const std::size_t phaseCount = options.scaled(20000u);
+	bool succeeded = true;
+	for (unsigned int threadCount : BenchmarkUtil::threadCounts(options.maxThreads))
+	{
+		succeeded = measure(csv, options, pinning, threadCount, phaseCount) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+#include "BenchmarkUtil.h"
+#include "Baseline/WorkStealingQueue.h"
+#include <WorkStealingQueue.h>
+#include <memory>
+#include <type_traits>
+
+/*
+Compares the Chase-Lev WorkStealingQueue with the queue it replaced, which every thread popped from the end with fetch_sub.
+drain: the owner pushes all the items then every thread takes items until the queue is empty. With the new queue the owner pops and the other threads steal.
+owner_only: the owner pushes a batch of tasks and pops them again with no other threads, like a thread running its own tasks during a phase.
+Threads go from 1 to 64 by default so contention can be seen on large machines. Threads beyond the processor count share processors.
+*/
+namespace
+{
+	using BenchmarkUtil::Clock;
+
+	class Item
+	{
+	public:
+		void* context;
+		void(*function)(void* context);
+	};
+
+	void countItem(void* context)
+	{
+		++*static_cast<unsigned long long*>(context);
+	}
+
+	template<class Queue>
+	constexpr const char* queueName() noexcept
+	{
+		return std::is_same_v<Queue, Baseline::WorkStealingQueue<Item>> ? "Baseline::WorkStealingQueue" : "WorkStealingQueue";
+	}
+
+	template<class Queue>
+	bool takeItem(Queue& queue, unsigned int threadIndex, Item& item)
+	{
+		if constexpr (std::is_same_v<Queue, Baseline::WorkStealingQueue<Item>>)
+		{
+			(void)threadIndex;
+			return queue.pop(item);
+		}
+		else
+		{
+			return threadIndex == 0u ? queue.pop(item) : queue.steal(item);
+		}
+	}
+
+	class RunResult
+	{
+	public:
+		Clock::duration time;
+		unsigned long long takenCount;
+	};
+
+	template<class Queue>
+	RunResult drain(const BenchmarkUtil::Pinning& pinning, unsigned int threadCount, std::size_t itemCount)
+	{
+		std::unique_ptr<Queue> queue(new Queue(static_cast<std::ptrdiff_t>(itemCount) + 2));
+		std::vector<unsigned long long> counts(threadCount * 8u, 0u); //each count is on its own cache line
+		for (std::size_t i = 0u; i != itemCount; ++i)
+		{
+			queue->push(Item{ nullptr, countItem });
+		}
+
+		BenchmarkUtil::StartFlag startFlag;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0u; i != threadCount; ++i)
+		{
+			threads.emplace_back([&, i]()
+				{
+					pinning.pin(i);
+					unsigned long long& count = counts[i * 8u];
+					startFlag.arriveAndWait();
+					Item item;
+					while (takeItem(*queue, i, item))
+					{
+						item.function(&count);
+					}
+				});
+		}
+		startFlag.waitForAndStart(threadCount);
+		const Clock::time_point startTime = Clock::now();
+		for (auto& thread : threads) thread.join();
+
+		RunResult result;
+		result.time = Clock::now() - startTime;
+		result.takenCount = 0u;
+		for (unsigned int i = 0u; i != threadCount; ++i) result.takenCount += counts[i * 8u];
+		return result;
+	}
+
+	template<class Queue>
+	RunResult ownerOnly(const BenchmarkUtil::Pinning& pinning, unsigned int, std::size_t itemCount)
+	{
+		constexpr std::size_t batchSize = 64u;
+		pinning.pin(0u);
+		Queue queue(256);
+		unsigned long long takenCount = 0u;
+		const Clock::time_point startTime = Clock::now();
+		for (std::size_t pushed = 0u; pushed != itemCount;)
+		{
+			const std::size_t count = std::min(batchSize, itemCount - pushed);
+			pushed += count;
+			for (std::size_t i = 0u; i != count; ++i)
+			{
+				queue.push(Item{ nullptr, countItem });
+			}
+			Item item;
+			while (queue.pop(item))
+			{
+				item.function(&takenCount);
+			}
+			queue.resetIfInvalid();
+		}
+
+		RunResult result;
+		result.time = Clock::now() - startTime;
+		result.takenCount = takenCount;
+		return result;
+	}
+
+	using Run = RunResult(*)(const BenchmarkUtil::Pinning& pinning, unsigned int threadCount, std::size_t itemCount);
+
+	/*
+	The old and new queues are run alternately so both see the same machine state.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const BenchmarkUtil::Pinning& pinning, const char* mode,
+		unsigned int threadCount, std::size_t itemCount, Run oldRun, Run newRun)
+	{
+		const char* names[2] = { queueName<Baseline::WorkStealingQueue<Item>>(), queueName<WorkStealingQueue<Item>>() };
+		const Run runs[2] = { oldRun, newRun };
+		std::vector<double> times[2];
+		bool succeeded = true;
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			for (unsigned int i = 0u; i != 2u; ++i)
+			{
+				const RunResult result = runs[i](pinning, threadCount, itemCount);
+				if (result.takenCount != itemCount)
+				{
+					std::fprintf(stderr, "%s took %llu of %zu items\n", names[i], result.takenCount, itemCount);
+					succeeded = false;
+				}
+				times[i].push_back(BenchmarkUtil::milliseconds(result.time));
+			}
+		}
+
+		for (unsigned int i = 0u; i != 2u; ++i)
+		{
+			std::sort(times[i].begin(), times[i].end());
+			const double median = BenchmarkUtil::percentile(times[i], 0.5);
+			csv.row("%s,%s,%u,%zu,%u,%.3f,%.3f", names[i], mode, threadCount, itemCount, options.repetitions, median,
+				static_cast<double>(itemCount) / median / 1000.0);
+		}
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using OldQueue = Baseline::WorkStealingQueue<Item>;
+	using NewQueue = WorkStealingQueue<Item>;
+	const BenchmarkUtil::Options options(argc, argv, 64u);
+	const BenchmarkUtil::Pinning pinning(options);
+	BenchmarkUtil::CsvWriter csv(options, "queue,mode,threads,items,repetitions,median_milliseconds,million_items_per_second");
+
+	const std::size_t itemCount = options.scaled(1u << 20);
+	bool succeeded = measure(csv, options, pinning, "owner_only", 1u, itemCount, ownerOnly<OldQueue>, ownerOnly<NewQueue>);
+	for (unsigned int threadCount : BenchmarkUtil::threadCounts(options.maxThreads))
+	{
+		succeeded = measure(csv, options, pinning, "drain", threadCount, itemCount, drain<OldQueue>, drain<NewQueue>) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,622 @@
+#include "BenchmarkUtil.h"
+#include <HashSet.h>
+#include <IndexedPriorityQueue.h>
+#include <Portal.h>
+#include <PriorityQueue.h>
+#include <ResizingArray.h>
+#include <Vector3.h>
+#include <World.h>
+#include <random>
+
+/*
+Times the search WorldManager::load does to find the zones to load, with the IndexedPriorityQueue it uses now and with the
+SearchNodeTracker and binary PriorityQueue it used before.
+WorldManager needs the renderer so the search is copied here with the zones replaced by a grid with random portals between zones.
+Zones aren't loaded, the search only counts them.
+*/
+namespace
+{
+	constexpr float zoneRadius = 64.0f;
+	constexpr float zoneDiameter = 2.0f * zoneRadius;
+
+	class ZoneGraph
+	{
+	public:
+		World world;
+		std::vector<std::vector<Portal>> portals; //indexed by zone
+
+		ZoneGraph(unsigned long size, std::size_t portalCount) : world{ size, size, size, 0u }, portals(size * size * size)
+		{
+			std::mt19937 random(3u);
+			std::uniform_real_distribution<float> offset(0.0f, zoneDiameter);
+			for (std::size_t i = 0u; i != portalCount; ++i)
+			{
+				const unsigned long from = static_cast<unsigned long>(random() % portals.size());
+				const unsigned long to = static_cast<unsigned long>(random() % portals.size());
+				const Vector3 position = pointInZone(from, offset(random), offset(random), offset(random));
+				const Vector3 exitPosition = pointInZone(to, offset(random), offset(random), offset(random));
+				portals[from].push_back(Portal(position, exitPosition, 0u));
+			}
+		}
+
+		//The offsets are from the corner of the zone with the lowest coordinates.
+		Vector3 pointInZone(unsigned long zoneIndex, float offsetX, float offsetY, float offsetZ) const noexcept
+		{
+			const unsigned long zoneX = zoneIndex / (world.sizeY * world.sizeZ);
+			const unsigned long zoneY = zoneIndex / world.sizeZ % world.sizeY;
+			const unsigned long zoneZ = zoneIndex % world.sizeZ;
+			return Vector3{zoneX * zoneDiameter + offsetX, zoneY * zoneDiameter + offsetY, zoneZ * zoneDiameter + offsetZ};
+		}
+
+		const World* worlds() const noexcept
+		{
+			return &world;
+		}
+	};
+
+	class SearchResult
+	{
+	public:
+		unsigned long loadedCount = 0u;
+		unsigned long visitedCount = 0u;
+	};
+
+	unsigned long startZone(const World& world, Vector3 position, unsigned long& zoneX, unsigned long& zoneY, unsigned long& zoneZ)
+	{
+		zoneX = std::min((unsigned long)std::max((long)(position.x() / zoneDiameter), 0l), world.sizeX - 1u);
+		zoneY = std::min((unsigned long)std::max((long)(position.y() / zoneDiameter), 0l), world.sizeY - 1u);
+		zoneZ = std::min((unsigned long)std::max((long)(position.z() / zoneDiameter), 0l), world.sizeZ - 1u);
+		return world.zonesStartIndex + zoneX * (world.sizeY * world.sizeZ) + zoneY * world.sizeZ + zoneZ;
+	}
+
+	unsigned long portalExitZone(const World& newWorld, const Vector3& newPosition, unsigned long& newZoneX, unsigned long& newZoneY, unsigned long& newZoneZ)
+	{
+		newZoneX = std::min((unsigned long)std::max((long)(newPosition.x() / zoneDiameter), 0l), newWorld.sizeX - 1ul);
+		newZoneY = std::min((unsigned long)std::max((long)(newPosition.y() / zoneDiameter), 0l), newWorld.sizeY - 1ul);
+		newZoneZ = std::min((unsigned long)std::max((long)(newPosition.z() / zoneDiameter), 0l), newWorld.sizeZ - 1ul);
+		return newWorld.zonesStartIndex + newZoneX * (newWorld.sizeY * newWorld.sizeZ) + newZoneY * newWorld.sizeZ + newZoneZ;
+	}
+
+	Vector3 zoneCenter(unsigned long zoneX, unsigned long zoneY, unsigned long zoneZ) noexcept
+	{
+		return Vector3{zoneX * zoneDiameter + zoneRadius, zoneY * zoneDiameter + zoneRadius, zoneZ * zoneDiameter + zoneRadius};
+	}
+
+	/*
+	WorldManager's search before it used IndexedPriorityQueue.
+	Relaxing an edge into a zone that had already been popped used to dereference a null queueLocation, those edges are skipped here so it can run.
+	*/
+	namespace Baseline
+	{
+		class ZoneSearch
+		{
+			class SearchNode;
+			class SearchNodeTracker
+			{
+			public:
+				SearchNode* node;
+				SearchNodeTracker() = default;
+				SearchNodeTracker(const SearchNodeTracker& other) = delete;
+				SearchNodeTracker(SearchNodeTracker&& other) : node(other.node)
+				{
+					other.node = nullptr;
+					node->queueLocation = this;
+				}
+
+				void operator=(const SearchNodeTracker& other) = delete;
+				void operator=(SearchNodeTracker&& other)
+				{
+					node = other.node;
+					other.node = nullptr;
+					node->queueLocation = this;
+				}
+
+				~SearchNodeTracker()
+				{
+					if(node != nullptr)
+					{
+						node->queueLocation = nullptr;
+					}
+				}
+
+				SearchNode* operator->() const
+				{
+					return node;
+				}
+			};
+
+			class SearchNode
+			{
+			public:
+				SearchNode() noexcept {}
+
+				constexpr SearchNode(float totalDistance1, unsigned long zoneX1, unsigned long zoneY1, unsigned long zoneZ1, unsigned long zoneIndex1,
+					unsigned long worldIndex1, Vector3 anchor1, float distanceFromStartToAnchor1, SearchNodeTracker* queueLocation1) noexcept :
+					totalDistance(totalDistance1), zoneX(zoneX1), zoneY(zoneY1), zoneZ(zoneZ1),
+					zoneIndex(zoneIndex1), worldIndex(worldIndex1), anchor(anchor1),
+					distanceFromStartToAnchor(distanceFromStartToAnchor1),
+					queueLocation(queueLocation1){}
+
+				SearchNode(SearchNode&& other) noexcept : totalDistance(other.totalDistance), zoneX(other.zoneX), zoneY(other.zoneY), zoneZ(other.zoneZ), zoneIndex(other.zoneIndex),
+					worldIndex(other.worldIndex), anchor(other.anchor), distanceFromStartToAnchor(other.distanceFromStartToAnchor), queueLocation(other.queueLocation)
+				{
+					if(queueLocation != nullptr)
+					{
+						queueLocation->node = this;
+					}
+				}
+
+				void operator=(SearchNode&& other) noexcept
+				{
+					totalDistance = other.totalDistance;
+					zoneX = other.zoneX;
+					zoneY = other.zoneY;
+					zoneZ = other.zoneZ;
+					zoneIndex = other.zoneIndex;
+					worldIndex = other.worldIndex;
+					anchor = other.anchor;
+					distanceFromStartToAnchor = other.distanceFromStartToAnchor;
+					queueLocation = other.queueLocation;
+
+					if (queueLocation != nullptr)
+					{
+						queueLocation->node = this;
+					}
+				}
+
+				float totalDistance;
+				unsigned long zoneX;
+				unsigned long zoneY;
+				unsigned long zoneZ;
+				unsigned long zoneIndex;
+				unsigned long worldIndex;
+				Vector3 anchor;
+				float distanceFromStartToAnchor;
+				SearchNodeTracker* queueLocation;
+			};
+
+			class SearchNodeHasher
+			{
+			public:
+				std::size_t operator()(const SearchNode& node) const noexcept
+				{
+					return (std::size_t)node.zoneIndex;
+				}
+
+				std::size_t operator()(unsigned long zoneIndex) const noexcept
+				{
+					return (std::size_t)zoneIndex;
+				}
+			};
+
+			class SearchNodeEqual
+			{
+			public:
+				constexpr bool operator()(const SearchNode& lhs, const SearchNode& rhs) const noexcept
+				{
+					return lhs.zoneIndex == rhs.zoneIndex;
+				}
+
+				constexpr bool operator()(const SearchNode& lhs, unsigned long zoneIndex) const noexcept
+				{
+					return lhs.zoneIndex == zoneIndex;
+				}
+			};
+
+			class SearchNodePriority
+			{
+			public:
+				bool operator()(const SearchNodeTracker& lhs, const SearchNodeTracker& rhs) const noexcept
+				{
+					return lhs->totalDistance > rhs->totalDistance;
+				}
+			};
+
+			using Frontier = PriorityQueue<SearchNodeTracker, ResizingArray<SearchNodeTracker>, SearchNodePriority>;
+
+			HashSet<SearchNode, SearchNodeHasher, SearchNodeEqual> visitedNodes;
+			Frontier frontierNodes;
+
+			void visitZone(unsigned long zoneX, unsigned long zoneY, unsigned long zoneZ, unsigned long zoneIndex, SearchNode* currentNode,
+				const SearchNodeTracker& currentNodeTracker, float maxTotalDistance)
+			{
+				const float newTotalDistance = currentNode->distanceFromStartToAnchor + (zoneCenter(zoneX, zoneY, zoneZ) - currentNode->anchor).length();
+				if(newTotalDistance > maxTotalDistance)
+				{
+					return;
+				}
+
+				auto element = visitedNodes.find(zoneIndex);
+				if(element != visitedNodes.end())
+				{
+					if(element->totalDistance > newTotalDistance && element->queueLocation != nullptr && element->queueLocation != &currentNodeTracker)
+					{
+						element->totalDistance = newTotalDistance;
+						frontierNodes.priorityIncreased(*element->queueLocation);
+					}
+				}
+				else
+				{
+					SearchNodeTracker newNodeTracker;
+					SearchNode newNode = {newTotalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentNode->worldIndex, currentNode->anchor, currentNode->distanceFromStartToAnchor, &newNodeTracker};
+					newNodeTracker.node = &newNode;
+					visitedNodes.insert(std::move(newNode));
+					frontierNodes.push(std::move(newNodeTracker));
+				}
+			}
+
+			void visitPortals(SearchNode* currentNode, const SearchNodeTracker& currentNodeTracker, const ZoneGraph& graph, float maxTotalDistance)
+			{
+				auto currentDistanceFromStartToAnchor = currentNode->distanceFromStartToAnchor;
+				auto currentAnchor = currentNode->anchor;
+				for(const Portal& portal : graph.portals[currentNode->zoneIndex])
+				{
+					unsigned long newWorldIndex = portal.exitWorldIndex;
+					const World& newWorld = graph.worlds()[newWorldIndex];
+					auto& newPosition = portal.exitPosition;
+					unsigned long newZoneX, newZoneY, newZoneZ;
+					const unsigned long newZoneIndex = portalExitZone(newWorld, newPosition, newZoneX, newZoneY, newZoneZ);
+
+					const float newDistanceFromStartToAnchor = currentDistanceFromStartToAnchor + (portal.position - currentAnchor).length();
+					const float newTotalDistance = newDistanceFromStartToAnchor + (zoneCenter(newZoneX, newZoneY, newZoneZ) - newPosition).length();
+
+					if(newTotalDistance > maxTotalDistance)
+					{
+						continue;
+					}
+
+					auto element = visitedNodes.find(newZoneIndex);
+					if(element != visitedNodes.end())
+					{
+						if(element->totalDistance > newTotalDistance && element->queueLocation != nullptr && element->queueLocation != &currentNodeTracker)
+						{
+							element->totalDistance = newTotalDistance;
+							element->anchor = newPosition;
+							element->distanceFromStartToAnchor = newDistanceFromStartToAnchor;
+							frontierNodes.priorityIncreased(*element->queueLocation);
+						}
+					}
+					else
+					{
+						SearchNodeTracker newNodeTracker;
+						SearchNode newNode = {newTotalDistance, newZoneX, newZoneY, newZoneZ, newZoneIndex, newWorldIndex, newPosition, newDistanceFromStartToAnchor, &newNodeTracker};
+						newNodeTracker.node = &newNode;
+						visitedNodes.insert(std::move(newNode));
+						frontierNodes.push(std::move(newNodeTracker));
+					}
+				}
+			}
+		public:
+			constexpr static const char* name = "SearchNodeTracker+PriorityQueue";
+
+			SearchResult search(const ZoneGraph& graph, Vector3 loadedPosition, float maxTotalDistance)
+			{
+				SearchResult result;
+				{
+					const World& world = graph.worlds()[0];
+					unsigned long zoneX, zoneY, zoneZ;
+					const unsigned long zoneIndex = startZone(world, loadedPosition, zoneX, zoneY, zoneZ);
+					const float totalDistance = (zoneCenter(zoneX, zoneY, zoneZ) - loadedPosition).length();
+
+					SearchNodeTracker newNodeTracker;
+					SearchNode newNode = {totalDistance, zoneX, zoneY, zoneZ, zoneIndex, 0u, loadedPosition, 0.0f, &newNodeTracker};
+					newNodeTracker.node = &newNode;
+					visitedNodes.insert(std::move(newNode));
+					frontierNodes.push(std::move(newNodeTracker));
+				}
+
+				while(!frontierNodes.empty())
+				{
+					SearchNodeTracker currentNodeTracker = frontierNodes.popAndGet();
+					SearchNode* currentNode = currentNodeTracker.node;
+					++result.loadedCount;
+
+					const World& world = graph.worlds()[currentNode->worldIndex];
+					const unsigned long zoneX = currentNode->zoneX;
+					const unsigned long zoneY = currentNode->zoneY;
+					const unsigned long zoneZ = currentNode->zoneZ;
+					const unsigned long zoneIndex = currentNode->zoneIndex;
+					const unsigned long sizeX = world.sizeX;
+					const unsigned long sizeY = world.sizeY;
+					const unsigned long sizeZ = world.sizeZ;
+					if(zoneX + 1u != sizeX) //move toward x
+					{
+						visitZone(zoneX + 1u, zoneY, zoneZ, zoneIndex + sizeY * sizeZ, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					if(zoneX != 0u) //move toward -x
+					{
+						visitZone(zoneX - 1u, zoneY, zoneZ, zoneIndex - sizeY * sizeZ, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					if(zoneY + 1 != sizeY) //move toward y
+					{
+						visitZone(zoneX, zoneY + 1u, zoneZ, zoneIndex + sizeZ, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					if(zoneY != 0u) //move toward -y
+					{
+						visitZone(zoneX, zoneY - 1u, zoneZ, zoneIndex - sizeZ, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					if(zoneZ + 1 != sizeZ) //move toward z
+					{
+						visitZone(zoneX, zoneY, zoneZ + 1u, zoneIndex + 1u, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					if(zoneZ != 0u) //move toward -z
+					{
+						visitZone(zoneX, zoneY, zoneZ - 1u, zoneIndex - 1u, currentNode, currentNodeTracker, maxTotalDistance);
+						currentNode = currentNodeTracker.node;
+					}
+					visitPortals(currentNode, currentNodeTracker, graph, maxTotalDistance);
+				}
+				result.visitedCount = visitedNodes.size();
+				visitedNodes.clear();
+				return result;
+			}
+		};
+	}
+
+	/*
+	WorldManager's search as it is now.
+	*/
+	class ZoneSearch
+	{
+		class SearchNode
+		{
+		public:
+			SearchNode() noexcept {}
+
+			constexpr SearchNode(float totalDistance1, unsigned long zoneX1, unsigned long zoneY1, unsigned long zoneZ1, unsigned long zoneIndex1,
+				unsigned long worldIndex1, Vector3 anchor1, float distanceFromStartToAnchor1) noexcept :
+				totalDistance(totalDistance1), zoneX(zoneX1), zoneY(zoneY1), zoneZ(zoneZ1),
+				zoneIndex(zoneIndex1), worldIndex(worldIndex1), anchor(anchor1),
+				distanceFromStartToAnchor(distanceFromStartToAnchor1) {}
+
+			float totalDistance;
+			unsigned long zoneX;
+			unsigned long zoneY;
+			unsigned long zoneZ;
+			unsigned long zoneIndex;
+			unsigned long worldIndex;
+			Vector3 anchor;
+			float distanceFromStartToAnchor;
+		};
+
+		class SearchNodePriority
+		{
+		public:
+			constexpr bool operator()(const SearchNode& lhs, const SearchNode& rhs) const noexcept
+			{
+				return lhs.totalDistance > rhs.totalDistance;
+			}
+		};
+
+		using SearchQueue = IndexedPriorityQueue<SearchNode, SearchNodePriority>;
+		using SearchNodeHandle = SearchQueue::Handle;
+
+		class VisitedZone
+		{
+		public:
+			unsigned long zoneIndex;
+			SearchNodeHandle node;
+		};
+
+		class VisitedZoneHasher
+		{
+		public:
+			std::size_t operator()(const VisitedZone& visitedZone) const noexcept
+			{
+				return (std::size_t)visitedZone.zoneIndex;
+			}
+
+			std::size_t operator()(unsigned long zoneIndex) const noexcept
+			{
+				return (std::size_t)zoneIndex;
+			}
+		};
+
+		class VisitedZoneEqual
+		{
+		public:
+			constexpr bool operator()(const VisitedZone& lhs, const VisitedZone& rhs) const noexcept
+			{
+				return lhs.zoneIndex == rhs.zoneIndex;
+			}
+
+			constexpr bool operator()(const VisitedZone& lhs, unsigned long zoneIndex) const noexcept
+			{
+				return lhs.zoneIndex == zoneIndex;
+			}
+		};
+
+		HashSet<VisitedZone, VisitedZoneHasher, VisitedZoneEqual> visitedNodes;
+		SearchQueue frontierNodes;
+
+		void visitNode(const SearchNode& newNode)
+		{
+			auto element = visitedNodes.find(newNode.zoneIndex);
+			if(element != visitedNodes.end())
+			{
+				SearchNode& node = frontierNodes[element->node];
+				if(node.totalDistance > newNode.totalDistance && frontierNodes.isQueued(element->node))
+				{
+					node = newNode;
+					frontierNodes.priorityIncreased(element->node);
+				}
+			}
+			else
+			{
+				visitedNodes.insert(VisitedZone{newNode.zoneIndex, frontierNodes.push(newNode)});
+			}
+		}
+
+		void visitZone(unsigned long zoneX, unsigned long zoneY, unsigned long zoneZ, unsigned long zoneIndex, const SearchNode* currentNode, float maxTotalDistance)
+		{
+			const float newTotalDistance = currentNode->distanceFromStartToAnchor + (zoneCenter(zoneX, zoneY, zoneZ) - currentNode->anchor).length();
+			if(newTotalDistance > maxTotalDistance)
+			{
+				return;
+			}
+
+			visitNode(SearchNode{newTotalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentNode->worldIndex, currentNode->anchor, currentNode->distanceFromStartToAnchor});
+		}
+
+		void visitPortals(const SearchNode* currentNode, const ZoneGraph& graph, float maxTotalDistance)
+		{
+			auto currentDistanceFromStartToAnchor = currentNode->distanceFromStartToAnchor;
+			auto currentAnchor = currentNode->anchor;
+			for(const Portal& portal : graph.portals[currentNode->zoneIndex])
+			{
+				unsigned long newWorldIndex = portal.exitWorldIndex;
+				const World& newWorld = graph.worlds()[newWorldIndex];
+				auto& newPosition = portal.exitPosition;
+				unsigned long newZoneX, newZoneY, newZoneZ;
+				const unsigned long newZoneIndex = portalExitZone(newWorld, newPosition, newZoneX, newZoneY, newZoneZ);
+
+				const float newDistanceFromStartToAnchor = currentDistanceFromStartToAnchor + (portal.position - currentAnchor).length();
+				const float newTotalDistance = newDistanceFromStartToAnchor + (zoneCenter(newZoneX, newZoneY, newZoneZ) - newPosition).length();
+
+				if(newTotalDistance > maxTotalDistance)
+				{
+					continue;
+				}
+
+				visitNode(SearchNode{newTotalDistance, newZoneX, newZoneY, newZoneZ, newZoneIndex, newWorldIndex, newPosition, newDistanceFromStartToAnchor});
+			}
+		}
+	public:
+		constexpr static const char* name = "IndexedPriorityQueue";
+
+		SearchResult search(const ZoneGraph& graph, Vector3 loadedPosition, float maxTotalDistance)
+		{
+			SearchResult result;
+			{
+				const World& world = graph.worlds()[0];
+				unsigned long zoneX, zoneY, zoneZ;
+				const unsigned long zoneIndex = startZone(world, loadedPosition, zoneX, zoneY, zoneZ);
+				const float totalDistance = (zoneCenter(zoneX, zoneY, zoneZ) - loadedPosition).length();
+
+				const SearchNodeHandle node = frontierNodes.push(SearchNode{totalDistance, zoneX, zoneY, zoneZ, zoneIndex, 0u, loadedPosition, 0.0f});
+				visitedNodes.insert(VisitedZone{zoneIndex, node});
+			}
+
+			while(!frontierNodes.empty())
+			{
+				//copied as visiting other zones adds nodes to frontierNodes which can move the nodes
+				const SearchNode currentNodeValue = frontierNodes[frontierNodes.pop()];
+				const SearchNode* const currentNode = &currentNodeValue;
+				++result.loadedCount;
+
+				const World& world = graph.worlds()[currentNode->worldIndex];
+				const unsigned long zoneX = currentNode->zoneX;
+				const unsigned long zoneY = currentNode->zoneY;
+				const unsigned long zoneZ = currentNode->zoneZ;
+				const unsigned long zoneIndex = currentNode->zoneIndex;
+				const unsigned long sizeX = world.sizeX;
+				const unsigned long sizeY = world.sizeY;
+				const unsigned long sizeZ = world.sizeZ;
+				if(zoneX + 1u != sizeX) //move toward x
+				{
+					visitZone(zoneX + 1u, zoneY, zoneZ, zoneIndex + sizeY * sizeZ, currentNode, maxTotalDistance);
+				}
+				if(zoneX != 0u) //move toward -x
+				{
+					visitZone(zoneX - 1u, zoneY, zoneZ, zoneIndex - sizeY * sizeZ, currentNode, maxTotalDistance);
+				}
+				if(zoneY + 1 != sizeY) //move toward y
+				{
+					visitZone(zoneX, zoneY + 1u, zoneZ, zoneIndex + sizeZ, currentNode, maxTotalDistance);
+				}
+				if(zoneY != 0u) //move toward -y
+				{
+					visitZone(zoneX, zoneY - 1u, zoneZ, zoneIndex - sizeZ, currentNode, maxTotalDistance);
+				}
+				if(zoneZ + 1 != sizeZ) //move toward z
+				{
+					visitZone(zoneX, zoneY, zoneZ + 1u, zoneIndex + 1u, currentNode, maxTotalDistance);
+				}
+				if(zoneZ != 0u) //move toward -z
+				{
+					visitZone(zoneX, zoneY, zoneZ - 1u, zoneIndex - 1u, currentNode, maxTotalDistance);
+				}
+				visitPortals(currentNode, graph, maxTotalDistance);
+			}
+			result.visitedCount = visitedNodes.size();
+			visitedNodes.clear();
+			frontierNodes.clear();
+			return result;
+		}
+	};
+
+	class Measurement
+	{
+	public:
+		std::vector<double> times;
+		SearchResult result;
+	};
+
+	template<class Search>
+	void runSearch(Search& search, Measurement& measurement, const ZoneGraph& graph, Vector3 position, float maxTotalDistance)
+	{
+		const BenchmarkUtil::Clock::time_point startTime = BenchmarkUtil::Clock::now();
+		measurement.result = search.search(graph, position, maxTotalDistance);
+		measurement.times.push_back(BenchmarkUtil::milliseconds(BenchmarkUtil::Clock::now() - startTime));
+	}
+
+	template<class Search>
+	void writeRow(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, const ZoneGraph& graph, std::size_t portalCount,
+		float maxTotalDistance, Measurement& measurement)
+	{
+		std::sort(measurement.times.begin(), measurement.times.end());
+		csv.row("%s,%zu,%zu,%.0f,%lu,%u,%.3f", Search::name, graph.portals.size(), portalCount, maxTotalDistance, measurement.result.loadedCount,
+			options.repetitions, BenchmarkUtil::percentile(measurement.times, 0.5));
+	}
+
+	/*
+	The searches are run alternately so both see the same machine state. Each keeps its containers between runs like WorldManager does.
+	*/
+	bool measure(BenchmarkUtil::CsvWriter& csv, const BenchmarkUtil::Options& options, unsigned long size, std::size_t portalCount, float maxTotalDistance)
+	{
+		const ZoneGraph graph(size, portalCount);
+		const Vector3 position = graph.pointInZone(static_cast<unsigned long>(graph.portals.size() / 2u), zoneRadius, zoneRadius, zoneRadius);
+		Baseline::ZoneSearch oldSearch;
+		ZoneSearch newSearch;
+		Measurement measurements[2];
+		for (unsigned int repetition = 0u; repetition != options.repetitions; ++repetition)
+		{
+			runSearch(oldSearch, measurements[0], graph, position, maxTotalDistance);
+			runSearch(newSearch, measurements[1], graph, position, maxTotalDistance);
+		}
+		writeRow<Baseline::ZoneSearch>(csv, options, graph, portalCount, maxTotalDistance, measurements[0]);
+		writeRow<ZoneSearch>(csv, options, graph, portalCount, maxTotalDistance, measurements[1]);
+
+		//Every zone that is found has to be loaded exactly once.
+		bool succeeded = true;
+		for (const Measurement& measurement : measurements)
+		{
+			if (measurement.result.loadedCount != measurement.result.visitedCount) succeeded = false;
+		}
+		if (!succeeded) std::fprintf(stderr, "a search didn't load every zone it found exactly once\n");
+		return succeeded;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const BenchmarkUtil::Options options(argc, argv);
+	BenchmarkUtil::CsvWriter csv(options, "search,zones,portals,max_distance,loaded_zones,repetitions,median_milliseconds");
+
+	//WorldManager searches out to its largest level of detail distance, the whole graph is searched too to give the heap the most work.
+	const float searchAll = 1e9f;
+	bool succeeded = true;
+	for (unsigned long size : { 32ul, 64ul })
+	{
+		//About one portal for every four zones, the 64x64x64 grid has 60000.
+		const std::size_t portalCount = options.scaled(size * size * size * 60000u / 262144u);
+		succeeded = measure(csv, options, size, portalCount, 4.0f * zoneDiameter) && succeeded;
+		succeeded = measure(csv, options, size, portalCount, searchAll) && succeeded;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/*
+Background tasks with a higher priority are run first.
+Tasks that have been waiting for a long time are run as if they had a higher priority so low priority tasks still get run.
+*/
+enum class BackgroundPriority : unsigned char
+{
+	high, //latency critical work like loading virtual texture pages that are in view
+	normal,
+	low, //bulk work like loading zones before they are needed
+};
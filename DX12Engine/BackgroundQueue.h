@@ -1,19 +1,238 @@
 #pragma once
 #include "SingleProducerSingleConsumerQueue.h"
+#include "BackgroundPriority.h"
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 
+/*
+Background tasks pushed by one thread. Only the owning thread can push but any thread holding the lock can pop.
+Each priority has its own 256 entry ring. When a ring is full, tasks go into a list of heap allocated blocks instead of overwriting old tasks
+and keep going there until the list is empty so that tasks with the same priority stay in order.
+pop returns the task with the highest priority after aging. A task is treated as one priority higher for every agingTime it has waited.
+*/
 template<class Task>
-class BackgroundQueue : public SingleProducerSingleConsumerQueue<Task, 256u>
+class BackgroundQueue
 {
+public:
+	using Clock = std::chrono::steady_clock;
+	constexpr static std::size_t priorityCount = 3u;
+	constexpr static Clock::duration agingTime = std::chrono::milliseconds(20);
+
+	class Statistics
+	{
+	public:
+		unsigned long long pushedCount;
+		unsigned long long overflowedCount; //number of tasks that went into the overflow list
+		unsigned long long poppedCount;
+		Clock::duration totalWaitTime;
+		Clock::duration maxWaitTime;
+
+		unsigned long long depth() const noexcept
+		{
+			return pushedCount > poppedCount ? pushedCount - poppedCount : 0u;
+		}
+	};
+private:
+	class Entry
+	{
+	public:
+		Task task;
+		Clock::time_point pushTime;
+	};
+
+	class OverflowBlock
+	{
+	public:
+		constexpr static std::size_t capacity = 64u;
+
+		Entry entries[capacity];
+		std::atomic<std::size_t> size = 0u;
+		std::atomic<OverflowBlock*> next = nullptr;
+	};
+
+	class Level
+	{
+	public:
+		SingleProducerSingleConsumerQueue<Entry, 256u> ring;
+		OverflowBlock* overflowTail = nullptr; //only used by the producer
+		std::atomic<OverflowBlock*> overflowHead = nullptr; //set by the producer when the first block is made then only changed by the consumer
+		std::size_t overflowReadIndex = 0u; //only used by the consumer
+		std::atomic<std::size_t> overflowCount = 0u;
+
+		//only written by the producer
+		std::atomic<unsigned long long> pushedCount = 0u;
+		std::atomic<unsigned long long> overflowedCount = 0u;
+		//only written by the consumer
+		std::atomic<unsigned long long> poppedCount = 0u;
+		std::atomic<Clock::rep> totalWaitTime = 0;
+		std::atomic<Clock::rep> maxWaitTime = 0;
+
+		~Level()
+		{
+			OverflowBlock* block = overflowHead.load(std::memory_order_relaxed);
+			while (block != nullptr)
+			{
+				OverflowBlock* next = block->next.load(std::memory_order_relaxed);
+				delete block;
+				block = next;
+			}
+		}
+
+		void pushOverflow(const Entry& entry)
+		{
+			OverflowBlock* tail = overflowTail;
+			if (tail == nullptr)
+			{
+				tail = new OverflowBlock;
+				overflowTail = tail;
+				overflowHead.store(tail, std::memory_order_release);
+			}
+			std::size_t size = tail->size.load(std::memory_order_relaxed);
+			if (size == OverflowBlock::capacity)
+			{
+				OverflowBlock* newTail = new OverflowBlock;
+				tail->next.store(newTail, std::memory_order_release);
+				overflowTail = newTail;
+				tail = newTail;
+				size = 0u;
+			}
+			tail->entries[size] = entry;
+			tail->size.store(size + 1u, std::memory_order_release);
+			overflowCount.fetch_add(1u, std::memory_order_relaxed);
+		}
+
+		/*
+		Frees blocks that have been emptied as long as the producer has moved on from them.
+		*/
+		Entry* overflowFront() noexcept
+		{
+			OverflowBlock* head = overflowHead.load(std::memory_order_acquire);
+			if (head == nullptr) return nullptr;
+			while (true)
+			{
+				if (overflowReadIndex != head->size.load(std::memory_order_acquire)) return &head->entries[overflowReadIndex];
+				if (overflowReadIndex != OverflowBlock::capacity) return nullptr;
+				OverflowBlock* next = head->next.load(std::memory_order_acquire);
+				if (next == nullptr) return nullptr;
+				delete head;
+				head = next;
+				overflowHead.store(head, std::memory_order_relaxed);
+				overflowReadIndex = 0u;
+			}
+		}
+
+		void popOverflowFront() noexcept
+		{
+			++overflowReadIndex;
+			overflowCount.fetch_sub(1u, std::memory_order_release);
+		}
+	};
+
+	Level mLevels[priorityCount];
 	std::atomic_flag locked = ATOMIC_FLAG_INIT;
+
+	template<class T>
+	static void increment(std::atomic<T>& counter, T amount = 1u) noexcept
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
 public:
+	/*
+	Must be called by the thread that owns the queue.
+	*/
+	void push(Task task, BackgroundPriority priority = BackgroundPriority::normal)
+	{
+		Level& level = mLevels[static_cast<std::size_t>(priority)];
+		const Entry entry{ task, Clock::now() };
+		increment(level.pushedCount);
+		if (level.overflowCount.load(std::memory_order_acquire) == 0u && level.ring.tryPush(entry)) return;
+		level.pushOverflow(entry);
+		increment(level.overflowedCount);
+	}
+
+	/*
+	Must be called while holding the lock.
+	*/
+	bool pop(Task& task)
+	{
+		const auto now = Clock::now();
+		Level* bestLevel = nullptr;
+		Entry* bestEntry = nullptr;
+		bool bestIsInOverflow = false;
+		long long bestPriority = 0;
+		for (std::size_t i = 0u; i != priorityCount; ++i)
+		{
+			Level& level = mLevels[i];
+			//The overflow list is checked first so that seeing a task in it means all older tasks in the ring are also seen.
+			Entry* overflowEntry = level.overflowFront();
+			bool isInOverflow = false;
+			Entry* entry = level.ring.front();
+			if (entry == nullptr)
+			{
+				if (overflowEntry == nullptr) continue;
+				entry = overflowEntry;
+				isInOverflow = true;
+			}
+			const long long priority = static_cast<long long>(i) - static_cast<long long>((now - entry->pushTime) / agingTime);
+			if (bestEntry == nullptr || priority < bestPriority)
+			{
+				bestLevel = &level;
+				bestEntry = entry;
+				bestIsInOverflow = isInOverflow;
+				bestPriority = priority;
+			}
+		}
+		if (bestEntry == nullptr) return false;
+
+		task = bestEntry->task;
+		const Clock::rep waitTime = (now - bestEntry->pushTime).count();
+		if (bestIsInOverflow)
+		{
+			bestLevel->popOverflowFront();
+		}
+		else
+		{
+			bestLevel->ring.popFront();
+		}
+		increment(bestLevel->poppedCount);
+		increment(bestLevel->totalWaitTime, waitTime);
+		if (waitTime > bestLevel->maxWaitTime.load(std::memory_order_relaxed))
+		{
+			bestLevel->maxWaitTime.store(waitTime, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	/*
+	Can be called from any thread. The values are only approximate while the queue is in use.
+	*/
+	Statistics statistics(BackgroundPriority priority) const noexcept
+	{
+		const Level& level = mLevels[static_cast<std::size_t>(priority)];
+		return { level.pushedCount.load(std::memory_order_relaxed), level.overflowedCount.load(std::memory_order_relaxed), level.poppedCount.load(std::memory_order_relaxed),
+			Clock::duration(level.totalWaitTime.load(std::memory_order_relaxed)), Clock::duration(level.maxWaitTime.load(std::memory_order_relaxed)) };
+	}
+
+	/*
+	Can be called from any thread. Only approximate while tasks are being pushed.
+	*/
+	bool empty() const noexcept
+	{
+		for (const Level& level : mLevels)
+		{
+			if (level.pushedCount.load(std::memory_order_relaxed) != level.poppedCount.load(std::memory_order_relaxed)) return false;
+		}
+		return true;
+	}
+
 	bool try_lock() noexcept
 	{
-		return !locked.test_and_set(std::memory_order::memory_order_acquire);
+		return !locked.test_and_set(std::memory_order_acquire);
 	}
 
 	void unlock() noexcept
 	{
-		locked.clear(std::memory_order::memory_order_release);
+		locked.clear(std::memory_order_release);
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include "SparseEntityIndex.h"
+#include <tuple>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+Stores components for entities made by EntityGenerator as a structure of arrays, one dense column per component type, so a pass that only reads a few components
+only loads those columns and can process chunkSize items at a time with SIMD.
+Erasing an entity moves the last entity into its place so the columns never have holes. Erasing or inserting changes the order of entities.
+Columns start on columnAlignment byte boundaries and are padded to a whole number of chunks so SIMD passes never need a scalar tail.
+For a component whose size is a multiple of 4 bytes every chunk starts on a columnAlignment boundary, so a chunk of floats fills an AVX register.
+Components must be trivially copyable and each component type can only be used once.
+*/
+template<class... Components>
+class ComponentStore
+{
+	static_assert(sizeof...(Components) != 0u, "ComponentStore needs at least one component");
+	static_assert((std::is_trivially_copyable<Components>::value && ...), "ComponentStore components must be trivially copyable");
+public:
+	using size_type = std::size_t;
+	constexpr static size_type chunkSize = 8u;
+	constexpr static size_type columnAlignment = 32u;
+private:
+	std::tuple<Components*...> mColumns;
+	unsigned long* mEntities; //the entity that owns each item
+	SparseEntityIndex mIndices; //the position of each entity's components in the columns
+	size_type mSize;
+	size_type mCapacity; //always a multiple of chunkSize
+
+	template<class T>
+	static T* allocateColumn(size_type capacity)
+	{
+		void* column = ::operator new(capacity * sizeof(T), std::align_val_t{columnAlignment < alignof(T) ? alignof(T) : columnAlignment});
+		std::memset(column, 0, capacity * sizeof(T));
+		return static_cast<T*>(column);
+	}
+
+	template<class T>
+	static void deallocateColumn(T* column) noexcept
+	{
+		if(column != nullptr) ::operator delete(static_cast<void*>(column), std::align_val_t{columnAlignment < alignof(T) ? alignof(T) : columnAlignment});
+	}
+
+	template<class T>
+	void growColumn(T*& column, size_type newCapacity)
+	{
+		T* newColumn = allocateColumn<T>(newCapacity);
+		if(mSize != 0u) std::memcpy(static_cast<void*>(newColumn), static_cast<const void*>(column), mSize * sizeof(T));
+		deallocateColumn(column);
+		column = newColumn;
+	}
+
+	void grow(size_type newCapacity)
+	{
+		newCapacity = (newCapacity + chunkSize - 1u) & ~(chunkSize - 1u);
+		growColumn(mEntities, newCapacity);
+		std::apply([this, newCapacity](auto*&... columns) { (growColumn(columns, newCapacity), ...); }, mColumns);
+		mCapacity = newCapacity;
+	}
+
+	template<class T>
+	static void moveItem(T* column, size_type from, size_type to) noexcept
+	{
+		std::memcpy(static_cast<void*>(column + to), static_cast<const void*>(column + from), sizeof(T));
+	}
+
+	void deallocate() noexcept
+	{
+		deallocateColumn(mEntities);
+		std::apply([](auto*... columns) { (deallocateColumn(columns), ...); }, mColumns);
+	}
+public:
+	ComponentStore() noexcept : mColumns{}, mEntities(nullptr), mSize(0u), mCapacity(0u) {}
+
+	ComponentStore(const ComponentStore&) = delete;
+	ComponentStore& operator=(const ComponentStore&) = delete;
+
+	~ComponentStore()
+	{
+		deallocate();
+	}
+
+	size_type size() const noexcept
+	{
+		return mSize;
+	}
+
+	/*
+	The number of items including the padding at the end of the last chunk.
+	*/
+	size_type paddedSize() const noexcept
+	{
+		return (mSize + chunkSize - 1u) & ~(chunkSize - 1u);
+	}
+
+	size_type chunkCount() const noexcept
+	{
+		return paddedSize() / chunkSize;
+	}
+
+	void reserve(size_type newCapacity)
+	{
+		if(newCapacity > mCapacity) grow(newCapacity);
+	}
+
+	bool contains(unsigned long entity) const noexcept
+	{
+		const auto index = mIndices.find(entity);
+		return index != SparseEntityIndex::none && index < mSize && mEntities[index] == entity;
+	}
+
+	/*
+	entity must not already have components in the store.
+	*/
+	void insert(unsigned long entity, const Components&... components)
+	{
+		assert(!contains(entity));
+		if(mSize == mCapacity) grow(mCapacity == 0u ? chunkSize : mCapacity * 2u);
+		const size_type index = mSize;
+		mEntities[index] = entity;
+		std::apply([index, &components...](auto*... columns) { ((columns[index] = components), ...); }, mColumns);
+		mIndices.set(entity, static_cast<SparseEntityIndex::size_type>(index));
+		++mSize;
+	}
+
+	void erase(unsigned long entity)
+	{
+		const size_type index = indexOf(entity);
+		const size_type last = mSize - 1u;
+		mIndices.reset(entity);
+		if(index != last)
+		{
+			mIndices.set(mEntities[last], static_cast<SparseEntityIndex::size_type>(index));
+			moveItem(mEntities, last, index);
+			std::apply([index, last](auto*... columns) { (moveItem(columns, last, index), ...); }, mColumns);
+		}
+		--mSize;
+	}
+
+	void clear()
+	{
+		for(size_type i = 0u; i != mSize; ++i)
+		{
+			mIndices.reset(mEntities[i]);
+		}
+		mSize = 0u;
+	}
+
+	/*
+	The position of entity's components in the columns. Only valid until the next insert or erase.
+	*/
+	size_type indexOf(unsigned long entity) const noexcept
+	{
+		assert(contains(entity));
+		return mIndices.find(entity);
+	}
+
+	template<class Component>
+	Component& get(unsigned long entity)
+	{
+		return column<Component>()[indexOf(entity)];
+	}
+
+	template<class Component>
+	Component* column() noexcept
+	{
+		return std::get<Component*>(mColumns);
+	}
+
+	template<class Component>
+	const Component* column() const noexcept
+	{
+		return std::get<Component*>(mColumns);
+	}
+
+	const unsigned long* entities() const noexcept
+	{
+		return mEntities;
+	}
+
+	/*
+	Calls f(begin, count) for each chunk, begin is a multiple of chunkSize and count is chunkSize except possibly for the last chunk.
+	f can read and write the whole chunk including the padding at the end of the last chunk, the padding doesn't hold anything useful.
+	*/
+	template<class F>
+	void forEachChunk(F&& f)
+	{
+		for(size_type begin = 0u; begin < mSize; begin += chunkSize)
+		{
+			f(begin, mSize - begin < chunkSize ? mSize - begin : chunkSize);
+		}
+	}
+};
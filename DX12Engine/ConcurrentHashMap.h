@@ -0,0 +1,129 @@
+#pragma once
+#include "FastIterationHashSet.h"
+#include <shared_mutex>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#pragma warning(push)
+#pragma warning(disable:4324) //warns about padding due to over alignment
+
+/*
+* A FastIterationHashMap split into shardCount shards that each have their own reader-writer lock,
+* so threads working on different keys rarely wait for each other.
+* Values are only accessed through the visit functions which hold the shard's lock while calling the given function,
+* because inserting or erasing can move every value in the shard. The function shouldn't take long and mustn't use the map.
+*/
+template<class Key, class T, class Hasher = std::hash<Key>, class EqualTo = std::equal_to<>, std::size_t shardCount = 16u>
+class ConcurrentHashMap
+{
+	static_assert(shardCount != 0u && (shardCount & (shardCount - 1u)) == 0u, "shardCount must be a power of 2");
+#if __cplusplus >= 201703L
+	static constexpr std::size_t hardwareDestructiveInterferenceSize
+		= std::hardware_destructive_interference_size;
+#else
+	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
+#endif
+
+	using Map = FastIterationHashMap<Key, T, Hasher, EqualTo>;
+
+	class alignas(hardwareDestructiveInterferenceSize) Shard
+	{
+	public:
+		mutable std::shared_mutex mutex;
+		Map map;
+	};
+
+	Shard mShards[shardCount];
+	Hasher mHasher;
+
+	/*
+	The shard is picked with the high bits of a multiplicative hash as the maps in each shard use the low bits of the hash.
+	*/
+	Shard& shard(const Key& key) noexcept
+	{
+		const std::uint64_t hash = static_cast<std::uint64_t>(mHasher(key)) * 0x9e3779b97f4a7c15u;
+		return mShards[static_cast<std::size_t>(hash >> 32u) & (shardCount - 1u)];
+	}
+
+	const Shard& shard(const Key& key) const noexcept
+	{
+		return const_cast<ConcurrentHashMap&>(*this).shard(key);
+	}
+public:
+	/*
+	Calls f with the value for key while no other thread can access it. Returns false without calling f if key isn't in the map.
+	*/
+	template<class F>
+	bool visit(const Key& key, F&& f)
+	{
+		Shard& keyShard = shard(key);
+		std::lock_guard<std::shared_mutex> lock(keyShard.mutex);
+		auto value = keyShard.map.find(key);
+		if (value == keyShard.map.end()) return false;
+		f(*value);
+		return true;
+	}
+
+	/*
+	Like visit but other threads can read the value at the same time.
+	*/
+	template<class F>
+	bool visitShared(const Key& key, F&& f) const
+	{
+		const Shard& keyShard = shard(key);
+		std::shared_lock<std::shared_mutex> lock(keyShard.mutex);
+		auto value = keyShard.map.find(key);
+		if (value == keyShard.map.end()) return false;
+		f(*value);
+		return true;
+	}
+
+	/*
+	Calls f with the value for key, inserting a default constructed value first if key isn't in the map.
+	*/
+	template<class F>
+	void visitOrInsert(const Key& key, F&& f)
+	{
+		Shard& keyShard = shard(key);
+		std::lock_guard<std::shared_mutex> lock(keyShard.mutex);
+		auto value = keyShard.map.find(key);
+		if (value == keyShard.map.end())
+		{
+			keyShard.map.insert(key, T{});
+			value = keyShard.map.find(key);
+		}
+		f(*value);
+	}
+
+	/*
+	Calls f with the value for key and erases it if f returns true. Returns false without calling f if key isn't in the map.
+	*/
+	template<class F>
+	bool visitAndMaybeErase(const Key& key, F&& f)
+	{
+		Shard& keyShard = shard(key);
+		std::lock_guard<std::shared_mutex> lock(keyShard.mutex);
+		auto value = keyShard.map.find(key);
+		if (value == keyShard.map.end()) return false;
+		if (f(*value)) keyShard.map.erase(key);
+		return true;
+	}
+
+	/*
+	The number of values. Only exact if no other thread is changing the map.
+	*/
+	std::size_t size() const
+	{
+		std::size_t total = 0u;
+		for (const Shard& keyShard : mShards)
+		{
+			std::shared_lock<std::shared_mutex> lock(keyShard.mutex);
+			total += keyShard.map.size();
+		}
+		return total;
+	}
+};
+
+#pragma warning(pop)
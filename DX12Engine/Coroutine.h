@@ -0,0 +1,256 @@
+#pragma once
+#include "CoroutineFramePool.h"
+#include <coroutine>
+#include <exception>
+#include <cstddef>
+#include "AsynchronousFileManager.h"
+#include "StreamingManager.h"
+#include "BackgroundPriority.h"
+
+/*
+A coroutine that runs on TaskShedular threads. It starts running on the calling thread and destroys itself when it finishes.
+The first parameter of the coroutine must be the calling thread's ThreadResources, which must have a CoroutineFramePool called coroutineFramePool.
+Every co_await returns the ThreadResources of the thread the coroutine was resumed on.
+Callbacks resume the coroutine directly or push it straight onto a background or primary queue so there are no extra hops.
+*/
+class Coroutine
+{
+public:
+	class promise_type
+	{
+	public:
+		void* threadResources;
+
+		template<class ThreadResources, class... Args>
+		promise_type(ThreadResources& threadResources1, Args&...) noexcept : threadResources(&threadResources1) {}
+
+		template<class ThreadResources, class... Args>
+		static void* operator new(std::size_t size, ThreadResources& threadResources, Args&...)
+		{
+			return threadResources.coroutineFramePool.allocate(size);
+		}
+
+		static void operator delete(void* frame) noexcept
+		{
+			CoroutineFramePool::deallocate(frame);
+		}
+
+		Coroutine get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+	using Handle = std::coroutine_handle<promise_type>;
+private:
+	static void resume(Handle handle, void* threadResources)
+	{
+		handle.promise().threadResources = threadResources;
+		handle.resume();
+	}
+
+	template<class ThreadResources>
+	static void resumeTask(void* address, ThreadResources& threadResources)
+	{
+		resume(Handle::from_address(address), &threadResources);
+	}
+
+	/*
+	Calls start when the coroutine suspends. start must arrange for the coroutine to be resumed through handle.
+	handle must not be used by the awaiter after start is called as the coroutine might already have been resumed.
+	*/
+	template<class ThreadResources, class Start>
+	class CallbackAwaiter
+	{
+		Handle& handle;
+		Start start;
+	public:
+		CallbackAwaiter(Handle& handle1, Start start1) : handle(handle1), start(start1) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(Handle handle1)
+		{
+			handle = handle1;
+			start(*static_cast<ThreadResources*>(handle1.promise().threadResources));
+		}
+
+		ThreadResources& await_resume() const noexcept
+		{
+			return *static_cast<ThreadResources*>(handle.promise().threadResources);
+		}
+	};
+
+	template<class ThreadResources, class Start>
+	static CallbackAwaiter<ThreadResources, Start> makeAwaiter(Handle& handle, Start start)
+	{
+		return CallbackAwaiter<ThreadResources, Start>(handle, start);
+	}
+public:
+	/*
+	Resumes the coroutine from a background task.
+	*/
+	template<class ThreadResources>
+	class SwitchToBackground
+	{
+		Handle handle;
+		BackgroundPriority priority;
+	public:
+		SwitchToBackground(BackgroundPriority priority1 = BackgroundPriority::normal) noexcept : priority(priority1) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(Handle handle1)
+		{
+			handle = handle1;
+			ThreadResources& threadResources = *static_cast<ThreadResources*>(handle1.promise().threadResources);
+			threadResources.taskShedular.pushBackgroundTask({ handle1.address(), resumeTask<ThreadResources> }, priority);
+		}
+
+		ThreadResources& await_resume() const noexcept
+		{
+			return *static_cast<ThreadResources*>(handle.promise().threadResources);
+		}
+	};
+
+	/*
+	Resumes the coroutine the next time primary phase phaseIndex runs. Must be awaited on a primary thread.
+	*/
+	template<class ThreadResources>
+	class SwitchToPrimary
+	{
+		Handle handle;
+		std::size_t phaseIndex;
+	public:
+		SwitchToPrimary(std::size_t phaseIndex1) noexcept : phaseIndex(phaseIndex1) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(Handle handle1)
+		{
+			handle = handle1;
+			ThreadResources& threadResources = *static_cast<ThreadResources*>(handle1.promise().threadResources);
+			threadResources.taskShedular.pushPrimaryTask(phaseIndex, { handle1.address(), resumeTask<ThreadResources> });
+		}
+
+		ThreadResources& await_resume() const noexcept
+		{
+			return *static_cast<ThreadResources*>(handle.promise().threadResources);
+		}
+	};
+
+	/*
+	A file read that lives in the coroutine frame.
+	*/
+	template<class ThreadResources>
+	class ReadRequest : public AsynchronousFileManager::ReadRequest
+	{
+		Handle handle;
+		const unsigned char* mData = nullptr;
+	public:
+		ReadRequest(unsigned long long start, unsigned long long end) :
+			AsynchronousFileManager::ReadRequest(start, end,
+				[](AsynchronousFileManager::ReadRequest& request, AsynchronousFileManager&, void* tr, const unsigned char* data)
+				{
+					auto& readRequest = static_cast<ReadRequest&>(request);
+					readRequest.mData = data;
+					resume(readRequest.handle, tr);
+				},
+				[](AsynchronousFileManager::ReadRequest& request, void* tr)
+				{
+					resume(static_cast<ReadRequest&>(request).handle, tr);
+				})
+		{}
+
+		/*
+		Only valid between the read finishing and the request being discarded.
+		*/
+		const unsigned char* data() const noexcept
+		{
+			return mData;
+		}
+
+		/*
+		Resumes on the thread that completed the read once data() is available.
+		*/
+		auto read(AsynchronousFileManager& asynchronousFileManager)
+		{
+			return makeAwaiter<ThreadResources>(handle, [this, &asynchronousFileManager](ThreadResources&)
+				{
+					asynchronousFileManager.read(*this);
+				});
+		}
+
+		/*
+		Resumes once the data is no longer needed by this request.
+		*/
+		auto discard(AsynchronousFileManager& asynchronousFileManager)
+		{
+			return makeAwaiter<ThreadResources>(handle, [this, &asynchronousFileManager](ThreadResources&)
+				{
+					asynchronousFileManager.discard(*this);
+				});
+		}
+	};
+
+	/*
+	Space in the StreamingManager's upload buffer that lives in the coroutine frame.
+	*/
+	template<class ThreadResources>
+	class StreamingRequest : public StreamingManager::StreamingRequest
+	{
+		Handle handle;
+
+		static void resumeOnBackgroundThread(StreamingManager::StreamingRequest* request, void* tr)
+		{
+			//The StreamingManager is an actor so the coroutine shouldn't run inside it.
+			ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
+			threadResources.taskShedular.pushBackgroundTask({ static_cast<StreamingRequest*>(request)->handle.address(), resumeTask<ThreadResources> });
+		}
+	public:
+		StreamingRequest(unsigned long resourceSize1)
+		{
+			resourceSize = resourceSize1;
+			streamResource = resumeOnBackgroundThread;
+			deleteStreamingRequest = resumeOnBackgroundThread;
+		}
+
+		/*
+		Resumes from a background task once resourceSize bytes have been allocated in the upload buffer.
+		They can be found using uploadBufferCurrentCpuAddress, uploadResource and uploadResourceOffset.
+		*/
+		auto allocateUploadSpace(StreamingManager& streamingManager)
+		{
+			return makeAwaiter<ThreadResources>(handle, [this, &streamingManager](ThreadResources& threadResources)
+				{
+					streamingManager.addUploadRequest(this, threadResources);
+				});
+		}
+
+		/*
+		Must be awaited on the thread that recorded the copy into its streaming copy command list.
+		Resumes once the GPU has finished the copy.
+		*/
+		auto copyFinished()
+		{
+			return makeAwaiter<ThreadResources>(handle, [this](ThreadResources& threadResources)
+				{
+					threadResources.streamingManager.addCopyCompletionEvent(this, [](void* requester, void* tr)
+						{
+							resume(static_cast<StreamingRequest*>(requester)->handle, tr);
+						});
+				});
+		}
+
+		/*
+		Frees the upload buffer space. Resumes from a background task once the request can be destroyed.
+		*/
+		auto freeUploadSpace(StreamingManager& streamingManager)
+		{
+			return makeAwaiter<ThreadResources>(handle, [this, &streamingManager](ThreadResources& threadResources)
+				{
+					streamingManager.uploadFinished(this, threadResources);
+				});
+		}
+	};
+};
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include "SinglyLinked.h"
+#include "UnorderedMultiProducerSingleConsumerQueue.h"
+#include <cstddef>
+#include <new>
+
+/*
+Allocates coroutine frames from a few power of two size classes so that starting a coroutine doesn't normally need a heap allocation.
+Only the thread that owns the pool can allocate from it but frames can be freed by any thread.
+Freed frames are returned to the owning pool with a single lock free push and are all reclaimed at once when the owner runs out of free frames.
+*/
+class CoroutineFramePool
+{
+	constexpr static std::size_t smallestBlockSize = 256u;
+	constexpr static std::size_t sizeClassCount = 8u; //The largest size class is 32KiB, bigger frames use operator new.
+
+	class alignas(alignof(std::max_align_t)) Header
+	{
+	public:
+		CoroutineFramePool* owner; //nullptr if the frame was too big to pool
+		std::size_t sizeClass;
+	};
+
+	SinglyLinked* mFreeBlocks[sizeClassCount];
+	UnorderedMultiProducerSingleConsumerQueue mReturnedBlocks[sizeClassCount];
+
+	constexpr static std::size_t blockSize(std::size_t sizeClass) noexcept
+	{
+		return smallestBlockSize << sizeClass;
+	}
+
+	static void freeBlocks(SinglyLinked* block) noexcept
+	{
+		while (block != nullptr)
+		{
+			SinglyLinked* next = block->next;
+			::operator delete(static_cast<void*>(block));
+			block = next;
+		}
+	}
+public:
+	CoroutineFramePool() noexcept
+	{
+		for (auto& freeBlocks : mFreeBlocks)
+		{
+			freeBlocks = nullptr;
+		}
+	}
+
+	CoroutineFramePool(const CoroutineFramePool&) = delete;
+	CoroutineFramePool& operator=(const CoroutineFramePool&) = delete;
+
+	/*
+	All frames must have been freed.
+	*/
+	~CoroutineFramePool()
+	{
+		for (std::size_t i = 0u; i != sizeClassCount; ++i)
+		{
+			freeBlocks(mFreeBlocks[i]);
+			freeBlocks(mReturnedBlocks[i].popAll());
+		}
+	}
+
+	/*
+	Must be called by the thread that owns the pool.
+	*/
+	void* allocate(std::size_t size)
+	{
+		const std::size_t totalSize = size + sizeof(Header);
+		std::size_t sizeClass = 0u;
+		while (sizeClass != sizeClassCount && blockSize(sizeClass) < totalSize)
+		{
+			++sizeClass;
+		}
+
+		void* memory;
+		CoroutineFramePool* owner;
+		if (sizeClass == sizeClassCount)
+		{
+			memory = ::operator new(totalSize);
+			owner = nullptr;
+		}
+		else
+		{
+			SinglyLinked* block = mFreeBlocks[sizeClass];
+			if (block == nullptr)
+			{
+				block = mReturnedBlocks[sizeClass].popAll();
+			}
+			if (block != nullptr)
+			{
+				mFreeBlocks[sizeClass] = block->next;
+				memory = block;
+			}
+			else
+			{
+				memory = ::operator new(blockSize(sizeClass));
+			}
+			owner = this;
+		}
+		Header* header = new(memory) Header{ owner, sizeClass };
+		return header + 1;
+	}
+
+	/*
+	Can be called from any thread.
+	*/
+	static void deallocate(void* frame) noexcept
+	{
+		Header* header = static_cast<Header*>(frame) - 1;
+		CoroutineFramePool* owner = header->owner;
+		const std::size_t sizeClass = header->sizeClass;
+		if (owner == nullptr)
+		{
+			::operator delete(static_cast<void*>(header));
+			return;
+		}
+		SinglyLinked* block = new(static_cast<void*>(header)) SinglyLinked;
+		owner->mReturnedBlocks[sizeClass].push(block);
+	}
+};
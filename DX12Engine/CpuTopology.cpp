@@ -0,0 +1,225 @@
+#include "CpuTopology.h"
+#include <algorithm>
+#include <thread>
+#if defined(_WIN32)
+#include <windows.h>
+#undef min
+#undef max
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#endif
+
+#if defined(__linux__)
+namespace
+{
+	bool readUnsigned(const std::string& path, unsigned int& value)
+	{
+		std::ifstream file(path);
+		return static_cast<bool>(file >> value);
+	}
+
+	/*
+	Parses a cpu list like "0-3,8,10-11" calling f with each cpu.
+	*/
+	template<class F>
+	bool readCpuList(const std::string& path, F&& f)
+	{
+		std::ifstream file(path);
+		std::string list;
+		if (!std::getline(file, list)) return false;
+		const char* position = list.c_str();
+		while (*position >= '0' && *position <= '9')
+		{
+			char* end;
+			const unsigned long first = std::strtoul(position, &end, 10);
+			unsigned long last = first;
+			if (*end == '-') last = std::strtoul(end + 1, &end, 10);
+			for (unsigned long cpu = first; cpu <= last; ++cpu)
+			{
+				f(static_cast<unsigned int>(cpu));
+			}
+			position = *end == ',' ? end + 1 : end;
+		}
+		return true;
+	}
+
+	unsigned int readLastLevelCacheId(const std::string& cpuPath)
+	{
+		unsigned int cacheId = CpuTopology::unknownCache;
+		unsigned int highestLevel = 0u;
+		for (unsigned int index = 0u;; ++index)
+		{
+			const std::string cachePath = cpuPath + "/cache/index" + std::to_string(index);
+			unsigned int level;
+			if (!readUnsigned(cachePath + "/level", level)) break;
+			if (level < highestLevel) continue;
+			unsigned int firstCpu = CpuTopology::unknownCache;
+			readCpuList(cachePath + "/shared_cpu_list", [&firstCpu](unsigned int cpu)
+				{
+					if (cpu < firstCpu) firstCpu = cpu;
+				});
+			highestLevel = level;
+			cacheId = firstCpu;
+		}
+		return cacheId;
+	}
+}
+#endif
+
+CpuTopology::CpuTopology()
+{
+#if defined(_WIN32)
+	DWORD byteSize = 0u;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &byteSize);
+	std::unique_ptr<char[]> buffer(new char[byteSize]);
+	if (byteSize == 0u || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.get()), &byteSize))
+	{
+		makeFlat(std::thread::hardware_concurrency());
+		return;
+	}
+
+	const auto forEachInformation = [&buffer, byteSize](auto&& f)
+	{
+		for (DWORD offset = 0u; offset < byteSize;)
+		{
+			const auto& information = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.get() + offset);
+			f(information);
+			offset += information.Size;
+		}
+	};
+	const auto forEachProcessor = [](const GROUP_AFFINITY& groupMask, auto&& f)
+	{
+		for (unsigned int bit = 0u; bit != sizeof(KAFFINITY) * 8u; ++bit)
+		{
+			if ((groupMask.Mask & (static_cast<KAFFINITY>(1u) << bit)) != 0u) f(groupMask.Group * static_cast<unsigned int>(sizeof(KAFFINITY) * 8u) + bit);
+		}
+	};
+
+	unsigned int processorCount = 0u;
+	forEachInformation([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& information)
+		{
+			if (information.Relationship == RelationProcessorCore) forEachProcessor(information.Processor.GroupMask[0], [&processorCount](unsigned int) { ++processorCount; });
+		});
+	if (processorCount == 0u)
+	{
+		makeFlat(std::thread::hardware_concurrency());
+		return;
+	}
+	mProcessors.reset(new LogicalProcessor[processorCount]);
+	mProcessorCount = 0u;
+	unsigned int coreId = 0u;
+	forEachInformation([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& information)
+		{
+			if (information.Relationship != RelationProcessorCore) return;
+			forEachProcessor(information.Processor.GroupMask[0], [&](unsigned int id)
+				{
+					mProcessors[mProcessorCount] = { id, coreId, unknownCache, 0u };
+					++mProcessorCount;
+				});
+			++coreId;
+		});
+	const auto setForProcessors = [this, &forEachProcessor](const GROUP_AFFINITY& groupMask, auto&& set)
+	{
+		forEachProcessor(groupMask, [&](unsigned int id)
+			{
+				for (unsigned int i = 0u; i != mProcessorCount; ++i)
+				{
+					if (mProcessors[i].id == id) set(mProcessors[i]);
+				}
+			});
+	};
+	unsigned int packageId = 0u;
+	forEachInformation([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& information)
+		{
+			if (information.Relationship == RelationProcessorPackage)
+			{
+				for (WORD i = 0u; i != information.Processor.GroupCount; ++i)
+				{
+					setForProcessors(information.Processor.GroupMask[i], [packageId](LogicalProcessor& processor) { processor.packageId = packageId; });
+				}
+				++packageId;
+			}
+			else if (information.Relationship == RelationCache && information.Cache.Level == 3u)
+			{
+				unsigned int cacheId = unknownCache;
+				forEachProcessor(information.Cache.GroupMask, [&cacheId](unsigned int id) { if (id < cacheId) cacheId = id; });
+				setForProcessors(information.Cache.GroupMask, [cacheId](LogicalProcessor& processor) { processor.cacheId = cacheId; });
+			}
+		});
+#elif defined(__linux__)
+	const std::string cpuDirectory = "/sys/devices/system/cpu/";
+	unsigned int processorCount = 0u;
+	if (!readCpuList(cpuDirectory + "online", [&processorCount](unsigned int) { ++processorCount; }) || processorCount == 0u)
+	{
+		makeFlat(std::thread::hardware_concurrency());
+		return;
+	}
+	mProcessors.reset(new LogicalProcessor[processorCount]);
+	mProcessorCount = 0u;
+	bool succeeded = true;
+	readCpuList(cpuDirectory + "online", [&](unsigned int id)
+		{
+			if (mProcessorCount == processorCount) return;
+			const std::string cpuPath = cpuDirectory + "cpu" + std::to_string(id);
+			LogicalProcessor& processor = mProcessors[mProcessorCount];
+			processor.id = id;
+			succeeded = readUnsigned(cpuPath + "/topology/core_id", processor.coreId) && readUnsigned(cpuPath + "/topology/physical_package_id", processor.packageId) && succeeded;
+			processor.cacheId = readLastLevelCacheId(cpuPath);
+			++mProcessorCount;
+		});
+	if (!succeeded || mProcessorCount != processorCount)
+	{
+		makeFlat(processorCount);
+		return;
+	}
+#else
+	makeFlat(std::thread::hardware_concurrency());
+	return;
+#endif
+	sort();
+}
+
+void CpuTopology::makeFlat(unsigned int processorCount)
+{
+	if (processorCount == 0u) processorCount = 1u;
+	mProcessors.reset(new LogicalProcessor[processorCount]);
+	mProcessorCount = processorCount;
+	for (unsigned int i = 0u; i != processorCount; ++i)
+	{
+		mProcessors[i] = { i, i, unknownCache, 0u };
+	}
+}
+
+void CpuTopology::sort() noexcept
+{
+	std::sort(mProcessors.get(), mProcessors.get() + mProcessorCount, [](const LogicalProcessor& lhs, const LogicalProcessor& rhs)
+		{
+			if (lhs.packageId != rhs.packageId) return lhs.packageId < rhs.packageId;
+			if (lhs.cacheId != rhs.cacheId) return lhs.cacheId < rhs.cacheId;
+			if (lhs.coreId != rhs.coreId) return lhs.coreId < rhs.coreId;
+			return lhs.id < rhs.id;
+		});
+}
+
+bool CpuTopology::pinCurrentThread(unsigned int index) const noexcept
+{
+	const unsigned int id = processor(index).id;
+#if defined(_WIN32)
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = static_cast<WORD>(id / (sizeof(KAFFINITY) * 8u));
+	affinity.Mask = static_cast<KAFFINITY>(1u) << (id % (sizeof(KAFFINITY) * 8u));
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(id, &cpuSet);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+	(void)id;
+	return false;
+#endif
+}
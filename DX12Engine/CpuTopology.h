@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+
+/*
+The logical processors in the machine ordered so that processors that share a core are next to each other,
+then processors that share a last level cache and then processors in the same package.
+Giving thread i the processor at index i makes threads with close indices close in hardware.
+*/
+class CpuTopology
+{
+public:
+	constexpr static unsigned int unknownCache = ~0u;
+
+	class LogicalProcessor
+	{
+	public:
+		unsigned int id; //the number used to set a thread's affinity
+		unsigned int coreId;
+		unsigned int cacheId; //the lowest id of the processors sharing the last level cache or unknownCache
+		unsigned int packageId;
+	};
+
+	enum class Distance : unsigned int
+	{
+		sameCore,
+		sameCache,
+		samePackage,
+		differentPackage,
+	};
+	constexpr static unsigned int distanceCount = 4u;
+private:
+	std::unique_ptr<LogicalProcessor[]> mProcessors;
+	unsigned int mProcessorCount;
+
+	void makeFlat(unsigned int processorCount);
+	void sort() noexcept;
+public:
+	/*
+	Reads the topology from /sys/devices/system/cpu on Linux or GetLogicalProcessorInformationEx on Windows.
+	If it can't be read every processor is treated as its own core in one package.
+	*/
+	CpuTopology();
+
+	unsigned int processorCount() const noexcept
+	{
+		return mProcessorCount;
+	}
+
+	const LogicalProcessor& processor(unsigned int index) const noexcept
+	{
+		return mProcessors[index % mProcessorCount];
+	}
+
+	Distance distance(unsigned int index1, unsigned int index2) const noexcept
+	{
+		const LogicalProcessor& processor1 = processor(index1);
+		const LogicalProcessor& processor2 = processor(index2);
+		if (processor1.packageId != processor2.packageId) return Distance::differentPackage;
+		if (processor1.coreId == processor2.coreId) return Distance::sameCore;
+		if (processor1.cacheId != unknownCache && processor1.cacheId == processor2.cacheId) return Distance::sameCache;
+		return Distance::samePackage;
+	}
+
+	/*
+	Pins the calling thread to the processor at index. Returns false if the affinity couldn't be set.
+	*/
+	bool pinCurrentThread(unsigned int index) const noexcept;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <d3d12.h>
 #include "HresultException.h"
+#include "TriviallyRelocatable.h"
 
 class D3D12Heap
 {
@@ -71,4 +72,8 @@ public:
 	{
 		if (data) data->Release();
 	}
-};
\ No newline at end of file
+};
+
+//only holds a COM pointer
+template<>
+class IsTriviallyRelocatable<D3D12Heap> : public std::true_type {};
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <d3d12.h>
 #include "ID3D12ResourceCreationFailedException.h"
 #include <cstdint>
+#include "TriviallyRelocatable.h"
 
 class D3D12Resource
 {
@@ -109,4 +110,8 @@ public:
 	{
 		if (data) data->Release();
 	}
-};
\ No newline at end of file
+};
+
+//only holds a COM pointer
+template<>
+class IsTriviallyRelocatable<D3D12Resource> : public std::true_type {};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include <type_traits>
 #include <utility>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
 
 template<class T>
 class Delegate;
@@ -17,7 +20,7 @@ public:
 		function(function) {}
 		
 	Delegate(void* context, R (*function)(void* context, Args... args)) noexcept :
-		function(function), context(context) {}
+		context(context), function(function) {}
 	
 	Delegate(const Delegate& other) noexcept = default;
 		
@@ -32,6 +35,15 @@ public:
 	{
 		return context != other.context || function != other.function;
 	}
+
+	class Hash
+	{
+	public:
+		std::size_t operator()(const Delegate& delegate) const noexcept
+		{
+			return std::hash<void*>()(delegate.context) ^ std::hash<std::uintptr_t>()(reinterpret_cast<std::uintptr_t>(delegate.function));
+		}
+	};
 		
 	template<class C, R (C::*memberFunction)(Args... args)>
 	static Delegate make(C* c) noexcept
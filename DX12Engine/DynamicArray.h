@@ -1,6 +1,7 @@
 #pragma once
 #include <initializer_list>
 #include <memory>
+#include <type_traits>
 
 template<class Element, class Allocator = std::allocator<Element>>
 class DynamicArray : private Allocator
@@ -75,7 +76,7 @@ public:
 		}
 	}
 
-	template<typename Functor, typename Return = typename std::result_of_t<Functor(std::size_t)> >
+	template<typename Functor, typename Return = std::invoke_result_t<Functor, std::size_t> >
 	DynamicArray(const Size size, Functor& initializer, typename std::enable_if<true, Return>::type* = nullptr) :
 	{
 		buffer = this->allocate(size.size);
@@ -100,7 +101,7 @@ public:
 		}
 	}
 	
-	template<typename Functor, typename = typename std::result_of_t<Functor(std::size_t, Element&)> >
+	template<typename Functor, typename = std::invoke_result_t<Functor, std::size_t, Element&> >
 	DynamicArray(const Size size, Functor& initializer)
 	{
 		buffer = this->allocate(size.size);
@@ -1,12 +1,152 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <new>
 
+/*
+Makes entity IDs that can be recycled once the entity is gone, so the range of indices in use stays as small as the number of live entities.
+An entity ID holds an index in its low indexBits bits and a generation in the rest. Recycling an entity increases the generation stored for its index,
+so an old ID for a reused index no longer matches and lookups keyed by the index can tell the IDs apart.
+The generation wraps around after 2^generationBits reuses of an index.
+Recycled indices are kept on a lock free stack so generate and recycle can be called from any thread.
+*/
 class EntityGenerator
 {
-	std::atomic<unsigned long> nextValue;
 public:
-	unsigned long generate() noexcept
+	constexpr static unsigned int indexBits = 24u;
+	constexpr static unsigned int generationBits = 8u;
+	constexpr static unsigned long maxEntities = 1ul << indexBits;
+private:
+	constexpr static unsigned long indexMask = maxEntities - 1u;
+	constexpr static unsigned long generationMask = (1ul << generationBits) - 1u;
+	constexpr static std::uint32_t noFreeIndex = 0u; //free list links hold index + 1 so 0 can mean none
+	constexpr static std::size_t pageSize = 4096u;
+	constexpr static std::size_t pageCount = maxEntities / pageSize;
+
+	class Slot
+	{
+	public:
+		std::atomic<std::uint32_t> generation;
+		std::atomic<std::uint32_t> nextFree;
+	};
+
+	std::atomic<Slot*> mPages[pageCount]; //pages are made when an index in them is first used and live as long as the EntityGenerator
+	std::atomic<unsigned long> mNextIndex; //indices at or above this have never been used
+	std::atomic<std::uint64_t> mFreeList; //high 32 bits are a tag that changes on each pop to stop ABA, low 32 bits are the first free index + 1
+
+	Slot& slot(unsigned long index) noexcept
+	{
+		return mPages[index / pageSize].load(std::memory_order_acquire)[index % pageSize];
+	}
+
+	void makePage(std::size_t page)
+	{
+		if(mPages[page].load(std::memory_order_acquire) != nullptr) return;
+		Slot* newPage = new Slot[pageSize];
+		for(std::size_t i = 0u; i != pageSize; ++i)
+		{
+			newPage[i].generation.store(0u, std::memory_order_relaxed);
+			newPage[i].nextFree.store(noFreeIndex, std::memory_order_relaxed);
+		}
+		Slot* expected = nullptr;
+		if(!mPages[page].compare_exchange_strong(expected, newPage, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			delete[] newPage;
+		}
+	}
+
+	unsigned long popFreeIndex() noexcept
+	{
+		std::uint64_t head = mFreeList.load(std::memory_order_acquire);
+		while(true)
+		{
+			const std::uint32_t first = static_cast<std::uint32_t>(head);
+			if(first == noFreeIndex) return maxEntities;
+			const std::uint32_t next = slot(first - 1u).nextFree.load(std::memory_order_relaxed);
+			const std::uint64_t newHead = ((head >> 32u) + 1u) << 32u | next;
+			if(mFreeList.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire)) return first - 1u;
+		}
+	}
+
+	void pushFreeIndex(unsigned long index) noexcept
+	{
+		Slot& freeSlot = slot(index);
+		std::uint64_t head = mFreeList.load(std::memory_order_relaxed);
+		std::uint64_t newHead;
+		do
+		{
+			freeSlot.nextFree.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+			newHead = (head & 0xffffffff00000000u) | static_cast<std::uint32_t>(index + 1u);
+		} while(!mFreeList.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+	}
+public:
+	EntityGenerator() noexcept : mNextIndex(0u), mFreeList(noFreeIndex)
+	{
+		for(auto& page : mPages)
+		{
+			page.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	EntityGenerator(const EntityGenerator&) = delete;
+	EntityGenerator& operator=(const EntityGenerator&) = delete;
+
+	~EntityGenerator()
+	{
+		for(auto& page : mPages)
+		{
+			delete[] page.load(std::memory_order_relaxed);
+		}
+	}
+
+	static unsigned long indexOf(unsigned long entity) noexcept
+	{
+		return entity & indexMask;
+	}
+
+	static unsigned long generationOf(unsigned long entity) noexcept
+	{
+		return (entity >> indexBits) & generationMask;
+	}
+
+	/*
+	Throws std::bad_alloc if all maxEntities indices are in use.
+	*/
+	unsigned long generate()
+	{
+		unsigned long index = popFreeIndex();
+		if(index == maxEntities)
+		{
+			//mNextIndex never goes past maxEntities so isAlive and slot stay in bounds.
+			index = mNextIndex.load(std::memory_order_relaxed);
+			do
+			{
+				if(index == maxEntities) throw std::bad_alloc();
+			} while(!mNextIndex.compare_exchange_weak(index, index + 1u, std::memory_order_relaxed, std::memory_order_relaxed));
+			makePage(index / pageSize);
+		}
+		return index | (static_cast<unsigned long>(slot(index).generation.load(std::memory_order_relaxed)) << indexBits);
+	}
+
+	/*
+	entity must not be used after this.
+	*/
+	void recycle(unsigned long entity) noexcept
+	{
+		const unsigned long index = indexOf(entity);
+		assert(isAlive(entity));
+		Slot& recycledSlot = slot(index);
+		recycledSlot.generation.store(static_cast<std::uint32_t>((generationOf(entity) + 1u) & generationMask), std::memory_order_relaxed);
+		pushFreeIndex(index);
+	}
+
+	bool isAlive(unsigned long entity) noexcept
 	{
-		return nextValue.fetch_add(1u, std::memory_order_relaxed);
+		const unsigned long index = indexOf(entity);
+		if(index >= mNextIndex.load(std::memory_order_relaxed)) return false;
+		Slot* page = mPages[index / pageSize].load(std::memory_order_acquire);
+		return page != nullptr && page[index % pageSize].generation.load(std::memory_order_relaxed) == generationOf(entity);
 	}
-};
\ No newline at end of file
+};
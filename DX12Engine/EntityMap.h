@@ -0,0 +1,142 @@
+#pragma once
+#include "SparseEntityIndex.h"
+#include "ResizingArray.h"
+#include <cstddef>
+#include <cassert>
+#include <utility>
+
+/*
+A map from entity IDs made by EntityGenerator to values, implemented as a sparse set.
+Values are stored densely in insertion order, except that erasing moves the last value into the erased value's place.
+Finding a value takes two array lookups and no hashing. Iterating goes over the dense values.
+*/
+template<class T>
+class EntityMap
+{
+public:
+	using key_type = unsigned long;
+	using value_type = T;
+	using size_type = std::size_t;
+	using reference = T&;
+	using const_reference = const T&;
+	using iterator = T*;
+	using const_iterator = const T*;
+private:
+	ResizingArray<T> mValues;
+	ResizingArray<unsigned long> mEntities; //the entity that owns each value
+	SparseEntityIndex mIndices;
+
+	/*
+	Returns the position of entity's value or SparseEntityIndex::none.
+	*/
+	SparseEntityIndex::size_type findIndex(unsigned long entity) const noexcept
+	{
+		const auto index = mIndices.find(entity);
+		if(index == SparseEntityIndex::none || mEntities[index] != entity) return SparseEntityIndex::none;
+		return index;
+	}
+public:
+	EntityMap() = default;
+	EntityMap(EntityMap&& other) = default;
+	EntityMap& operator=(EntityMap&& other) = default;
+
+	size_type size() const noexcept
+	{
+		return mValues.size();
+	}
+
+	bool empty() const noexcept
+	{
+		return mValues.size() == 0u;
+	}
+
+	/*
+	entity must not already be in the map.
+	*/
+	template<class... Args>
+	reference emplace(unsigned long entity, Args&&... args)
+	{
+		assert(findIndex(entity) == SparseEntityIndex::none);
+		mIndices.set(entity, static_cast<SparseEntityIndex::size_type>(mValues.size()));
+		mEntities.push_back(entity);
+		return mValues.emplace_back(std::forward<Args>(args)...);
+	}
+
+	void insert(unsigned long entity, const value_type& value)
+	{
+		emplace(entity, value);
+	}
+
+	void insert(unsigned long entity, value_type&& value)
+	{
+		emplace(entity, std::move(value));
+	}
+
+	value_type eraseAndGet(unsigned long entity)
+	{
+		const auto index = findIndex(entity);
+		assert(index != SparseEntityIndex::none);
+		value_type value = std::move(mValues[index]);
+		const std::size_t last = mValues.size() - 1u;
+		if(index != last)
+		{
+			mValues[index] = std::move(mValues[last]);
+			mEntities[index] = mEntities[last];
+			mIndices.set(mEntities[index], index);
+		}
+		mIndices.reset(entity);
+		mValues.pop_back();
+		mEntities.pop_back();
+		return value;
+	}
+
+	void erase(unsigned long entity)
+	{
+		eraseAndGet(entity);
+	}
+
+	iterator find(unsigned long entity) noexcept
+	{
+		const auto index = findIndex(entity);
+		return index == SparseEntityIndex::none ? end() : begin() + index;
+	}
+
+	const_iterator find(unsigned long entity) const noexcept
+	{
+		const auto index = findIndex(entity);
+		return index == SparseEntityIndex::none ? end() : begin() + index;
+	}
+
+	bool contains(unsigned long entity) const noexcept
+	{
+		return findIndex(entity) != SparseEntityIndex::none;
+	}
+
+	/*
+	The entity that owns the value at it.
+	*/
+	unsigned long entity(const_iterator it) const noexcept
+	{
+		return mEntities[static_cast<std::size_t>(it - begin())];
+	}
+
+	iterator begin() noexcept
+	{
+		return mValues.begin();
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return mValues.begin();
+	}
+
+	iterator end() noexcept
+	{
+		return mValues.end();
+	}
+
+	const_iterator end() const noexcept
+	{
+		return mValues.end();
+	}
+};
@@ -3,10 +3,14 @@
 #include <cstddef> //std::size_t
 #include <limits> //std::numeric_limits
 #include <type_traits> //std::is_trivially_destructible_v
+#include <memory> //std::allocator_traits
+#include <climits> //CHAR_BIT
+#include <cassert>
+#include "TriviallyRelocatable.h"
 
 /*
 * Implements a set using hashing.
-* Inserting an item does not invalidate any pointers, references or iterators into the FastIterationHashMap.
+* Inserting an item only invalidates pointers, references and iterators into the FastIterationHashMap when size() == capacity().
 * Removing an item from a HashMap invalidates all pointers, references and iterators into the FastIterationHashMap.
 * Iterating a FastIterationHashMap should take similar time as iterating a std::vector of the same length and is random access.
 * SizeType should be an integral type
@@ -42,6 +46,10 @@ private:
 		using Base1 = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
 		using Traits = typename std::allocator_traits<Base1>;
 	public:
+		ValueAllocatorWrapper() = default;
+
+		explicit ValueAllocatorWrapper(const Allocator& allocator) noexcept : Base1(allocator) {}
+
 		typename Traits::value_type* allocateValue(typename Traits::size_type n)
 		{
 			return Traits::allocate(static_cast<Base1&>(*this), n);
@@ -58,6 +66,10 @@ private:
 		using Base1 = typename std::allocator_traits<Allocator>::template rebind_alloc<Key>;
 		using Traits = typename std::allocator_traits<Base1>;
 	public:
+		KeyAllocatorWrapper() = default;
+
+		explicit KeyAllocatorWrapper(const Allocator& allocator) noexcept : Base1(allocator) {}
+
 		typename Traits::value_type* allocateKey(typename Traits::size_type n)
 		{
 			return Traits::allocate(static_cast<Base1&>(*this), n);
@@ -74,6 +86,10 @@ private:
 		using Base = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
 		using Traits = typename std::allocator_traits<Base>;
 	public:
+		lookUpAllocatorWrapper() = default;
+
+		explicit lookUpAllocatorWrapper(const Allocator& allocator) noexcept : Base(allocator) {}
+
 		typename Traits::value_type* allocateLookUp(typename Traits::size_type n)
 		{
 			return Traits::allocate(static_cast<Base&>(*this), n);
@@ -188,7 +204,23 @@ private:
 			maxLoadFactor(0.5f)
 		{}
 
+		explicit Impl(const Allocator& allocator) noexcept :
+			ValueAllocatorWrapper(allocator),
+			KeyAllocatorWrapper(allocator),
+			lookUpAllocatorWrapper(allocator),
+			values(nullptr),
+			keys(nullptr),
+			lookUp(nullptr),
+			maxBucketCount(0u),
+			size(0u),
+			loadThreshold(0u),
+			maxLoadFactor(0.5f)
+		{}
+
 		Impl(Impl&& other) noexcept :
+			ValueAllocatorWrapper(static_cast<ValueAllocatorWrapper&&>(other)),
+			KeyAllocatorWrapper(static_cast<KeyAllocatorWrapper&&>(other)),
+			lookUpAllocatorWrapper(static_cast<lookUpAllocatorWrapper&&>(other)),
 			values(other.values),
 			keys(other.keys),
 			lookUp(other.lookUp),
@@ -207,7 +239,7 @@ private:
 			KeyAllocatorWrapper(static_cast<const KeyAllocatorWrapper&>(other)),
 			lookUpAllocatorWrapper(static_cast<const lookUpAllocatorWrapper&>(other))
 		{
-			copyConstruct(other);
+			copyHelper(other);
 		}
 
 		~Impl() noexcept
@@ -244,7 +276,7 @@ private:
 			static_cast<ValueAllocatorWrapper&>(*this) = static_cast<const ValueAllocatorWrapper&>(other);
 			static_cast<KeyAllocatorWrapper&>(*this) = static_cast<const KeyAllocatorWrapper&>(other);
 			static_cast<lookUpAllocatorWrapper&>(*this) = static_cast<const lookUpAllocatorWrapper&>(other);
-			copyConstruct(other);
+			copyHelper(other);
 		}
 	};
 	Impl impl;
@@ -275,20 +307,14 @@ private:
 			impl.maxBucketCount = newMaxBucketCount;
 
 			pointer newValues = impl.allocateValue(newLoadThreshold);
-			for(size_type i = 0u; i != newLoadThreshold; ++i)
-			{
-				newValues[i] = std::move(impl.values[i]);
-				impl.values[i].~value_type();
-			}
+			relocate(impl.values, impl.size, newValues);
 			impl.deallocateValue(impl.values, impl.loadThreshold);
+			impl.values = newValues;
 
 			key_type* newKeys = impl.allocateKey(newLoadThreshold);
-			for(size_type i = 0u; i != newLoadThreshold; ++i)
-			{
-				new(&newKeys[i]) key_type{ std::move(impl.keys[i]) };
-				impl.keys[i].~key_type();
-			}
+			relocate(impl.keys, impl.size, newKeys);
 			impl.deallocateKey(impl.keys, impl.loadThreshold);
+			impl.keys = newKeys;
 
 			impl.loadThreshold = newLoadThreshold;
 		}
@@ -423,6 +449,8 @@ private:
 public:
 	FastIterationHashMap() noexcept = default;
 
+	explicit FastIterationHashMap(const Allocator& allocator) noexcept : impl(allocator) {}
+
 	FastIterationHashMap(FastIterationHashMap&&) noexcept = default;
 
 	FastIterationHashMap(const FastIterationHashMap&) = default;
@@ -567,6 +595,8 @@ public:
 		const auto size = impl.size;
 		if(indexInData != size)
 		{
+			//the last item moves into the erased item's place
+			impl.lookUp[findLookUpIndex(impl.keys[size])].indexInData = indexInData;
 			impl.values[indexInData] = std::move(impl.values[size]);
 			impl.keys[indexInData] = std::move(impl.keys[size]);
 		}
@@ -596,6 +626,8 @@ public:
 		const auto size = impl.size;
 		if (indexInData != size)
 		{
+			//the last item moves into the erased item's place
+			impl.lookUp[findLookUpIndex(impl.keys[size])].indexInData = indexInData;
 			impl.values[indexInData] = std::move(impl.values[size]);
 			impl.keys[indexInData] = std::move(impl.keys[size]);
 		}
@@ -0,0 +1,230 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <new>
+
+/*
+A bump pointer allocator with a separate arena for each of frameCount frames.
+Memory allocated during a frame stays valid until the owning thread has started frameCount more frames,
+so it can be used for transient data that later frames still need to read.
+Only the thread that owns the FrameArena can allocate from it. Deallocating is only needed to reuse the memory
+of the most recent allocation, for example when a ResizingArray grows, otherwise all memory is freed by startFrame.
+In debug builds freed memory is filled with poisonByte and the most memory used in one frame is recorded.
+*/
+template<std::size_t frameCount>
+class FrameArena
+{
+	static_assert(frameCount != 0u, "FrameArena needs at least one frame");
+
+	class alignas(alignof(std::max_align_t)) Block
+	{
+	public:
+		Block* next;
+		std::size_t capacity;
+
+		unsigned char* begin() noexcept
+		{
+			return reinterpret_cast<unsigned char*>(this + 1);
+		}
+	};
+
+	class Frame
+	{
+	public:
+		Block* blocks = nullptr; //the block being allocated from is first
+		unsigned char* current = nullptr;
+		unsigned char* end = nullptr;
+		std::size_t fullBlocksSize = 0u; //bytes in blocks other than the first
+	};
+
+	Frame mFrames[frameCount];
+	unsigned int mFrameIndex = 0u;
+	std::size_t mBlockSize;
+#ifndef NDEBUG
+	std::size_t mHighWaterMark = 0u;
+#endif
+
+	static Block* allocateBlock(std::size_t capacity, Block* next)
+	{
+		Block* block = static_cast<Block*>(::operator new(sizeof(Block) + capacity));
+		block->next = next;
+		block->capacity = capacity;
+		return block;
+	}
+
+	static void freeBlocks(Block* block) noexcept
+	{
+		while (block != nullptr)
+		{
+			Block* next = block->next;
+			::operator delete(block);
+			block = next;
+		}
+	}
+
+	static std::size_t usedBytes(const Frame& frame) noexcept
+	{
+		if (frame.blocks == nullptr) return 0u;
+		return frame.fullBlocksSize + static_cast<std::size_t>(frame.current - frame.blocks->begin());
+	}
+
+	static void poison(void* memory, std::size_t size) noexcept
+	{
+#ifndef NDEBUG
+		std::memset(memory, poisonByte, size);
+#else
+		(void)memory;
+		(void)size;
+#endif
+	}
+
+	void* allocateFromNewBlock(std::size_t size, std::size_t alignment)
+	{
+		Frame& frame = mFrames[mFrameIndex];
+		const std::size_t capacity = size + alignment > mBlockSize ? size + alignment : mBlockSize;
+		if (frame.blocks != nullptr) frame.fullBlocksSize += static_cast<std::size_t>(frame.current - frame.blocks->begin());
+		frame.blocks = allocateBlock(capacity, frame.blocks);
+		frame.current = frame.blocks->begin();
+		frame.end = frame.current + capacity;
+		return allocate(size, alignment);
+	}
+public:
+	constexpr static unsigned char poisonByte = 0xcdu;
+	constexpr static std::size_t defaultBlockSize = 64u * 1024u;
+
+	template<class T>
+	class Allocator
+	{
+		template<class U>
+		friend class Allocator;
+
+		FrameArena* mArena;
+	public:
+		using value_type = T;
+
+		template<class U>
+		class rebind
+		{
+		public:
+			using other = Allocator<U>;
+		};
+
+		Allocator(FrameArena& arena) noexcept : mArena(&arena) {}
+
+		template<class U>
+		Allocator(const Allocator<U>& other) noexcept : mArena(other.mArena) {}
+
+		T* allocate(std::size_t n)
+		{
+			return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* p, std::size_t n) noexcept
+		{
+			mArena->deallocate(p, n * sizeof(T));
+		}
+
+		template<class U>
+		bool operator==(const Allocator<U>& other) const noexcept
+		{
+			return mArena == other.mArena;
+		}
+
+		template<class U>
+		bool operator!=(const Allocator<U>& other) const noexcept
+		{
+			return mArena != other.mArena;
+		}
+	};
+
+	FrameArena(std::size_t blockSize = defaultBlockSize) noexcept : mBlockSize(blockSize) {}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	~FrameArena() noexcept
+	{
+		for (Frame& frame : mFrames)
+		{
+			freeBlocks(frame.blocks);
+		}
+	}
+
+	void* allocate(std::size_t size, std::size_t alignment)
+	{
+		assert(alignment != 0u && (alignment & (alignment - 1u)) == 0u && alignment <= alignof(std::max_align_t));
+		Frame& frame = mFrames[mFrameIndex];
+		const std::uintptr_t current = reinterpret_cast<std::uintptr_t>(frame.current);
+		const std::uintptr_t aligned = (current + (alignment - 1u)) & ~static_cast<std::uintptr_t>(alignment - 1u);
+		const std::uintptr_t end = reinterpret_cast<std::uintptr_t>(frame.end);
+		if (frame.current == nullptr || aligned > end || size > static_cast<std::size_t>(end - aligned))
+		{
+			return allocateFromNewBlock(size, alignment);
+		}
+		frame.current = reinterpret_cast<unsigned char*>(aligned + size);
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	/*
+	Gives the memory back if it was the last allocation in the current frame, otherwise it is kept until the frame is reused.
+	*/
+	void deallocate(void* memory, std::size_t size) noexcept
+	{
+		if (memory == nullptr) return;
+		poison(memory, size);
+		Frame& frame = mFrames[mFrameIndex];
+		if (static_cast<unsigned char*>(memory) + size == frame.current)
+		{
+			frame.current = static_cast<unsigned char*>(memory);
+		}
+	}
+
+	/*
+	Moves to the next frame and frees everything allocated frameCount frames ago.
+	If the frame needed more than one block they are replaced with one block big enough for all of it.
+	*/
+	void startFrame()
+	{
+		mFrameIndex = mFrameIndex + 1u == frameCount ? 0u : mFrameIndex + 1u;
+		Frame& frame = mFrames[mFrameIndex];
+		if (frame.blocks == nullptr) return;
+#ifndef NDEBUG
+		const std::size_t used = usedBytes(frame);
+		if (used > mHighWaterMark) mHighWaterMark = used;
+#endif
+		if (frame.blocks->next != nullptr)
+		{
+			std::size_t capacity = 0u;
+			for (Block* block = frame.blocks; block != nullptr; block = block->next)
+			{
+				capacity += block->capacity;
+			}
+			freeBlocks(frame.blocks);
+			frame.blocks = allocateBlock(capacity, nullptr);
+		}
+		frame.current = frame.blocks->begin();
+		frame.end = frame.current + frame.blocks->capacity;
+		frame.fullBlocksSize = 0u;
+		poison(frame.current, frame.blocks->capacity);
+	}
+
+	/*
+	The number of bytes allocated so far in the current frame including padding.
+	*/
+	std::size_t bytesUsed() const noexcept
+	{
+		return usedBytes(mFrames[mFrameIndex]);
+	}
+
+#ifndef NDEBUG
+	/*
+	The most bytes used by any finished frame. Useful for picking a block size that never needs a second block.
+	*/
+	std::size_t highWaterMark() const noexcept
+	{
+		return mHighWaterMark;
+	}
+#endif
+};
@@ -68,7 +68,7 @@ private:
 	template<class T2>
 	class Iterator
 	{
-		template<class T, class Hasher, class EqualTo, class Allocator, class SizeType>
+		template<class T3, class Hasher2, class EqualTo2, class Allocator2, class SizeType2>
 		friend class HashSet;
 		template<typename U>
 		friend class Iterator;
@@ -170,8 +170,12 @@ private:
 	class AllocatorWrapper : private std::allocator_traits<Allocator>::template rebind_alloc<Node>
 	{
 		using Base = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
-		using Traits = std::allocator_traits<typename Base>;
+		using Traits = std::allocator_traits<Base>;
 	public:
+		AllocatorWrapper() = default;
+
+		explicit AllocatorWrapper(const Allocator& allocator) noexcept : Base(allocator) {}
+
 		typename Traits::value_type* allocate(typename Traits::size_type n)
 		{
 			return Traits::allocate(*static_cast<Base*>(this), n);
@@ -208,7 +212,6 @@ private:
 				mSize = other.mSize;
 				loadThreshold = other.loadThreshold;
 				maxLoadFactor = other.maxLoadFactor;
-				const auto maxBucketCountTemp = maxBucketCount;
 				for (size_type i = 0u; i != maxBucketCountTemp; ++i)
 				{
 					new(&data[i]) HashSet::Node(other.data[i]);
@@ -251,7 +254,17 @@ private:
 			maxLoadFactor(0.5f)
 		{}
 
+		explicit Impl(const Allocator& allocator) noexcept :
+			AllocatorWrapper(allocator),
+			data(nullptr),
+			maxBucketCount(0u),
+			mSize(0u),
+			loadThreshold(0u),
+			maxLoadFactor(0.5f)
+		{}
+
 		Impl(Impl&& other) noexcept :
+			AllocatorWrapper(static_cast<AllocatorWrapper&&>(other)),
 			data(other.data),
 			maxBucketCount(other.maxBucketCount),
 			mSize(other.mSize),
@@ -361,7 +374,7 @@ private:
 		{
 			if(bucket->distanceFromIdealPosition() == 0)
 			{
-				bucket->data() = std::move(value);
+				new(&bucket->data()) value_type(std::move(value));
 				bucket->distanceFromIdealPosition() = distanceFromIdealBucket;
 				break;
 			}
@@ -385,7 +398,7 @@ private:
 		{
 			if(bucket->distanceFromIdealPosition() == 0)
 			{
-				bucket->data() = std::move(value);
+				new(&bucket->data()) value_type(std::move(value));
 				bucket->distanceFromIdealPosition() = distanceFromIdealBucket;
 				return iterator(bucket);
 			}
@@ -454,6 +467,8 @@ private:
 public:
 	HashSet() noexcept = default;
 
+	explicit HashSet(const Allocator& allocator) noexcept : impl(allocator) {}
+
 	HashSet(HashSet&&) noexcept = default;
 
 	HashSet(const HashSet&) = default;
@@ -0,0 +1,212 @@
+#pragma once
+#include "ResizingArray.h"
+#include <functional>
+#include <cstddef>
+#include <limits>
+#include <cassert>
+#include <utility>
+
+/*
+* A PriorityQueue that gives each pushed item a Handle which stays valid until clear is called, so an item's priority can be changed
+* without searching for it and without the item having to know where it is in the queue.
+* Items are stored in push order and the heap only holds handles, so moving items around the heap never moves the items themselves.
+* Items stay readable through their handle after they are popped and can be pushed again.
+* Uses a heap where each node has arity children. A wider heap is shallower so pushing and increasing priority are cheaper.
+* Compare has the same meaning as in PriorityQueue, top() is an item for which Compare()(item, otherItem) is false for all other items.
+*/
+template<class T, class Compare = std::less<T>, std::size_t arity = 4u>
+class IndexedPriorityQueue
+{
+	static_assert(arity >= 2u, "IndexedPriorityQueue needs at least 2 children per node");
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using Handle = std::size_t;
+	using reference = T&;
+	using const_reference = const T&;
+private:
+	constexpr static size_type notQueued = std::numeric_limits<size_type>::max();
+
+	class CompareCleaner : private Compare
+	{
+	public:
+		using Compare::operator();
+	};
+
+	class Impl : public CompareCleaner
+	{
+	public:
+		ResizingArray<T> items;
+		ResizingArray<size_type> positions; //the position of each item in heap or notQueued
+		ResizingArray<Handle> heap;
+	};
+
+	Impl impl;
+
+	bool hasLowerPriority(Handle lhs, Handle rhs)
+	{
+		return impl(impl.items[lhs], impl.items[rhs]);
+	}
+
+	void place(size_type position, Handle handle)
+	{
+		impl.heap[position] = handle;
+		impl.positions[handle] = position;
+	}
+
+	void moveUp(size_type position)
+	{
+		const Handle handle = impl.heap[position];
+		while(position != (size_type)0u)
+		{
+			const size_type parent = (position - (size_type)1u) / arity;
+			if(!hasLowerPriority(impl.heap[parent], handle)) break;
+			place(position, impl.heap[parent]);
+			position = parent;
+		}
+		place(position, handle);
+	}
+
+	void moveDown(size_type position)
+	{
+		const Handle handle = impl.heap[position];
+		const size_type size = impl.heap.size();
+		while(true)
+		{
+			const size_type firstChild = position * arity + (size_type)1u;
+			if(firstChild >= size) break;
+			const size_type childEnd = size - firstChild > arity ? firstChild + arity : size;
+			size_type bestChild = firstChild;
+			for(size_type child = firstChild + (size_type)1u; child != childEnd; ++child)
+			{
+				if(hasLowerPriority(impl.heap[bestChild], impl.heap[child])) bestChild = child;
+			}
+			if(!hasLowerPriority(handle, impl.heap[bestChild])) break;
+			place(position, impl.heap[bestChild]);
+			position = bestChild;
+		}
+		place(position, handle);
+	}
+
+	void removeFromHeap(size_type position)
+	{
+		const Handle removed = impl.heap[position];
+		const Handle last = impl.heap[impl.heap.size() - (size_type)1u];
+		impl.heap.pop_back();
+		impl.positions[removed] = notQueued;
+		if(removed == last) return;
+		place(position, last);
+		if(position != (size_type)0u && hasLowerPriority(impl.heap[(position - (size_type)1u) / arity], last)) moveUp(position);
+		else moveDown(position);
+	}
+public:
+	bool empty() const noexcept
+	{
+		return impl.heap.size() == (size_type)0u;
+	}
+
+	/*
+	The number of items in the queue, not counting popped items.
+	*/
+	size_type size() const noexcept
+	{
+		return impl.heap.size();
+	}
+
+	reference top()
+	{
+		return impl.items[impl.heap[(size_type)0u]];
+	}
+
+	Handle topHandle() const
+	{
+		return impl.heap[(size_type)0u];
+	}
+
+	reference operator[](Handle handle)
+	{
+		return impl.items[handle];
+	}
+
+	const_reference operator[](Handle handle) const
+	{
+		return impl.items[handle];
+	}
+
+	bool isQueued(Handle handle) const
+	{
+		return impl.positions[handle] != notQueued;
+	}
+
+	Handle push(const T& value)
+	{
+		const Handle handle = impl.items.size();
+		impl.items.push_back(value);
+		impl.positions.push_back(notQueued);
+		push(handle);
+		return handle;
+	}
+
+	Handle push(T&& value)
+	{
+		const Handle handle = impl.items.size();
+		impl.items.push_back(std::move(value));
+		impl.positions.push_back(notQueued);
+		push(handle);
+		return handle;
+	}
+
+	/*
+	Adds a popped item back to the queue.
+	*/
+	void push(Handle handle)
+	{
+		assert(!isQueued(handle));
+		const size_type position = impl.heap.size();
+		impl.heap.push_back(handle);
+		impl.positions[handle] = position;
+		moveUp(position);
+	}
+
+	/*
+	Removes the top item from the queue. It can still be accessed with the returned handle.
+	*/
+	Handle pop()
+	{
+		assert(!empty());
+		const Handle handle = impl.heap[(size_type)0u];
+		removeFromHeap((size_type)0u);
+		return handle;
+	}
+
+	void erase(Handle handle)
+	{
+		assert(isQueued(handle));
+		removeFromHeap(impl.positions[handle]);
+	}
+
+	/*
+	Must be called after changing a queued item so that it should be closer to the top, for example decreasing its key in a min queue.
+	*/
+	void priorityIncreased(Handle handle)
+	{
+		assert(isQueued(handle));
+		moveUp(impl.positions[handle]);
+	}
+
+	void priorityDecreased(Handle handle)
+	{
+		assert(isQueued(handle));
+		moveDown(impl.positions[handle]);
+	}
+
+	/*
+	Removes all items including popped ones. All handles become invalid.
+	*/
+	void clear()
+	{
+		impl.items.clear();
+		impl.positions.clear();
+		impl.heap.clear();
+	}
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+template<class T, std::size_t captureSize = 3u * sizeof(void*)>
+class InlineDelegate;
+
+/*
+A Delegate that can also carry up to captureSize bytes by value so that a short lived task doesn't need a long lived object to point at.
+Made with a context pointer it works like Delegate and the function gets the context.
+Made with captures or a lambda, the function gets a pointer to the copy of the captures stored in the delegate which is only valid during the call.
+Captures must be trivially copyable so the delegate can be copied with memcpy by the task queues.
+*/
+template<class R, class... Args, std::size_t captureSize>
+class InlineDelegate<R(Args...), captureSize>
+{
+	static_assert(captureSize >= sizeof(void*), "InlineDelegate needs room for a context pointer");
+
+	R (*function)(void* context, Args... args);
+	alignas(void*) unsigned char captures[captureSize]; //holds the context pointer when hasInlineCaptures is false
+	bool hasInlineCaptures;
+
+	template<class C>
+	constexpr static bool canCapture = std::is_trivially_copyable_v<C> && sizeof(C) <= captureSize && alignof(C) <= alignof(void*);
+
+	void* context() const noexcept
+	{
+		void* result;
+		std::memcpy(&result, captures, sizeof(void*));
+		return result;
+	}
+
+	void setContext(void* context) noexcept
+	{
+		std::memset(captures, 0, captureSize);
+		std::memcpy(captures, &context, sizeof(void*));
+		hasInlineCaptures = false;
+	}
+
+	template<class C>
+	void setCaptures(const C& value) noexcept
+	{
+		std::memset(captures, 0, captureSize);
+		std::memcpy(captures, &value, sizeof(C));
+		hasInlineCaptures = true;
+	}
+public:
+	InlineDelegate() noexcept : function(nullptr), captures{}, hasInlineCaptures(false) {}
+
+	InlineDelegate(R (*function)(void* context, Args... args)) noexcept :
+		function(function)
+	{
+		setContext(nullptr);
+	}
+
+	InlineDelegate(void* context, R (*function)(void* context, Args... args)) noexcept :
+		function(function)
+	{
+		setContext(context);
+	}
+
+	/*
+	Stores a copy of f which is called with the arguments.
+	*/
+	template<class F, class = std::enable_if_t<canCapture<std::decay_t<F>> && std::is_invocable_r_v<R, const std::decay_t<F>&, Args...>
+		&& !std::is_convertible_v<F, R(*)(void*, Args...)>>>
+	InlineDelegate(const F& f) noexcept :
+		function([](void* captures, Args... args) -> R
+			{
+				const F& f = *std::launder(static_cast<const F*>(captures));
+				return f(std::forward<Args>(args)...);
+			})
+	{
+		setCaptures(f);
+	}
+
+	InlineDelegate(const InlineDelegate& other) noexcept = default;
+
+	InlineDelegate& operator=(const InlineDelegate& other) noexcept = default;
+
+	/*
+	Stores a copy of captureValues. function is called with a pointer to the copy.
+	*/
+	template<class C>
+	static InlineDelegate withCaptures(const C& captureValues, R (*function)(void* captures, Args... args)) noexcept
+	{
+		static_assert(canCapture<C>, "The captures must be trivially copyable and fit in captureSize bytes");
+		InlineDelegate delegate;
+		delegate.function = function;
+		delegate.setCaptures(captureValues);
+		return delegate;
+	}
+
+	bool operator==(const InlineDelegate& other) const noexcept
+	{
+		return function == other.function && hasInlineCaptures == other.hasInlineCaptures && std::memcmp(captures, other.captures, captureSize) == 0;
+	}
+
+	bool operator!=(const InlineDelegate& other) const noexcept
+	{
+		return !(*this == other);
+	}
+
+	class Hash
+	{
+	public:
+		std::size_t operator()(const InlineDelegate& delegate) const noexcept
+		{
+			std::size_t hash = std::hash<std::uintptr_t>()(reinterpret_cast<std::uintptr_t>(delegate.function));
+			for (std::size_t i = 0u; i < captureSize; i += sizeof(std::size_t))
+			{
+				std::size_t word = 0u;
+				std::memcpy(&word, delegate.captures + i, captureSize - i < sizeof(std::size_t) ? captureSize - i : sizeof(std::size_t));
+				hash = hash * 31u ^ std::hash<std::size_t>()(word);
+			}
+			return hash;
+		}
+	};
+
+	template<class C, R (C::*memberFunction)(Args... args)>
+	static InlineDelegate make(C* c) noexcept
+	{
+		return InlineDelegate(c, [](void* context, Args... args)
+		{
+			C* c = static_cast<C*>(context);
+			return (c->*memberFunction)(args...);
+		});
+	}
+
+	template<R (*freeFunction)(Args... args)>
+	static InlineDelegate make() noexcept
+	{
+		return InlineDelegate([](void* context, Args... args)
+		{
+			return freeFunction(args...);
+		});
+	}
+
+	template<class C, R (*freeFunction)(C* context, Args... args)>
+	static InlineDelegate make(C* c) noexcept
+	{
+		return InlineDelegate(c, [](void* context, Args... args)
+		{
+			C* c = static_cast<C*>(context);
+			return freeFunction(c, args...);
+		});
+	}
+
+	R operator()(const Args&... args) const
+	{
+		return function(hasInlineCaptures ? const_cast<unsigned char*>(captures) : context(), args...);
+	}
+};
@@ -97,13 +97,11 @@ void MeshManager::createMeshResources(ID3D12Resource*& vertices, ID3D12Resource*
 
 void MeshManager::unloadMesh(UnloadRequest& unloadRequest, void* tr)
 {
-	auto meshPtr = meshInfos.find({ unloadRequest.start, unloadRequest.end });
-	auto& meshInfo = meshPtr->second;
-	--meshInfo.numUsers;
-	if(meshInfo.numUsers == 0u)
+	meshInfos.visitAndMaybeErase({ unloadRequest.start, unloadRequest.end }, [](MeshInfo& meshInfo)
 	{
-		meshInfos.erase(meshPtr);
-	}
+		--meshInfo.numUsers;
+		return meshInfo.numUsers == 0u;
+	});
 
 	unloadRequest.deleteReadRequest(unloadRequest, tr);
 }
@@ -132,27 +130,16 @@ static void createIndices(void* indexUploadBuffer, ID3D12Resource* indices, ID3D
 	copyCommandList->CopyBufferRegion(indices, 0u, uploadResource, uploadResourceOffset, byteSize);
 }
 
-void MeshManager::meshWithPositionTextureNormalTangentBitangentUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
-	StreamingManager::ThreadLocal& streamingManager, void(*copyStarted)(void* requester, void* tr))
+void MeshManager::copyTangentBitangentVerticesAndCreateIndices(MeshStreamingRequest& uploadRequest, const unsigned char*, StreamingManager::ThreadLocal& streamingManager)
 {
-	constexpr auto vertexStrideInBytes = sizeof(MeshWithPositionTextureNormalTangentBitangent);
 	auto vertexSizeBytes = uploadRequest.verticesSize;
-	auto vertexSizeBytesInFile = vertexSizeBytes / vertexStrideInBytes * sizeof(MeshWithPositionTextureNormal);
 	auto indexSizeBytes = uploadRequest.indicesSize;
 
-	createMeshResources(uploadRequest.vertices, uploadRequest.indices, uploadRequest.meshBuffer, graphicsDevice, vertexSizeBytes, indexSizeBytes);
-
 	ID3D12GraphicsCommandList& copyCommandList = streamingManager.copyCommandList();
-	MeshWithPositionTextureNormalTangentBitangent* vertexUploadBuffer = reinterpret_cast<MeshWithPositionTextureNormalTangentBitangent* const>(uploadRequest.uploadBufferCurrentCpuAddress);
-
-	CalculateTangentBitangent(buffer, buffer + vertexSizeBytesInFile, vertexUploadBuffer);
-
 	copyCommandList.CopyBufferRegion(uploadRequest.vertices, 0u, uploadRequest.uploadResource, uploadRequest.uploadResourceOffset, vertexSizeBytes);
 
 	createIndices(uploadRequest.uploadBufferCurrentCpuAddress + vertexSizeBytes, uploadRequest.indices, uploadRequest.uploadResource,
 		uploadRequest.uploadResourceOffset + vertexSizeBytes, indexSizeBytes, &copyCommandList);
-
-	streamingManager.addCopyCompletionEvent(&uploadRequest, copyStarted);
 }
 
 void MeshManager::meshNoConvertUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
@@ -174,25 +161,18 @@ void MeshManager::meshNoConvertUseResourceHelper(MeshStreamingRequest& uploadReq
 	streamingManager.addCopyCompletionEvent(&uploadRequest, copyStarted);
 }
 
-void MeshManager::meshWithPositionTextureNormalTangentBitangentIndexUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
-	StreamingManager::ThreadLocal& streamingManager, void(*copyFinished)(void* requester, void* tr))
+void MeshManager::copyTangentBitangentVerticesAndIndices(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, StreamingManager::ThreadLocal& streamingManager)
 {
 	constexpr auto vertexStrideInBytes = sizeof(MeshWithPositionTextureNormalTangentBitangent);
 	auto vertexSizeBytes = uploadRequest.verticesSize;
 	auto vertexSizeBytesInFile = vertexSizeBytes / vertexStrideInBytes * sizeof(MeshWithPositionTextureNormal);
 	auto indexSizeBytes = uploadRequest.indicesSize;
 
-	createMeshResources(uploadRequest.vertices, uploadRequest.indices, uploadRequest.meshBuffer, graphicsDevice, vertexSizeBytes, indexSizeBytes);
-
 	ID3D12GraphicsCommandList& copyCommandList = streamingManager.copyCommandList();
-	MeshWithPositionTextureNormalTangentBitangent* vertexUploadBuffer = reinterpret_cast<MeshWithPositionTextureNormalTangentBitangent* const>(uploadRequest.uploadBufferCurrentCpuAddress);
-	CalculateTangentBitangent(buffer, buffer + vertexSizeBytesInFile, vertexUploadBuffer);
 	copyCommandList.CopyBufferRegion(uploadRequest.vertices, 0u, uploadRequest.uploadResource, uploadRequest.uploadResourceOffset, vertexSizeBytes);
 
 	std::memcpy(uploadRequest.uploadBufferCurrentCpuAddress + vertexSizeBytes, buffer + vertexSizeBytesInFile, indexSizeBytes);
 	copyCommandList.CopyBufferRegion(uploadRequest.indices, 0u, uploadRequest.uploadResource, uploadRequest.uploadResourceOffset + vertexSizeBytes, indexSizeBytes);
-
-	streamingManager.addCopyCompletionEvent(&uploadRequest, copyFinished);
 }
 
 void MeshManager::meshNoConvertIndexUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
@@ -216,10 +196,15 @@ void MeshManager::meshNoConvertIndexUseResourceHelper(MeshStreamingRequest& uplo
 
 void MeshManager::notifyMeshReady(MeshStreamingRequest* request, void* tr)
 {
-	MeshInfo& meshInfo = meshInfos[request->resourceLocation];
-	meshInfo.lastRequest = nullptr;
-	Mesh& mesh = meshInfo.mesh;
+	std::unique_ptr<Mesh> newMesh(new Mesh());
+	Mesh& mesh = *newMesh;
 	fillMesh(mesh, *request);
+	meshInfos.visit(request->resourceLocation, [&](MeshInfo& meshInfo)
+	{
+		meshInfo.lastRequest = nullptr;
+		meshInfo.mesh = std::move(newMesh);
+	});
+	//no more requests can be added after lastRequest is cleared
 	do
 	{
 		auto old = request;
@@ -1,11 +1,14 @@
 #pragma once
 #include "Mesh.h"
-#include <unordered_map>
+#include <memory>
 #include "StreamingManager.h"
 #include "File.h"
 #include "AsynchronousFileManager.h"
 #include "ActorQueue.h"
 #include "ResourceLocation.h"
+#include "ConcurrentHashMap.h"
+#include "ParallelFor.h"
+#include "PoolAllocated.h"
 
 class MeshManager
 {
@@ -107,7 +110,7 @@ private:
 	struct MeshInfo
 	{
 		MeshInfo() : numUsers(0u), lastRequest(nullptr) {}
-		Mesh mesh;
+		std::unique_ptr<Mesh> mesh; //separately allocated as users keep pointers to it while the map moves MeshInfos
 		MeshStreamingRequest* lastRequest;
 		unsigned int numUsers;
 	};
@@ -121,7 +124,10 @@ private:
 	};
 
 	ActorQueue messageQueue;
-	std::unordered_map<ResourceLocation, MeshInfo, Hash> meshInfos;
+	/*
+	Changed by the actor and by load and unload when the mesh is already loaded, so that those don't wait for the actor.
+	*/
+	ConcurrentHashMap<ResourceLocation, MeshInfo, Hash> meshInfos;
 	AsynchronousFileManager& asynchronousFileManager;
 	StreamingManager& streamingManager;
 	ID3D12Device& graphicsDevice;
@@ -166,8 +172,7 @@ private:
 		request->asynchronousFileManager->discard(*request);
 	}
 
-	template<class ThreadResources, void(*useResourceHelper)(MeshStreamingRequest&, const unsigned char*, ID3D12Device*,
-		StreamingManager::ThreadLocal&, void(*copyFinished)(void*, void*))>
+	template<class ThreadResources, void(*useResourceHelper)(MeshStreamingRequest&, const unsigned char*, ThreadResources&)>
 	static void useResource(StreamingManager::StreamingRequest* useSubresourceRequest, void* tr)
 	{
 		ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
@@ -182,19 +187,76 @@ private:
 			{
 				ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
 				auto& uploadRequest = static_cast<MeshStreamingRequest&>(request);
-				useResourceHelper(uploadRequest, buffer, &uploadRequest.meshManager->graphicsDevice, threadResources.streamingManager, copyFinished<ThreadResources>);
+				useResourceHelper(uploadRequest, buffer, threadResources);
 			};
 			uploadRequest.meshManager->asynchronousFileManager.read(uploadRequest);
 		}});
 	}
 
-	static void meshWithPositionTextureNormalTangentBitangentUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
-		StreamingManager::ThreadLocal& streamingManager, void(*copyFinished)(void* requester, void* tr));
+	template<class ThreadResources, void(*copyResourceHelper)(MeshStreamingRequest&, const unsigned char*, ID3D12Device*,
+		StreamingManager::ThreadLocal&, void(*copyFinished)(void*, void*))>
+	static void copyResource(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ThreadResources& threadResources)
+	{
+		copyResourceHelper(uploadRequest, buffer, &uploadRequest.meshManager->graphicsDevice, threadResources.streamingManager, copyFinished<ThreadResources>);
+	}
+
+	/*
+	Calculates the tangents and bitangents of a block of triangles per background task, then records the copies on the thread that finished last.
+	*/
+	template<class ThreadResources>
+	class TangentBitangentCalculation : public ParallelFor<ThreadResources>, public PoolAllocated
+	{
+		using Base = ParallelFor<ThreadResources>;
+		constexpr static std::size_t trianglesPerTask = 1024u;
+
+		MeshStreamingRequest& uploadRequest;
+		const unsigned char* buffer;
+		void(*copyResources)(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, StreamingManager::ThreadLocal& streamingManager);
+
+		static void calculate(Base& base, ThreadResources&, std::size_t begin, std::size_t end)
+		{
+			auto& calculation = static_cast<TangentBitangentCalculation&>(base);
+			constexpr std::size_t triangleSizeInFile = 3u * sizeof(MeshWithPositionTextureNormal);
+			auto vertexUploadBuffer = reinterpret_cast<MeshWithPositionTextureNormalTangentBitangent*>(calculation.uploadRequest.uploadBufferCurrentCpuAddress);
+			CalculateTangentBitangent(calculation.buffer + begin * triangleSizeInFile, calculation.buffer + end * triangleSizeInFile, vertexUploadBuffer + begin * 3u);
+		}
+
+		static void finished(Base& base, ThreadResources& threadResources)
+		{
+			auto& calculation = static_cast<TangentBitangentCalculation&>(base);
+			MeshStreamingRequest& request = calculation.uploadRequest;
+			const unsigned char* fileData = calculation.buffer;
+			auto copy = calculation.copyResources;
+			delete &calculation;
+
+			copy(request, fileData, threadResources.streamingManager);
+			threadResources.streamingManager.addCopyCompletionEvent(&request, copyFinished<ThreadResources>);
+		}
+	public:
+		TangentBitangentCalculation(MeshStreamingRequest& uploadRequest1, const unsigned char* buffer1,
+			void(*copyResources1)(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, StreamingManager::ThreadLocal& streamingManager)) :
+			Base(trianglesPerTask, calculate, finished),
+			uploadRequest(uploadRequest1),
+			buffer(buffer1),
+			copyResources(copyResources1)
+		{}
+	};
+
+	template<class ThreadResources, void(*copyResources)(MeshStreamingRequest&, const unsigned char*, StreamingManager::ThreadLocal&)>
+	static void calculateTangentBitangentAndCopyResource(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ThreadResources& threadResources)
+	{
+		createMeshResources(uploadRequest.vertices, uploadRequest.indices, uploadRequest.meshBuffer, &uploadRequest.meshManager->graphicsDevice,
+			uploadRequest.verticesSize, uploadRequest.indicesSize);
+		const std::size_t triangleCount = uploadRequest.verticesSize / (3u * sizeof(MeshWithPositionTextureNormalTangentBitangent));
+		auto calculation = new TangentBitangentCalculation<ThreadResources>(uploadRequest, buffer, copyResources);
+		calculation->startBackground(threadResources, 0u, triangleCount);
+	}
+
+	static void copyTangentBitangentVerticesAndCreateIndices(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, StreamingManager::ThreadLocal& streamingManager);
 	static void meshNoConvertUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
 		StreamingManager::ThreadLocal& streamingManager, void(*copyFinished)(void* requester, void* tr));
 
-	static void meshWithPositionTextureNormalTangentBitangentIndexUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
-		StreamingManager::ThreadLocal& streamingManager, void(*copyFinished)(void* requester, void* tr));
+	static void copyTangentBitangentVerticesAndIndices(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, StreamingManager::ThreadLocal& streamingManager);
 	static void meshNoConvertIndexUseResourceHelper(MeshStreamingRequest& uploadRequest, const unsigned char* buffer, ID3D12Device* graphicsDevice,
 		StreamingManager::ThreadLocal& streamingManager, void(*copyFinished)(void* requester, void* tr));
 	
@@ -209,11 +271,11 @@ private:
 		{
 			if (indexCount == 0u)
 			{
-				uploadRequest.streamResource = useResource<ThreadResources, meshNoConvertUseResourceHelper>;
+				uploadRequest.streamResource = useResource<ThreadResources, copyResource<ThreadResources, meshNoConvertUseResourceHelper>>;
 			}
 			else
 			{
-				uploadRequest.streamResource = useResource<ThreadResources, meshNoConvertIndexUseResourceHelper>;
+				uploadRequest.streamResource = useResource<ThreadResources, copyResource<ThreadResources, meshNoConvertIndexUseResourceHelper>>;
 			}
 		}
 		else
@@ -225,7 +287,7 @@ private:
 				{
 					if (compressedVertexType == VertexType::position3f_texCoords2f_normal3f)
 					{
-						uploadRequest.streamResource = useResource<ThreadResources, meshWithPositionTextureNormalTangentBitangentUseResourceHelper>;
+						uploadRequest.streamResource = useResource<ThreadResources, calculateTangentBitangentAndCopyResource<ThreadResources, copyTangentBitangentVerticesAndCreateIndices>>;
 					}
 					else
 					{
@@ -236,7 +298,7 @@ private:
 				{
 					if (compressedVertexType == VertexType::position3f_texCoords2f_normal3f)
 					{
-						uploadRequest.streamResource = useResource<ThreadResources, meshWithPositionTextureNormalTangentBitangentIndexUseResourceHelper>;
+						uploadRequest.streamResource = useResource<ThreadResources, calculateTangentBitangentAndCopyResource<ThreadResources, copyTangentBitangentVerticesAndIndices>>;
 					}
 					else
 					{
@@ -280,26 +342,37 @@ private:
 	template<class ThreadResources>
 	void loadMesh(MeshStreamingRequest* request, ThreadResources& tr)
 	{
-		MeshInfo& meshInfo = meshInfos[request->resourceLocation];
-		meshInfo.numUsers += 1u;
-		if(meshInfo.numUsers == 1u)
+		bool needsLoading = false;
+		Mesh* loadedMesh = nullptr;
+		meshInfos.visitOrInsert(request->resourceLocation, [&](MeshInfo& meshInfo)
 		{
+			meshInfo.numUsers += 1u;
+			if(meshInfo.numUsers == 1u)
+			{
+				meshInfo.lastRequest = request;
+				request->nextMeshRequest = nullptr;
+				needsLoading = true;
+				return;
+			}
+			//the resource is loaded or loading
+			if(meshInfo.lastRequest == nullptr)
+			{
+				//The resource is loaded
+				loadedMesh = meshInfo.mesh.get();
+				return;
+			}
+			meshInfo.lastRequest->nextMeshRequest = request;
 			meshInfo.lastRequest = request;
 			request->nextMeshRequest = nullptr;
-
+		});
+		if(needsLoading)
+		{
 			loadMeshUncached<ThreadResources>(*request);
-			return;
 		}
-		//the resource is loaded or loading
-		if(meshInfo.lastRequest == nullptr)
+		else if(loadedMesh != nullptr)
 		{
-			//The resource is loaded
-			request->meshLoaded(*request, &tr, meshInfo.mesh);
-			return;
+			request->meshLoaded(*request, &tr, *loadedMesh);
 		}
-		meshInfo.lastRequest->nextMeshRequest = request;
-		meshInfo.lastRequest = request;
-		request->nextMeshRequest = nullptr;
 	}
 
 	void unloadMesh(UnloadRequest& unloadRequest, void* tr);
@@ -333,9 +406,26 @@ public:
 	MeshManager(AsynchronousFileManager& asynchronousFileManager, StreamingManager& streamingManager, ID3D12Device& graphicsDevice);
 	~MeshManager() = default;
 
+	/*
+	If the mesh is already loaded request->meshLoaded is called before this returns.
+	*/
 	template<class ThreadResources>
 	void load(MeshStreamingRequest* request, ThreadResources& threadResources)
 	{
+		Mesh* loadedMesh = nullptr;
+		meshInfos.visit(request->resourceLocation, [&](MeshInfo& meshInfo)
+		{
+			if(meshInfo.lastRequest == nullptr)
+			{
+				meshInfo.numUsers += 1u;
+				loadedMesh = meshInfo.mesh.get();
+			}
+		});
+		if(loadedMesh != nullptr)
+		{
+			request->meshLoaded(*request, &threadResources, *loadedMesh);
+			return;
+		}
 		request->meshAction = Action::load;
 		addMessage(request, threadResources);
 	}
@@ -343,6 +433,21 @@ public:
 	template<class ThreadResources>
 	void unload(Message* request, ThreadResources& threadResources)
 	{
+		//only the last user needs the actor to free the mesh
+		bool isUnloaded = false;
+		meshInfos.visit({ request->start, request->end }, [&](MeshInfo& meshInfo)
+		{
+			if(meshInfo.numUsers > 1u)
+			{
+				meshInfo.numUsers -= 1u;
+				isUnloaded = true;
+			}
+		});
+		if(isUnloaded)
+		{
+			request->deleteReadRequest(*request, &threadResources);
+			return;
+		}
 		request->meshAction = Action::unload;
 		addMessage(request, threadResources);
 	}
@@ -3,8 +3,18 @@
 #include <d3d12.h>
 #include "File.h"
 #include "VirtualFeedbackSubPass.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 PageProvider::PageProvider(VirtualFeedbackSubPass& feedbackAnalizerSubPass1, StreamingManager& streamingManager, GraphicsEngine& graphicsEngine, AsynchronousFileManager& asynchronousFileManager) :
+	gatherFeadBackBuffer(nullptr),
+	gatherTexelCount(0u),
+	gatherPartCount(0u),
+	gatherPartsLeft(0u),
+	gatherPartsFinished(0u),
 	freePageLoadRequestsCount{maxPagesLoading},
 	feedbackAnalizerSubPass(feedbackAnalizerSubPass1),
 	streamingManager(streamingManager),
@@ -382,53 +392,179 @@ void PageProvider::processMessages(void* tr)
 	}
 }
 
+/*
+Adds count requests for a page and one request for each coarser mip of the page that wasn't already requested.
+The counts don't depend on the order pages are added in, so parts of the feedback buffer can be gathered separately and added here later.
+*/
 template<class HashMap>
-static inline void requestMipLevels(const unsigned int lowestPinnedMip, unsigned char textureId, unsigned char mipLevel, unsigned short x, unsigned short y, HashMap& uniqueRequests)
+static inline void requestMipLevels(const unsigned int lowestPinnedMip, unsigned char textureId, unsigned char mipLevel, unsigned short x, unsigned short y, unsigned long long count,
+	HashMap& uniqueRequests)
 {
-	if(mipLevel >= lowestPinnedMip) return;
-	x >>= mipLevel;
-	y >>= mipLevel;
 	while(true)
 	{
-		unsigned long long& count = uniqueRequests[{textureId, mipLevel, x, y}].count;
-		++count;
+		unsigned long long& totalCount = uniqueRequests[{textureId, mipLevel, x, y}].count;
+		const bool alreadyRequested = totalCount != 0u;
+		totalCount += count;
 		++mipLevel;
-		if(count != 1u || mipLevel == lowestPinnedMip) return;
+		if(alreadyRequested || mipLevel == lowestPinnedMip) return;
 		x >>= 1u;
 		y >>= 1u;
+		count = 1u;
 	}
 }
 
-void PageProvider::gatherPageRequests(void* feadBackBuffer, unsigned long sizeInBytes)
+/*
+Calls addRun(value, count) for each run of count identical neighbouring texels in [current, end).
+Large surfaces cover most of the screen so runs are long. Comparing texels with their neighbours 4 at a time with AVX2 or 2 at a time with SSE2
+means only the first texel of each run is decoded and looked up.
+*/
+template<class AddRun>
+static inline void forEachRun(const uint64_t* current, const uint64_t* end, AddRun&& addRun)
 {
-	auto& requests = this->uniqueRequests;
-	uint64_t* current = static_cast<uint64_t*>(feadBackBuffer);
-	const uint64_t* feadBackBufferEnd = current + (sizeInBytes / sizeof(uint64_t));
-	for(; current != feadBackBufferEnd; ++current)
-	{
-		const uint64_t value = *current;// pages are stored as textureId2, textureId3, textureId1, miplevel, y, x
-		const unsigned char mipLevel = static_cast<unsigned char>((value & 0x000000ff00000000) >> 32u);
-		const unsigned short x = static_cast<unsigned short>(value & 0x000000000000ffff);
-		const unsigned short y = static_cast<unsigned short>((value & 0x00000000ffff0000) >> 16u);
-		const unsigned char textureId1 = static_cast<unsigned char>((value & 0x0000ff0000000000) >> 40u);
-		const unsigned char textureId2 = static_cast<unsigned char>((value & 0xff00000000000000) >> 56u);
-		const unsigned char textureId3 = static_cast<unsigned char>((value & 0x00ff000000000000) >> 48u);
-
-		if(textureId1 != 255u)
+	if(current == end) return;
+	uint64_t runValue = *current;
+	unsigned long long runLength = 1u;
+	++current;
+#if defined(__AVX2__)
+	constexpr unsigned int laneCount = 4u;
+	constexpr unsigned int allEqual = 0xf;
+	for(; end - current >= static_cast<std::ptrdiff_t>(laneCount); current += laneCount)
+	{
+		const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+		const __m256i previousValues = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current - 1));
+		const unsigned int equal = static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(values, previousValues))));
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	constexpr unsigned int laneCount = 2u;
+	constexpr unsigned int allEqual = 0x3;
+	for(; end - current >= static_cast<std::ptrdiff_t>(laneCount); current += laneCount)
+	{
+		const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+		const __m128i previousValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current - 1));
+		//SSE2 has no 64 bit compare so a lane is equal when all 8 of its bytes are
+		const unsigned int equalBytes = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi32(values, previousValues)));
+		const unsigned int equal = ((equalBytes & 0xffu) == 0xffu ? 1u : 0u) | ((equalBytes >> 8u) == 0xffu ? 2u : 0u);
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		if(equal == allEqual)
 		{
-			VirtualTextureInfo& textureInfo = texturesByID[textureId1];
-			requestMipLevels(textureInfo.lowestPinnedMip, textureId1, mipLevel, x, y, requests);
+			runLength += laneCount;
+			continue;
 		}
-		if(textureId2 != 255u)
+		for(unsigned int i = 0u; i != laneCount; ++i)
 		{
-			VirtualTextureInfo& textureInfo = texturesByID[textureId2];
-			requestMipLevels(textureInfo.lowestPinnedMip, textureId2, mipLevel, x, y, requests);
+			if(equal & (1u << i))
+			{
+				++runLength;
+			}
+			else
+			{
+				addRun(runValue, runLength);
+				runValue = current[i];
+				runLength = 1u;
+			}
 		}
-		if(textureId3 != 255u)
+	}
+#endif
+	for(; current != end; ++current)
+	{
+		if(*current == runValue)
 		{
-			VirtualTextureInfo& textureInfo = texturesByID[textureId3];
-			requestMipLevels(textureInfo.lowestPinnedMip, textureId3, mipLevel, x, y, requests);
+			++runLength;
 		}
+		else
+		{
+			addRun(runValue, runLength);
+			runValue = *current;
+			runLength = 1u;
+		}
+	}
+	addRun(runValue, runLength);
+}
+
+unsigned int PageProvider::startGatheringPageRequests(const void* feadBackBuffer, unsigned long sizeInBytes, unsigned int maxPartCount)
+{
+	const unsigned long texelCount = sizeInBytes / sizeof(uint64_t);
+	unsigned long partCount = texelCount / minTexelsPerGatherPart;
+	if(partCount > maxPartCount) partCount = maxPartCount;
+	if(partCount == 0u) partCount = 1u;
+	while(partPageRequests.size() < partCount)
+	{
+		partPageRequests.emplace_back();
+	}
+
+	gatherFeadBackBuffer = static_cast<const uint64_t*>(feadBackBuffer);
+	gatherTexelCount = texelCount;
+	gatherPartCount = static_cast<unsigned int>(partCount);
+	gatherPartsFinished.store(0u, std::memory_order_relaxed);
+	gatherPartsLeft.store(static_cast<unsigned int>(partCount), std::memory_order_release);
+	return static_cast<unsigned int>(partCount);
+}
+
+bool PageProvider::gatherPageRequestParts()
+{
+	bool gatheredLastPart = false;
+	unsigned int partsLeft = gatherPartsLeft.load(std::memory_order_acquire);
+	while(true)
+	{
+		if(partsLeft == 0u) return gatheredLastPart;
+		if(!gatherPartsLeft.compare_exchange_weak(partsLeft, partsLeft - 1u, std::memory_order_acquire, std::memory_order_acquire)) continue;
+		const unsigned int part = partsLeft - 1u;
+
+		const uint64_t* begin = gatherFeadBackBuffer + static_cast<std::size_t>(static_cast<unsigned long long>(gatherTexelCount) * part / gatherPartCount);
+		const uint64_t* end = gatherFeadBackBuffer + static_cast<std::size_t>(static_cast<unsigned long long>(gatherTexelCount) * (part + 1u) / gatherPartCount);
+		PartPageRequests& requests = partPageRequests[part];
+		forEachRun(begin, end, [this, &requests](uint64_t value, unsigned long long count)
+		{
+			// pages are stored as textureId2, textureId3, textureId1, miplevel, y, x
+			const unsigned char mipLevel = static_cast<unsigned char>((value & 0x000000ff00000000) >> 32u);
+			const unsigned short x = static_cast<unsigned short>(value & 0x000000000000ffff);
+			const unsigned short y = static_cast<unsigned short>((value & 0x00000000ffff0000) >> 16u);
+			const unsigned char textureIds[3] =
+			{
+				static_cast<unsigned char>((value & 0x0000ff0000000000) >> 40u),
+				static_cast<unsigned char>((value & 0xff00000000000000) >> 56u),
+				static_cast<unsigned char>((value & 0x00ff000000000000) >> 48u)
+			};
+			for(const unsigned char textureId : textureIds)
+			{
+				if(textureId == 255u) continue;
+				const unsigned int lowestPinnedMip = texturesByID[textureId].lowestPinnedMip;
+				if(mipLevel >= lowestPinnedMip) continue;
+				const unsigned short pageX = static_cast<unsigned short>(x >> mipLevel);
+				const unsigned short pageY = static_cast<unsigned short>(y >> mipLevel);
+				if(gatherPartCount == 1u)
+				{
+					//nothing to merge with so skip the part's table
+					requestMipLevels(lowestPinnedMip, textureId, mipLevel, pageX, pageY, count, uniqueRequests);
+					continue;
+				}
+				const PageResourceLocation page{textureId, mipLevel, pageX, pageY};
+				auto request = requests.find(page);
+				if(request != requests.end())
+				{
+					request->count += count;
+				}
+				else
+				{
+					requests.insert({page, count});
+				}
+			}
+		});
+
+		gatheredLastPart = gatherPartsFinished.fetch_add(1u, std::memory_order_acq_rel) + 1u == gatherPartCount;
+		partsLeft = gatherPartsLeft.load(std::memory_order_acquire);
+	}
+}
+
+void PageProvider::finishGatheringPageRequests()
+{
+	for(unsigned int i = 0u; i != gatherPartCount; ++i)
+	{
+		partPageRequests[i].consume([this](PartPageRequest&& request)
+		{
+			const PageResourceLocation page = request.location;
+			requestMipLevels(texturesByID[page.textureId].lowestPinnedMip, page.textureId, page.mipLevel, page.x, page.y, request.count, uniqueRequests);
+		});
 	}
 }
 
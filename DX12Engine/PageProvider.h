@@ -17,6 +17,10 @@
 #include "PrimaryTaskFromOtherThreadQueue.h"
 #include "VirtualTextureInfoByID.h"
 #include "TaskShedular.h"
+#include "BackgroundPriority.h"
+#include "SwissHashSet.h"
+#include <atomic>
+#include <cstdint>
 class VirtualTextureManager;
 struct IDXGIAdapter3;
 class VirtualFeedbackSubPass;
@@ -56,6 +60,46 @@ class PageProvider : private PrimaryTaskFromOtherThreadQueue::Task
 	{
 		unsigned long long count = 0u;
 	};
+
+	/*
+	The number of times a page was seen in one part of the feedback buffer, not counting requests for it from finer mips.
+	*/
+	struct PartPageRequest
+	{
+		PageResourceLocation location;
+		unsigned long long count;
+	};
+
+	class PartPageRequestHash
+	{
+	public:
+		std::size_t operator()(const PartPageRequest& request) const
+		{
+			return PageResourceLocation::Hash{}(request.location);
+		}
+
+		std::size_t operator()(PageResourceLocation location) const
+		{
+			return PageResourceLocation::Hash{}(location);
+		}
+	};
+
+	class PartPageRequestEqual
+	{
+	public:
+		bool operator()(const PartPageRequest& lhs, const PartPageRequest& rhs) const
+		{
+			return lhs.location == rhs.location;
+		}
+
+		bool operator()(const PartPageRequest& lhs, PageResourceLocation rhs) const
+		{
+			return lhs.location == rhs;
+		}
+	};
+
+	using PartPageRequests = SwissHashSet<PartPageRequest, PartPageRequestHash, PartPageRequestEqual>;
+	constexpr static unsigned long minTexelsPerGatherPart = 16384u;
 public:
 	using UnloadRequest = VirtualTextureInfo::UnloadRequest;
 
@@ -79,6 +123,12 @@ private:
 	std::size_t newPageCacheCapacity;
 	VirtualTextureInfoByID texturesByID;
 	std::unordered_map<PageResourceLocation, PageRequestData, PageResourceLocation::Hash> uniqueRequests;
+	ResizingArray<PartPageRequests> partPageRequests; //one table per part of the feedback buffer so parts can be gathered in parallel
+	const uint64_t* gatherFeadBackBuffer;
+	unsigned long gatherTexelCount;
+	unsigned int gatherPartCount;
+	std::atomic<unsigned int> gatherPartsLeft;
+	std::atomic<unsigned int> gatherPartsFinished;
 	ResizingArray<std::pair<PageResourceLocation, unsigned long long>> posableLoadRequests;
 	PageLoadRequest pageLoadRequests[maxPagesLoading];
 	std::size_t freePageLoadRequestsCount;
@@ -137,7 +187,7 @@ private:
 			});
 			StreamingManager& streamingManager = pageRequest.pageProvider->streamingManager;
 			streamingManager.addUploadRequest(&pageRequest, threadResources);
-		} });
+		} }, BackgroundPriority::high);
 	}
 
 	template<class ThreadResources>
@@ -181,7 +231,20 @@ private:
 public:
 	PageProvider(VirtualFeedbackSubPass& feedbackAnalizerSubPass, StreamingManager& streamingManager, GraphicsEngine& graphicsEngine, AsynchronousFileManager& asynchronousFileManager);
 
-	void gatherPageRequests(void* feadBackBuffer, unsigned long sizeInBytes);
+	/*
+	Splits the feedback buffer into at most maxPartCount parts and returns the number of parts.
+	gatherPageRequestParts can then be called from up to that many threads at once. The buffer must stay mapped until the last part has been gathered.
+	*/
+	unsigned int startGatheringPageRequests(const void* feadBackBuffer, unsigned long sizeInBytes, unsigned int maxPartCount);
+	/*
+	Gathers parts of the feedback buffer until there are none left.
+	Returns true on the one call that gathered the last part, that caller must then call finishGatheringPageRequests.
+	*/
+	bool gatherPageRequestParts();
+	/*
+	Merges the parts into the page requests used by processPageRequests.
+	*/
+	void finishGatheringPageRequests();
 
 	template<class ThreadResources>
 	void processPageRequests(ThreadResources& threadResources, TaskShedular<ThreadResources>& taskShedular, float& mipBias, float desiredMipBias)
@@ -43,7 +43,7 @@ public:
 	public:
 		std::size_t operator()(PageResourceLocation page) const
 		{
-			return static_cast<std::size_t>(mortonEncode(page.x, page.y, unsigned long long{ page.mipLevel } | ((unsigned long long)page.textureId << 8u)));
+			return static_cast<std::size_t>(mortonEncode(page.x, page.y, static_cast<unsigned long long>(page.mipLevel) | (static_cast<unsigned long long>(page.textureId) << 8u)));
 		}
 	};
 
@@ -0,0 +1,138 @@
+#pragma once
+#include "InlineDelegate.h"
+#include "BackgroundPriority.h"
+#include <atomic>
+#include <cstddef>
+#include <cassert>
+
+/*
+Runs body over the index range [begin, end) on primary threads in the current phase, or in background tasks, then calls callback once on the thread that finished last.
+Uses lazy binary splitting: a task runs grainSize iterations at a time and only splits off half of what is left when its thread's queue is empty,
+meaning that other threads have nothing to steal from it. Big ranges therefore only get split as often as there are idle threads.
+Each task carries its range by value so splitting doesn't allocate. The ParallelFor must stay alive until callback is called. It can be started again from callback.
+*/
+template<class ThreadResources>
+class ParallelFor
+{
+	using Task = InlineDelegate<void(ThreadResources& threadResources)>;
+
+	class Range
+	{
+	public:
+		ParallelFor* parallelFor;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	std::size_t mGrainSize;
+	std::atomic<std::size_t> mRemainingIterations;
+	bool mIsBackground;
+	BackgroundPriority mPriority;
+
+	bool isQueueEmpty(ThreadResources& threadResources) const noexcept
+	{
+		return mIsBackground ? threadResources.taskShedular.backgroundQueueEmpty() : threadResources.taskShedular.currentPhaseTaskCount() == 0;
+	}
+
+	void push(ThreadResources& threadResources, Range range)
+	{
+		if (mIsBackground)
+		{
+			threadResources.taskShedular.pushBackgroundTask(Task::withCaptures(range, run), mPriority);
+		}
+		else
+		{
+			threadResources.taskShedular.pushCurrentPhaseTask(Task::withCaptures(range, run));
+		}
+	}
+
+	static void run(void* captures, ThreadResources& threadResources)
+	{
+		const Range range = *static_cast<const Range*>(captures);
+		ParallelFor& parallelFor = *range.parallelFor;
+		const std::size_t grainSize = parallelFor.mGrainSize;
+		std::size_t begin = range.begin;
+		std::size_t end = range.end;
+		std::size_t finishedIterations = 0u;
+		while (begin != end)
+		{
+			std::size_t size = end - begin;
+			if (size > grainSize && parallelFor.isQueueEmpty(threadResources))
+			{
+				const std::size_t middle = begin + size / 2u;
+				parallelFor.push(threadResources, Range{ &parallelFor, middle, end });
+				end = middle;
+				size = end - begin;
+			}
+			const std::size_t chunkEnd = begin + (size < grainSize ? size : grainSize);
+			parallelFor.body(parallelFor, threadResources, begin, chunkEnd);
+			finishedIterations += chunkEnd - begin;
+			begin = chunkEnd;
+		}
+		//The ParallelFor can be reused or destroyed by callback so it can't be touched by other tasks after this.
+		if (parallelFor.mRemainingIterations.fetch_sub(finishedIterations, std::memory_order_acq_rel) == finishedIterations)
+		{
+			parallelFor.callback(parallelFor, threadResources);
+		}
+	}
+public:
+	void(*body)(ParallelFor& parallelFor, ThreadResources& threadResources, std::size_t begin, std::size_t end);
+	void(*callback)(ParallelFor& parallelFor, ThreadResources& threadResources);
+
+	/*
+	grainSize is the number of iterations that are run between checks for idle threads.
+	*/
+	ParallelFor(std::size_t grainSize,
+		void(*body1)(ParallelFor& parallelFor, ThreadResources& threadResources, std::size_t begin, std::size_t end),
+		void(*callback1)(ParallelFor& parallelFor, ThreadResources& threadResources)) :
+		mGrainSize(grainSize),
+		mRemainingIterations(0u),
+		mIsBackground(false),
+		mPriority(BackgroundPriority::normal),
+		body(body1),
+		callback(callback1)
+	{
+		assert(grainSize != 0u);
+	}
+
+	ParallelFor(const ParallelFor&) = delete;
+	ParallelFor& operator=(const ParallelFor&) = delete;
+
+	/*
+	Must be called from a primary thread while it is running a primary task. Can't be called again until callback has been called.
+	*/
+	void start(ThreadResources& threadResources, std::size_t begin, std::size_t end)
+	{
+		assert(begin <= end);
+		if (begin == end)
+		{
+			callback(*this, threadResources);
+			return;
+		}
+		mIsBackground = false;
+		mRemainingIterations.store(end - begin, std::memory_order_relaxed);
+		push(threadResources, Range{ this, begin, end });
+	}
+
+	/*
+	Like start but runs body in background tasks with the given priority, so it can be called from any thread that can push background tasks.
+	*/
+	void startBackground(ThreadResources& threadResources, std::size_t begin, std::size_t end, BackgroundPriority priority = BackgroundPriority::normal)
+	{
+		assert(begin <= end);
+		if (begin == end)
+		{
+			callback(*this, threadResources);
+			return;
+		}
+		mIsBackground = true;
+		mPriority = priority;
+		mRemainingIterations.store(end - begin, std::memory_order_relaxed);
+		push(threadResources, Range{ this, begin, end });
+	}
+
+	std::size_t grainSize() const noexcept
+	{
+		return mGrainSize;
+	}
+};
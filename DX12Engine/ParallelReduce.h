@@ -0,0 +1,88 @@
+#pragma once
+#include "ParallelFor.h"
+#include <memory>
+#include <cstddef>
+#include <new>
+
+#pragma warning(push)
+#pragma warning(disable:4324) //warns about padding due to over alignment
+
+/*
+Reduces the index range [begin, end) on primary threads in the current phase.
+Each thread accumulates into its own value so combine is only called threadCount times at the end, in thread index order.
+combine must be associative and commutative as which thread runs which iterations changes from run to run.
+*/
+template<class ThreadResources, class T>
+class ParallelReduce : private ParallelFor<ThreadResources>
+{
+	using Base = ParallelFor<ThreadResources>;
+#if __cplusplus >= 201703L
+	static constexpr std::size_t hardwareDestructiveInterferenceSize
+		= std::hardware_destructive_interference_size;
+#else
+	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
+#endif
+
+	class alignas(hardwareDestructiveInterferenceSize) Accumulator
+	{
+	public:
+		T value;
+	};
+
+	std::unique_ptr<Accumulator[]> mAccumulators;
+	unsigned int mThreadCount;
+	T mIdentity;
+
+	static void runBody(Base& base, ThreadResources& threadResources, std::size_t begin, std::size_t end)
+	{
+		auto& parallelReduce = static_cast<ParallelReduce&>(base);
+		parallelReduce.body(parallelReduce, threadResources, begin, end, parallelReduce.mAccumulators[threadResources.taskShedular.index()].value);
+	}
+
+	static void finished(Base& base, ThreadResources& threadResources)
+	{
+		auto& parallelReduce = static_cast<ParallelReduce&>(base);
+		T result = std::move(parallelReduce.mAccumulators[0u].value);
+		for (unsigned int i = 1u; i != parallelReduce.mThreadCount; ++i)
+		{
+			result = parallelReduce.combine(result, parallelReduce.mAccumulators[i].value);
+		}
+		parallelReduce.callback(parallelReduce, threadResources, std::move(result));
+	}
+public:
+	/*
+	Adds the iterations [begin, end) to accumulator.
+	*/
+	void(*body)(ParallelReduce& parallelReduce, ThreadResources& threadResources, std::size_t begin, std::size_t end, T& accumulator);
+	T(*combine)(const T& lhs, const T& rhs);
+	void(*callback)(ParallelReduce& parallelReduce, ThreadResources& threadResources, T result);
+
+	ParallelReduce(unsigned int threadCount, std::size_t grainSize, T identity,
+		void(*body1)(ParallelReduce& parallelReduce, ThreadResources& threadResources, std::size_t begin, std::size_t end, T& accumulator),
+		T(*combine1)(const T& lhs, const T& rhs),
+		void(*callback1)(ParallelReduce& parallelReduce, ThreadResources& threadResources, T result)) :
+		Base(grainSize, runBody, finished),
+		mAccumulators(new Accumulator[threadCount]),
+		mThreadCount(threadCount),
+		mIdentity(std::move(identity)),
+		body(body1),
+		combine(combine1),
+		callback(callback1)
+	{}
+
+	/*
+	Must be called from a primary thread while it is running a primary task. Can't be called again until callback has been called.
+	*/
+	void start(ThreadResources& threadResources, std::size_t begin, std::size_t end)
+	{
+		for (unsigned int i = 0u; i != mThreadCount; ++i)
+		{
+			mAccumulators[i].value = mIdentity;
+		}
+		Base::start(threadResources, begin, end);
+	}
+
+	using Base::grainSize;
+};
+
+#pragma warning(pop)
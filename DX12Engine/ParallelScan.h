@@ -0,0 +1,121 @@
+#pragma once
+#include "ParallelFor.h"
+#include <memory>
+#include <cstddef>
+#include <cassert>
+
+/*
+Runs a prefix scan over the index range [begin, end) on primary threads in the current phase.
+The range is split into at most threadCount * blocksPerThread blocks of at least minBlockSize iterations.
+The first pass reduces every block in parallel, the block sums are then scanned on one thread and the second pass scans every block in parallel
+starting from the combination of all the blocks before it. combine must be associative.
+*/
+template<class ThreadResources, class T>
+class ParallelScan : private ParallelFor<ThreadResources>
+{
+	using Base = ParallelFor<ThreadResources>;
+
+	std::unique_ptr<T[]> mBlockSums;
+	std::size_t mMaxBlockCount;
+	std::size_t mMinBlockSize;
+	std::size_t mBlockCount;
+	std::size_t mBlockSize;
+	std::size_t mBegin;
+	std::size_t mEnd;
+	T mIdentity;
+	T mTotal;
+	bool mIsFinalPass;
+
+	static void runBody(Base& base, ThreadResources& threadResources, std::size_t firstBlock, std::size_t endBlock)
+	{
+		auto& parallelScan = static_cast<ParallelScan&>(base);
+		for (std::size_t block = firstBlock; block != endBlock; ++block)
+		{
+			const std::size_t begin = parallelScan.mBegin + block * parallelScan.mBlockSize;
+			const std::size_t end = parallelScan.mEnd - begin < parallelScan.mBlockSize ? parallelScan.mEnd : begin + parallelScan.mBlockSize;
+			if (parallelScan.mIsFinalPass)
+			{
+				parallelScan.scanBlock(parallelScan, threadResources, begin, end, parallelScan.mBlockSums[block]);
+			}
+			else
+			{
+				parallelScan.mBlockSums[block] = parallelScan.reduceBlock(parallelScan, threadResources, begin, end);
+			}
+		}
+	}
+
+	static void finished(Base& base, ThreadResources& threadResources)
+	{
+		auto& parallelScan = static_cast<ParallelScan&>(base);
+		if (parallelScan.mIsFinalPass)
+		{
+			parallelScan.callback(parallelScan, threadResources, parallelScan.mTotal);
+			return;
+		}
+		//turn the block sums into the prefix of each block
+		T sum = parallelScan.mIdentity;
+		for (std::size_t i = 0u; i != parallelScan.mBlockCount; ++i)
+		{
+			T blockSum = std::move(parallelScan.mBlockSums[i]);
+			parallelScan.mBlockSums[i] = sum;
+			sum = parallelScan.combine(sum, blockSum);
+		}
+		parallelScan.mTotal = std::move(sum);
+		parallelScan.mIsFinalPass = true;
+		parallelScan.Base::start(threadResources, 0u, parallelScan.mBlockCount);
+	}
+public:
+	constexpr static std::size_t defaultBlocksPerThread = 4u;
+
+	/*
+	Returns the combination of the iterations [begin, end).
+	*/
+	T(*reduceBlock)(ParallelScan& parallelScan, ThreadResources& threadResources, std::size_t begin, std::size_t end);
+	/*
+	Writes the results for the iterations [begin, end). prefix is the combination of all the iterations before begin.
+	*/
+	void(*scanBlock)(ParallelScan& parallelScan, ThreadResources& threadResources, std::size_t begin, std::size_t end, const T& prefix);
+	T(*combine)(const T& lhs, const T& rhs);
+	/*
+	total is the combination of all the iterations.
+	*/
+	void(*callback)(ParallelScan& parallelScan, ThreadResources& threadResources, const T& total);
+
+	ParallelScan(unsigned int threadCount, std::size_t minBlockSize, T identity,
+		T(*reduceBlock1)(ParallelScan& parallelScan, ThreadResources& threadResources, std::size_t begin, std::size_t end),
+		void(*scanBlock1)(ParallelScan& parallelScan, ThreadResources& threadResources, std::size_t begin, std::size_t end, const T& prefix),
+		T(*combine1)(const T& lhs, const T& rhs),
+		void(*callback1)(ParallelScan& parallelScan, ThreadResources& threadResources, const T& total),
+		std::size_t blocksPerThread = defaultBlocksPerThread) :
+		Base(1u, runBody, finished),
+		mBlockSums(new T[threadCount * blocksPerThread]),
+		mMaxBlockCount(threadCount * blocksPerThread),
+		mMinBlockSize(minBlockSize),
+		mIdentity(std::move(identity)),
+		reduceBlock(reduceBlock1),
+		scanBlock(scanBlock1),
+		combine(combine1),
+		callback(callback1)
+	{
+		assert(minBlockSize != 0u);
+		assert(mMaxBlockCount != 0u);
+	}
+
+	/*
+	Must be called from a primary thread while it is running a primary task. Can't be called again until callback has been called.
+	*/
+	void start(ThreadResources& threadResources, std::size_t begin, std::size_t end)
+	{
+		assert(begin <= end);
+		const std::size_t size = end - begin;
+		std::size_t blockSize = (size + mMaxBlockCount - 1u) / mMaxBlockCount;
+		if (blockSize < mMinBlockSize) blockSize = mMinBlockSize;
+		mBlockSize = blockSize;
+		mBlockCount = (size + blockSize - 1u) / blockSize;
+		mBegin = begin;
+		mEnd = end;
+		mTotal = mIdentity;
+		mIsFinalPass = false;
+		Base::start(threadResources, 0u, mBlockCount);
+	}
+};
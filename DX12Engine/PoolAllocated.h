@@ -0,0 +1,80 @@
+#pragma once
+#include "ThreadsafePoolAllocator.h"
+#include <cstddef>
+#include <new>
+
+/*
+Classes derived from PoolAllocated are allocated by new from MultiThreadedPoolAllocators with power of two block sizes from 64 to 1024 bytes,
+so request objects that are made on one thread and deleted on another don't go through the global heap.
+Bigger objects use the global operator new. delete must be called with the derived type or through a virtual destructor so the size is right.
+*/
+class PoolAllocated
+{
+	constexpr static std::size_t smallestBlockSize = 64u;
+	constexpr static std::size_t sizeClassCount = 5u;
+
+	template<std::size_t sizeClass>
+	using Allocator = MultiThreadedPoolAllocator<smallestBlockSize << sizeClass, alignof(std::max_align_t)>;
+
+	static std::size_t sizeClass(std::size_t size) noexcept
+	{
+		std::size_t sizeClass = 0u;
+		while(sizeClass != sizeClassCount && (smallestBlockSize << sizeClass) < size)
+		{
+			++sizeClass;
+		}
+		return sizeClass;
+	}
+public:
+	static void* operator new(std::size_t size)
+	{
+		switch(sizeClass(size))
+		{
+		case 0u:
+			return Allocator<0u>::allocate();
+		case 1u:
+			return Allocator<1u>::allocate();
+		case 2u:
+			return Allocator<2u>::allocate();
+		case 3u:
+			return Allocator<3u>::allocate();
+		case 4u:
+			return Allocator<4u>::allocate();
+		default:
+			return ::operator new(size);
+		}
+	}
+
+	static void operator delete(void* ptr, std::size_t size) noexcept
+	{
+		if(ptr == nullptr) return;
+		switch(sizeClass(size))
+		{
+		case 0u:
+			Allocator<0u>::deallocate(ptr);
+			break;
+		case 1u:
+			Allocator<1u>::deallocate(ptr);
+			break;
+		case 2u:
+			Allocator<2u>::deallocate(ptr);
+			break;
+		case 3u:
+			Allocator<3u>::deallocate(ptr);
+			break;
+		case 4u:
+			Allocator<4u>::deallocate(ptr);
+			break;
+		default:
+			::operator delete(ptr);
+		}
+	}
+
+	//The class operator new hides the global placement new so it is provided here
+	static void* operator new(std::size_t, void* ptr) noexcept
+	{
+		return ptr;
+	}
+
+	static void operator delete(void*, void*) noexcept {}
+};
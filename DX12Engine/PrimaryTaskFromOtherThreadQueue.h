@@ -4,6 +4,7 @@
 #include "LinkedTask.h"
 #include <cstddef>
 #include <cassert>
+#include <atomic>
 
 class PrimaryTaskFromOtherThreadQueue
 {
@@ -13,14 +14,14 @@ public:
 	class StopRequest
 	{
 		friend class PrimaryTaskFromOtherThreadQueue;
-		StopRequest** stopRequest;
+		std::atomic<StopRequest*>* stopRequest;
 		void(*callback)(StopRequest& stopRequest, void* tr);
 	public:
 		StopRequest(void(*callback1)(StopRequest& stopRequest, void* tr)) : callback(callback1) {}
 	};
 private:
 	UnorderedMultiProducerSingleConsumerQueue taskQueue;
-	StopRequest* mStopRequest;
+	std::atomic<StopRequest*> mStopRequest;
 	const std::size_t queueIndex;
 
 	template<class ThreadResources>
@@ -29,10 +30,11 @@ private:
 		threadResources.taskShedular.pushPrimaryTask(queueIndex, {this, [](void* requester, ThreadResources& threadResources)
 		{
 			PrimaryTaskFromOtherThreadQueue& queue = *static_cast<PrimaryTaskFromOtherThreadQueue*>(requester);
-			if(queue.mStopRequest != nullptr)
+			StopRequest* stopRequest = queue.mStopRequest.load(std::memory_order_acquire);
+			if(stopRequest != nullptr)
 			{
-				queue.mStopRequest->callback(*queue.mStopRequest, &threadResources);
-				queue.mStopRequest = nullptr;
+				queue.mStopRequest.store(nullptr, std::memory_order_relaxed);
+				stopRequest->callback(*stopRequest, &threadResources);
 				return;
 			}
 			SinglyLinked* tasks = queue.taskQueue.popAll();
@@ -69,7 +71,7 @@ public:
 	template<class ThreadResources>
 	void start(ThreadResources& threadResources)
 	{
-		assert(mStopRequest == nullptr && "Cannot start while not stopped");
+		assert(mStopRequest.load(std::memory_order_relaxed) == nullptr && "Cannot start while not stopped");
 		run(threadResources);
 	}
 
@@ -80,10 +82,12 @@ public:
 	void stop(StopRequest& stopRequest, ThreadResources& threadResources)
 	{
 		stopRequest.stopRequest = &mStopRequest;
-		threadResources.taskShedular.pushPrimaryTask(queueIndex == 0u ? 1u : 0u, {&stopRequest, [](void* requester, ThreadResources&)
+		//The stop request is set from another phase when there is one, otherwise it is seen by the run task in the next frame.
+		const std::size_t primaryQueueCount = threadResources.taskShedular.primaryQueueCount();
+		threadResources.taskShedular.pushPrimaryTask(queueIndex + 1u == primaryQueueCount ? 0u : queueIndex + 1u, {&stopRequest, [](void* requester, ThreadResources&)
 		{
 			StopRequest& stopRequest = *static_cast<StopRequest*>(requester);
-			*stopRequest.stopRequest = &stopRequest;
+			stopRequest.stopRequest->store(&stopRequest, std::memory_order_release);
 		}});
 	}
 };
\ No newline at end of file
@@ -36,51 +36,55 @@ public:
 	using iterator = typename Container::iterator;
 	using const_iterator = typename Container::const_iterator;
 private:
+	/*
+	The moved item is held outside the heap while the items it passes are moved into the gap it leaves,
+	which takes one move per level instead of the three a swap takes.
+	*/
 	void moveUp(size_type index)
 	{
-		using std::swap;
-		const size_type parentIndex = (index - (size_type)1u) / (size_type)2u;
-		if(index != (size_type)0u)
+		if(index == (size_type)0u) return;
+		size_type parentIndex = (index - (size_type)1u) / (size_type)2u;
+		if(!impl(impl.data[parentIndex], impl.data[index])) return;
+
+		value_type value = std::move(impl.data[index]);
+		do
 		{
-			if(impl(impl.data[parentIndex], impl.data[index]))
-			{
-				swap(impl.data[parentIndex], impl.data[index]);
-				moveUp(parentIndex);
-			}
-		}
+			impl.data[index] = std::move(impl.data[parentIndex]);
+			index = parentIndex;
+			if(index == (size_type)0u) break;
+			parentIndex = (index - (size_type)1u) / (size_type)2u;
+		} while(impl(impl.data[parentIndex], value));
+		impl.data[index] = std::move(value);
+	}
+
+	/*
+	Returns the child that should be closer to the top.
+	*/
+	size_type higherPriorityChild(size_type child1, size_type size)
+	{
+		const size_type child2 = child1 + (size_type)1u;
+		if(child2 < size && !impl(impl.data[child2], impl.data[child1])) return child2;
+		return child1;
 	}
 
 	void moveDown(size_type index = (size_type)0u)
 	{
-		using std::swap;
-		const size_type child1 = (size_type)2u * index + (size_type)1u;
-		const size_type child2 = (size_type)2u * index + (size_type)2u;
-		if(child1 < impl.data.size())
+		const size_type size = impl.data.size();
+		size_type child = (size_type)2u * index + (size_type)1u;
+		if(child >= size) return;
+		child = higherPriorityChild(child, size);
+		if(!impl(impl.data[index], impl.data[child])) return;
+
+		value_type value = std::move(impl.data[index]);
+		do
 		{
-			if(child2 < impl.data.size())
-			{
-				if(impl(impl.data[index], impl.data[child1]) || impl(impl.data[index], impl.data[child2]))
-				{
-					if(impl(impl.data[child2], impl.data[child1]))
-					{
-						swap(impl.data[child1], impl.data[index]);
-						moveDown(child1);
-					}
-					else
-					{
-						swap(impl.data[child2], impl.data[index]);
-						moveDown(child2);
-					}
-				}
-			}
-			else
-			{
-				if(impl(impl.data[index], impl.data[child1]))
-				{
-					swap(impl.data[child1], impl.data[index]);
-				}
-			}
-		}
+			impl.data[index] = std::move(impl.data[child]);
+			index = child;
+			child = (size_type)2u * index + (size_type)1u;
+			if(child >= size) break;
+			child = higherPriorityChild(child, size);
+		} while(impl(value, impl.data[child]));
+		impl.data[index] = std::move(value);
 	}
 public:
 	PriorityQueue& operator=(const PriorityQueue& other)
@@ -165,7 +169,7 @@ public:
 		{
 			impl.data.pop_back();
 		}
-		return std::move(ret);
+		return ret;
 	}
 
 	void swap(PriorityQueue& other)
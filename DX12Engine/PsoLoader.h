@@ -2,7 +2,7 @@
 #include "AsynchronousFileManager.h"
 #include "GraphicsPipelineStateDesc.h"
 #include "D3D12PipelineState.h"
-#include <atomic>
+#include "TaskCounter.h"
 
 class PsoLoader
 {
@@ -25,11 +25,11 @@ public:
 		D3D12PipelineState pso;
 
 		constexpr static unsigned int numberOfComponents = 2u;
-		std::atomic<unsigned int> numberOfComponentsFinished = 0u;
+		TaskCounter componentsFinished;
 
 		void deleteComponent(void* tr)
 		{
-			if (numberOfComponentsFinished.fetch_add(1u, std::memory_order_acq_rel) == (numberOfComponents - 1u))
+			if (componentsFinished.finished(numberOfComponents))
 			{
 				psoLoadedCallback(*this, std::move(pso), tr);
 			}
@@ -37,9 +37,8 @@ public:
 
 		void componentLoaded(AsynchronousFileManager& asynchronousFileManager)
 		{
-			if (numberOfComponentsFinished.fetch_add(1u, std::memory_order_acq_rel) == (numberOfComponents - 1u))
+			if (componentsFinished.finished(numberOfComponents))
 			{
-				numberOfComponentsFinished.store(0u, std::memory_order_relaxed);
 				pso = D3D12PipelineState(&device, graphicsPipelineStateDesc);
 				auto& vertexShaderRequest = *static_cast<VertexShaderRequest*>(this);
 				auto& pixelShaderRequest = *static_cast<PixelShaderRequest*>(this);
@@ -32,24 +32,24 @@ class Range
 			return &f(**static_cast<It1*>(this));
 		}
 
-		bool operator!=(const It2& other)
+		bool operator!=(const It2& other) const
 		{
-			return *((It1*)this) != other;
+			return *((const It1*)this) != other;
 		}
 
-		bool operator!=(const Mapped<It1, It2, NewType, f>& other)
+		bool operator!=(const Mapped<It1, It2, NewType, f>& other) const
 		{
-			return *((It1*)this) != (It1&)other;
+			return *((const It1*)this) != (const It1&)other;
 		}
 
-		bool operator==(const It2& other)
+		bool operator==(const It2& other) const
 		{
-			return *((It1*)this) == other;
+			return *((const It1*)this) == other;
 		}
 
-		bool operator==(const Mapped<It1, It2, NewType, f>& other)
+		bool operator==(const Mapped<It1, It2, NewType, f>& other) const
 		{
-			return *((It1*)this) == (It1&)other;
+			return *((const It1*)this) == (const It1&)other;
 		}
 	};
 
@@ -9,7 +9,7 @@
 #include "makeArray.h"
 #include "Range.h"
 #include "ResizingArray.h"
-#include "FastIterationHashSet.h"
+#include "EntityMap.h"
 #include "ReflectionCamera.h"
 #include "GraphicsEngine.h"
 #include "LinkedTask.h"
@@ -32,7 +32,7 @@ template<class Camera_t, std::size_t initialSize>
 struct CameraStoragePicker<Camera_t, false, initialSize>
 {
 private:
-	using Container = FastIterationHashMap<unsigned long, Camera_t, std::hash<unsigned long>, std::equal_to<unsigned long>, std::allocator<unsigned long>, unsigned long>;
+	using Container = EntityMap<Camera_t>;
 public:
 	using iterator = typename Container::iterator;
 	using const_iterator = typename Container::const_iterator;
@@ -490,12 +490,12 @@ class RenderSubPassGroup
 			return &*current;
 		}
 
-		bool operator==(const SubPassIterator& other) noexcept
+		bool operator==(const SubPassIterator& other) const noexcept
 		{
 			return iterator == other;
 		}
 
-		bool operator!=(const SubPassIterator& other) noexcept
+		bool operator!=(const SubPassIterator& other) const noexcept
 		{
 			return iterator != other;
 		}
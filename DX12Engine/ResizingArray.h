@@ -1,6 +1,8 @@
 #pragma once
 #include <cstddef>
 #include <memory>
+#include <type_traits>
+#include "TriviallyRelocatable.h"
 #undef min
 #undef max
 
@@ -30,9 +32,9 @@ public:
 		}
 	};
 private:
-	Element* mCapacityEnd;
 	Element* buffer;
 	Element* mEnd;
+	Element* mCapacityEnd;
 	
 	void resizeNoChecks()
 	{
@@ -53,16 +55,10 @@ private:
 	{
 		Element*const temp = this->allocate(newSize);
 		size_type size = mEnd - buffer;
-		if (size != 0u)
+		if (buffer != nullptr)
 		{
-			size_t i = size;
-			do
-			{
-				--i;
-				new(&temp[i]) Element(std::move(buffer[i]));
-				buffer[i].~Element();
-			} while (i != 0u);
-			this->deallocate(buffer, size);
+			relocate(buffer, size, temp);
+			this->deallocate(buffer, mCapacityEnd - buffer);
 		}
 		buffer = temp;
 		mEnd = buffer + size;
@@ -84,6 +80,8 @@ private:
 public:
 	ResizingArray() noexcept : buffer(nullptr), mEnd(nullptr), mCapacityEnd(nullptr) {}
 
+	explicit ResizingArray(const Allocator& allocator) noexcept : Allocator(allocator), buffer(nullptr), mEnd(nullptr), mCapacityEnd(nullptr) {}
+
 	ResizingArray(ResizingArray&& other) : Allocator(static_cast<Allocator&&>(other)), buffer(other.buffer), mEnd(other.mEnd), mCapacityEnd(other.mCapacityEnd)
 	{
 		other.buffer = nullptr;
@@ -96,7 +94,14 @@ public:
 		mCapacityEnd = buffer + capacity.size;
 	}
 
-	template<typename Functor, typename Return = typename std::result_of_t<Functor(std::size_t)> >
+	ResizingArray(const Size capacity, const Allocator& allocator) : Allocator(allocator)
+	{
+		buffer = this->allocate(capacity.size);
+		mEnd = buffer;
+		mCapacityEnd = buffer + capacity.size;
+	}
+
+	template<typename Functor, typename Return = std::invoke_result_t<Functor, std::size_t> >
 	ResizingArray(const Size capacity, Functor& initializer, typename std::enable_if<true, Return>::type* = nullptr)
 	{
 		buffer = this->allocate(capacity.size);
@@ -122,7 +127,7 @@ public:
 		}
 	}
 
-	template<typename Functor, typename Return = typename std::result_of_t<Functor(std::size_t, Element&)> >
+	template<typename Functor, typename Return = std::invoke_result_t<Functor, std::size_t, Element&> >
 	ResizingArray(const Size capacity, Functor& initializer)
 	{
 		buffer = this->allocate(capacity.size);
@@ -148,7 +153,7 @@ public:
 		}
 	}
 
-	template<typename Functor, typename Return = typename std::result_of_t<Functor(std::size_t)> >
+	template<typename Functor, typename Return = std::invoke_result_t<Functor, std::size_t> >
 	ResizingArray(const Size size, const Size capacity, Functor& initializer, typename std::enable_if<true, Return>::type* = nullptr)
 	{
 		buffer = this->allocate(capacity.size);
@@ -174,7 +179,7 @@ public:
 		}
 	}
 
-	template<typename Functor, typename Return = typename std::result_of_t<Functor(std::size_t, Element&)> >
+	template<typename Functor, typename Return = std::invoke_result_t<Functor, std::size_t, Element&> >
 	ResizingArray(const Size size, const Size capacity, Functor& initializer)
 	{
 		buffer = this->allocate(capacity.size);
@@ -341,10 +346,6 @@ public:
 			mCapacityEnd = buffer + count;
 		}
 		mEnd = buffer + count;
-		for (auto& value2 : *this)
-		{
-			new(&value2) Element(value);
-		}
 		for (auto current = buffer; first != last; ++first, ++current)
 		{
 			new(current) Element(*first);
@@ -358,7 +359,7 @@ public:
 
 	void reserve(std::size_t new_cap)
 	{
-		if (new_cap <= mCapacity) return;
+		if (new_cap <= capacity()) return;
 		resizeToKnownSizeNoChechs(new_cap);
 	}
 
@@ -1,14 +1,31 @@
 #pragma once
 #include <cstddef>
 #include <atomic>
+#include <new>
+#include <type_traits>
 
+#pragma warning(push)
+#pragma warning(disable:4324) //warns about padding due to over alignment
+
+/*
+Consumers read an item before they know if they have claimed it so T must be trivially copyable.
+The producer must not get more than capacity items ahead of the consumers.
+*/
 template<class T>
 class SingleProducerMultiConsumerQueue
 {
+	static_assert(std::is_trivially_copyable_v<T>, "SingleProducerMultiConsumerQueue can only store trivially copyable types");
+#if __cplusplus >= 201703L
+	static constexpr std::size_t hardwareDestructiveInterferenceSize
+		= std::hardware_destructive_interference_size;
+#else
+	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
+#endif
+
 	T* mData;
-	std::atomic<std::size_t> mEnd;
-	std::size_t mFront;
 	std::size_t mCapacity;
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<std::size_t> mEnd;
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<std::size_t> mFront;
 public:
 	//size must be a power of two
 	SingleProducerMultiConsumerQueue(std::size_t capacity)
@@ -18,6 +35,9 @@ public:
 		mCapacity = capacity;
 		mData = new T[capacity];
 	}
+
+	SingleProducerMultiConsumerQueue(const SingleProducerMultiConsumerQueue&) = delete;
+	SingleProducerMultiConsumerQueue& operator=(const SingleProducerMultiConsumerQueue&) = delete;
 	
 	~SingleProducerMultiConsumerQueue()
 	{
@@ -33,13 +53,15 @@ public:
 	
 	bool pop(T& item)
 	{
-		std::size_t oldEnd;
 		std::size_t oldFront = mFront.load(std::memory_order_relaxed);
-		do
+		while (true)
 		{
-			oldEnd = mEnd.load(std::memory_order_acquire);
+			const std::size_t oldEnd = mEnd.load(std::memory_order_acquire);
 			if(oldFront == oldEnd) return false;//the queue was probably empty
-		} while(!mFront.compare_exchange_weak(oldFront, oldFront + 1u, std::memory_order_relaxed));
-		item = ((const T*)mData)[oldFront & (mCapacity - 1u)];
+			item = mData[oldFront & (mCapacity - 1u)];
+			if (mFront.compare_exchange_weak(oldFront, oldFront + 1u, std::memory_order_relaxed)) return true;
+		}
 	}
-};
\ No newline at end of file
+};
+
+#pragma warning(pop)
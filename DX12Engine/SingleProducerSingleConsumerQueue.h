@@ -1,38 +1,109 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
+#include <new>
 
+#pragma warning(push)
+#pragma warning(disable:4324) //warns about padding due to over alignment
+
+/*
+The front is only written by the consumer and the back only by the producer so they are kept on different cache lines.
+Each side keeps the last value it read of the other side's index and only reloads it when the queue looks full or empty,
+so the cache line holding the other index is only moved between cores when it is needed.
+*/
 template<class T, size_t mCapacity>
 class SingleProducerSingleConsumerQueue
 {
-	T* mFront;
-	T mData[mCapacity];
-	std::atomic<T*> mBack;
+#if __cplusplus >= 201703L
+	static constexpr std::size_t hardwareDestructiveInterferenceSize
+		= std::hardware_destructive_interference_size;
+#else
+	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
+#endif
+
+	//only written by the consumer
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<T*> mFront;
+	T* mBackSeenByConsumer;
+	//only written by the producer
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<T*> mBack;
+	T* mFrontSeenByProducer;
+	alignas(hardwareDestructiveInterferenceSize) T mData[mCapacity];
+
+	T* next(T* position) noexcept
+	{
+		++position;
+		if (position == mData + mCapacity) { position = mData; }
+		return position;
+	}
+
+	bool isEmpty(T* front) noexcept
+	{
+		if (front != mBackSeenByConsumer) return false;
+		mBackSeenByConsumer = mBack.load(std::memory_order_acquire);
+		return front == mBackSeenByConsumer;
+	}
 public:
 	SingleProducerSingleConsumerQueue()
 	{
 		mFront = mData;
+		mBackSeenByConsumer = mData;
 		mBack = mData;
+		mFrontSeenByProducer = mData;
 	}
 
+	/*
+	Must not be called when the queue is full.
+	*/
 	void push(T item)
 	{
-		T* oldBack = mBack.load(std::memory_order::memory_order_relaxed);
+		T* oldBack = mBack.load(std::memory_order_relaxed);
 		*oldBack = std::move(item);
-		T* newBack = oldBack + 1u;
-		if (newBack == mData + mCapacity) { newBack = mData; }
-		mBack.store(newBack, std::memory_order::memory_order_release);
+		mBack.store(next(oldBack), std::memory_order_release);
 	}
 
-	bool pop(T& item)
+	/*
+	Returns false if the queue is full. Can hold one less than mCapacity items.
+	*/
+	bool tryPush(T item)
 	{
-		T* oldBack = mBack.load(std::memory_order::memory_order_acquire);
-		if (mFront != oldBack)
+		T* oldBack = mBack.load(std::memory_order_relaxed);
+		T* newBack = next(oldBack);
+		if (newBack == mFrontSeenByProducer)
 		{
-			item = std::move(*mFront);
-			++mFront;
-			if (mFront == mData + mCapacity) { mFront = mData; }
-			return true;
+			mFrontSeenByProducer = mFront.load(std::memory_order_acquire);
+			if (newBack == mFrontSeenByProducer) return false;
 		}
-		return false;
+		*oldBack = std::move(item);
+		mBack.store(newBack, std::memory_order_release);
+		return true;
 	}
-};
\ No newline at end of file
+
+	bool pop(T& item)
+	{
+		T* front = mFront.load(std::memory_order_relaxed);
+		if (isEmpty(front)) return false;
+		item = std::move(*front);
+		mFront.store(next(front), std::memory_order_release);
+		return true;
+	}
+
+	/*
+	Returns the item that pop would return without removing it or nullptr if the queue is empty. Must be called by the consumer.
+	*/
+	T* front() noexcept
+	{
+		T* front = mFront.load(std::memory_order_relaxed);
+		if (isEmpty(front)) return nullptr;
+		return front;
+	}
+
+	/*
+	Removes the item returned by front. Must be called by the consumer.
+	*/
+	void popFront() noexcept
+	{
+		mFront.store(next(mFront.load(std::memory_order_relaxed)), std::memory_order_release);
+	}
+};
+
+#pragma warning(pop)
@@ -0,0 +1,59 @@
+#pragma once
+#include "EntityGenerator.h"
+#include "ResizingArray.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+/*
+The sparse half of a sparse set. Maps the index part of entity IDs to positions in a dense array without hashing.
+Pages of positions are only made for ranges of indices that are used.
+Entities with the same index but different generations share a position, so users must check the entity stored at the dense position.
+*/
+class SparseEntityIndex
+{
+public:
+	using size_type = std::uint32_t;
+	constexpr static size_type none = std::numeric_limits<size_type>::max();
+private:
+	constexpr static std::size_t pageSize = 1024u;
+
+	ResizingArray<std::unique_ptr<size_type[]>> mPages;
+public:
+	/*
+	Returns none if the index part of entity has no position.
+	*/
+	size_type find(unsigned long entity) const noexcept
+	{
+		const std::size_t index = EntityGenerator::indexOf(entity);
+		const std::size_t page = index / pageSize;
+		if(page >= mPages.size() || mPages[page] == nullptr) return none;
+		return mPages[page][index % pageSize];
+	}
+
+	void set(unsigned long entity, size_type position)
+	{
+		const std::size_t index = EntityGenerator::indexOf(entity);
+		const std::size_t page = index / pageSize;
+		while(mPages.size() <= page)
+		{
+			mPages.emplace_back();
+		}
+		if(mPages[page] == nullptr)
+		{
+			mPages[page].reset(new size_type[pageSize]);
+			for(std::size_t i = 0u; i != pageSize; ++i)
+			{
+				mPages[page][i] = none;
+			}
+		}
+		mPages[page][index % pageSize] = position;
+	}
+
+	void reset(unsigned long entity) noexcept
+	{
+		const std::size_t index = EntityGenerator::indexOf(entity);
+		mPages[index / pageSize][index % pageSize] = none;
+	}
+};
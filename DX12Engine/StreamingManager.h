@@ -10,6 +10,8 @@
 #include "GpuCompletionEventManager.h"
 #include "ActorQueue.h"
 #include "SinglyLinked.h"
+#include "BackgroundPriority.h"
+#include "PoolAllocated.h"
 
 class StreamingManager
 {
@@ -19,7 +21,7 @@ class StreamingManager
 		deallocate,
 	};
 public:
-	class StreamingRequest : public SinglyLinked
+	class StreamingRequest : public SinglyLinked, public PoolAllocated
 	{
 	public:
 		StreamingRequest() {}
@@ -91,7 +93,7 @@ public:
 			{
 				auto& streamingManager = *static_cast<StreamingManager*>(requester);
 				streamingManager.run(&threadResources);
-			}});
+			}}, BackgroundPriority::high);
 		}
 	}
 
@@ -106,7 +108,7 @@ public:
 			{
 				auto& streamingManager = *static_cast<StreamingManager*>(requester);
 				streamingManager.run(&threadResources);
-			}});
+			}}, BackgroundPriority::high);
 		}
 	}
 
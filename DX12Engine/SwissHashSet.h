@@ -0,0 +1,744 @@
+#pragma once
+#include <memory>
+#include <functional> //std::hash, std::equal_to
+#include <limits>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <climits> //CHAR_BIT
+#include <cstring>
+#include <cassert>
+#include <new> //placement new
+#include <utility>
+#include "TriviallyRelocatable.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWISS_HASH_SET_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h> //_BitScanForward
+#endif
+
+/*
+* A set with the same interface as HashSet that keeps one control byte per bucket in a separate array from the values.
+* A full bucket's control byte holds 7 bits of the value's hash so a lookup compares 16 control bytes at once and only looks at
+* values whose bits match. Values don't carry any per bucket data so large values are packed tighter than in HashSet.
+* Uses SSE2 when available and a scalar loop otherwise.
+* Inserting or removing an item invalidates all pointers, references and iterators into the set.
+*/
+template<
+	class T,
+	class Hasher = std::hash<T>,
+	class EqualTo = std::equal_to<>,
+	class Allocator = std::allocator<T>,
+	class SizeType = std::size_t
+>
+class SwissHashSet
+{
+public:
+	using key_type = T;
+	using value_type = T;
+	using size_type = SizeType;
+	using difference_type = std::ptrdiff_t;
+	using hasher = Hasher;
+	using key_equal = EqualTo;
+	using allocator_type = Allocator;
+	using reference = value_type&;
+	using const_reference = const value_type&;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+private:
+	using Control = signed char;
+	constexpr static Control emptyControl = -128;
+	constexpr static Control deletedControl = -2;
+	constexpr static Control sentinelControl = -1; //after the last bucket so iteration stops. Full buckets are 0 to 127.
+	constexpr static size_type groupSize = 16u;
+
+	class alignas(16) Group
+	{
+		Control mControls[groupSize];
+
+		static unsigned int scalarMask(const Control* controls, Control value, bool lessThan) noexcept
+		{
+			unsigned int mask = 0u;
+			for (unsigned int i = 0u; i != groupSize; ++i)
+			{
+				if (lessThan ? controls[i] < value : controls[i] == value) mask |= 1u << i;
+			}
+			return mask;
+		}
+	public:
+		/*
+		Bit i is set if bucket i has control h2.
+		*/
+		static unsigned int match(const Control* controls, Control h2) noexcept
+		{
+#if defined(SWISS_HASH_SET_SSE2)
+			const __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(controls));
+			return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group)));
+#else
+			return scalarMask(controls, h2, false);
+#endif
+		}
+
+		static unsigned int matchEmpty(const Control* controls) noexcept
+		{
+			return match(controls, emptyControl);
+		}
+
+		static unsigned int matchEmptyOrDeleted(const Control* controls) noexcept
+		{
+#if defined(SWISS_HASH_SET_SSE2)
+			const __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(controls));
+			return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(sentinelControl), group)));
+#else
+			return scalarMask(controls, sentinelControl, true);
+#endif
+		}
+
+		static unsigned int lowestBit(unsigned int mask) noexcept
+		{
+			assert(mask != 0u);
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<unsigned int>(index);
+#else
+			return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+		}
+	};
+
+	template<class T2>
+	class Iterator
+	{
+		template<class T3, class Hasher2, class EqualTo2, class Allocator2, class SizeType2>
+		friend class SwissHashSet;
+		template<typename U>
+		friend class Iterator;
+		const Control* control;
+		T2* slot;
+	public:
+		using difference_type = std::ptrdiff_t;
+		using value_type = std::remove_const_t<T2>;
+		using pointer = T2*;
+		using reference = T2&;
+		using iterator_category = std::bidirectional_iterator_tag;
+
+		Iterator(const Control* control1, T2* slot1) : control(control1), slot(slot1) {}
+
+		template<class OtherType, class Tag = typename std::enable_if<std::is_same<OtherType, T2>::value || std::is_same<OtherType, typename std::remove_const<T2>::type>::value>::type>
+		Iterator(const Iterator<OtherType>& other) : control(other.control), slot(other.slot) {}
+
+		Iterator operator++()
+		{
+			do
+			{
+				++control;
+				++slot;
+			} while (*control < sentinelControl);
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator ret(*this);
+			++*this;
+			return ret;
+		}
+
+		Iterator operator--()
+		{
+			do
+			{
+				--control;
+				--slot;
+			} while (*control < sentinelControl);
+			return *this;
+		}
+
+		Iterator operator--(int)
+		{
+			Iterator ret(*this);
+			--*this;
+			return ret;
+		}
+
+		bool operator==(const Iterator& other) const noexcept
+		{
+			return control == other.control;
+		}
+
+		bool operator!=(const Iterator& other) const noexcept
+		{
+			return control != other.control;
+		}
+
+		reference operator*() const
+		{
+			return *slot;
+		}
+
+		pointer operator->()
+		{
+			return slot;
+		}
+	};
+public:
+	using iterator = Iterator<value_type>;
+	using const_iterator = Iterator<const value_type>;
+private:
+	struct HasherWrapper : private Hasher
+	{
+		template<class... Key>
+		auto hash(const Key&... value) const -> decltype(std::declval<Hasher>()(value...))
+		{
+			return (*this)(value...);
+		}
+	};
+
+	struct EqualToWrapper : private EqualTo
+	{
+		template<class... Keys>
+		bool equal(const T& value1, const Keys&... value2) const
+		{
+			return (*this)(value1, value2...);
+		}
+	};
+
+	class AllocatorWrapper : private std::allocator_traits<Allocator>::template rebind_alloc<T>
+	{
+		using Base = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+		using GroupAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Group>;
+		using Traits = std::allocator_traits<Base>;
+		using GroupTraits = std::allocator_traits<GroupAllocator>;
+	public:
+		AllocatorWrapper() = default;
+
+		explicit AllocatorWrapper(const Allocator& allocator) noexcept : Base(allocator) {}
+
+		T* allocateSlots(std::size_t n)
+		{
+			return Traits::allocate(*static_cast<Base*>(this), n);
+		}
+
+		void deallocateSlots(T* p, std::size_t n)
+		{
+			Traits::deallocate(*static_cast<Base*>(this), p, n);
+		}
+
+		Control* allocateControls(std::size_t groupCount)
+		{
+			GroupAllocator allocator(*static_cast<Base*>(this));
+			return reinterpret_cast<Control*>(GroupTraits::allocate(allocator, groupCount));
+		}
+
+		void deallocateControls(Control* p, std::size_t groupCount)
+		{
+			GroupAllocator allocator(*static_cast<Base*>(this));
+			GroupTraits::deallocate(allocator, reinterpret_cast<Group*>(p), groupCount);
+		}
+	};
+
+	struct Impl : public HasherWrapper, public EqualToWrapper, public AllocatorWrapper
+	{
+		Control* controls;
+		value_type* slots;
+		size_type maxBucketCount; //zero or a power of 2 that is at least groupSize
+		size_type mSize;
+		size_type deletedCount;
+		size_type loadThreshold;
+
+		/*
+		One extra group holds the sentinel. Its other bytes are never read.
+		*/
+		static size_type groupCount(size_type maxBucketCount) noexcept
+		{
+			return maxBucketCount / groupSize + 1u;
+		}
+
+		void allocateTable(size_type newMaxBucketCount)
+		{
+			maxBucketCount = newMaxBucketCount;
+			loadThreshold = newMaxBucketCount - newMaxBucketCount / 8u;
+			controls = this->allocateControls(groupCount(newMaxBucketCount));
+			slots = this->allocateSlots(newMaxBucketCount);
+			std::memset(controls, emptyControl, newMaxBucketCount);
+			std::memset(controls + newMaxBucketCount, sentinelControl, groupSize);
+			deletedCount = 0u;
+		}
+
+		void destruct() noexcept
+		{
+			if (maxBucketCount != 0u)
+			{
+				if (mSize != 0u)
+				{
+					for (size_type i = 0u; i != maxBucketCount; ++i)
+					{
+						if (controls[i] >= 0) slots[i].~value_type();
+					}
+				}
+				this->deallocateSlots(slots, maxBucketCount);
+				this->deallocateControls(controls, groupCount(maxBucketCount));
+			}
+		}
+
+		void copyHelper(const Impl& other)
+		{
+			mSize = 0u;
+			if (other.mSize != 0u)
+			{
+				allocateTable(other.maxBucketCount);
+				for (size_type i = 0u; i != maxBucketCount; ++i)
+				{
+					if (other.controls[i] >= 0)
+					{
+						new(&slots[i]) value_type(other.slots[i]);
+						++mSize;
+					}
+				}
+				//deleted buckets are kept as lookups might need to probe past them
+				std::memcpy(controls, other.controls, maxBucketCount);
+				deletedCount = other.deletedCount;
+			}
+			else
+			{
+				controls = nullptr;
+				slots = nullptr;
+				maxBucketCount = 0u;
+				deletedCount = 0u;
+				loadThreshold = 0u;
+			}
+		}
+
+		void takeTable(Impl& other) noexcept
+		{
+			controls = other.controls;
+			slots = other.slots;
+			maxBucketCount = other.maxBucketCount;
+			mSize = other.mSize;
+			deletedCount = other.deletedCount;
+			loadThreshold = other.loadThreshold;
+
+			other.controls = nullptr;
+			other.slots = nullptr;
+			other.maxBucketCount = 0u;
+			other.mSize = 0u;
+			other.deletedCount = 0u;
+			other.loadThreshold = 0u;
+		}
+
+		Impl() noexcept :
+			controls(nullptr),
+			slots(nullptr),
+			maxBucketCount(0u),
+			mSize(0u),
+			deletedCount(0u),
+			loadThreshold(0u)
+		{}
+
+		explicit Impl(const Allocator& allocator) noexcept :
+			AllocatorWrapper(allocator),
+			controls(nullptr),
+			slots(nullptr),
+			maxBucketCount(0u),
+			mSize(0u),
+			deletedCount(0u),
+			loadThreshold(0u)
+		{}
+
+		Impl(Impl&& other) noexcept :
+			HasherWrapper(static_cast<HasherWrapper&&>(other)),
+			EqualToWrapper(static_cast<EqualToWrapper&&>(other)),
+			AllocatorWrapper(static_cast<AllocatorWrapper&&>(other))
+		{
+			takeTable(other);
+		}
+
+		Impl(const Impl& other) :
+			HasherWrapper(static_cast<const HasherWrapper&>(other)),
+			EqualToWrapper(static_cast<const EqualToWrapper&>(other)),
+			AllocatorWrapper(static_cast<const AllocatorWrapper&>(other))
+		{
+			copyHelper(other);
+		}
+
+		void operator=(const Impl& other)
+		{
+			if (this == &other) return;
+			destruct();
+
+			static_cast<HasherWrapper&>(*this) = static_cast<const HasherWrapper&>(other);
+			static_cast<EqualToWrapper&>(*this) = static_cast<const EqualToWrapper&>(other);
+			static_cast<AllocatorWrapper&>(*this) = static_cast<const AllocatorWrapper&>(other);
+			copyHelper(other);
+		}
+
+		void operator=(Impl&& other)
+		{
+			if (this == &other) return;
+			destruct();
+
+			static_cast<HasherWrapper&>(*this) = static_cast<HasherWrapper&&>(other);
+			static_cast<EqualToWrapper&>(*this) = static_cast<EqualToWrapper&&>(other);
+			static_cast<AllocatorWrapper&>(*this) = static_cast<AllocatorWrapper&&>(other);
+			takeTable(other);
+		}
+
+		~Impl() noexcept
+		{
+			destruct();
+		}
+	};
+	Impl impl;
+
+	/*
+	The low 7 bits of the mixed hash go in the control byte and the rest pick the first group to probe.
+	The hash is mixed first as std::hash is often the identity for integers.
+	*/
+	static std::size_t mix(std::size_t hash) noexcept
+	{
+		if constexpr (sizeof(std::size_t) == 8u)
+		{
+			const std::uint64_t product = static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15u;
+			return static_cast<std::size_t>(product ^ (product >> 32u));
+		}
+		else
+		{
+			const std::uint32_t product = static_cast<std::uint32_t>(hash) * 0x9e3779b9u;
+			return static_cast<std::size_t>(product ^ (product >> 16u));
+		}
+	}
+
+	static Control h2(std::size_t hash) noexcept
+	{
+		return static_cast<Control>(hash & 0x7fu);
+	}
+
+	/*
+	Visits groups in triangular number order, which visits every group once when the number of groups is a power of 2.
+	*/
+	class ProbeSequence
+	{
+		size_type mMask;
+		size_type mOffset;
+		size_type mStep = 0u;
+	public:
+		ProbeSequence(std::size_t hash, size_type maxBucketCount) noexcept :
+			mMask(maxBucketCount / groupSize - 1u),
+			mOffset(static_cast<size_type>(hash >> 7u) & mMask)
+		{}
+
+		size_type groupStart() const noexcept
+		{
+			return mOffset * groupSize;
+		}
+
+		void next() noexcept
+		{
+			++mStep;
+			mOffset = (mOffset + mStep) & mMask;
+		}
+	};
+
+	size_type findEmptyOrDeleted(std::size_t hash) const noexcept
+	{
+		ProbeSequence probe(hash, impl.maxBucketCount);
+		while (true)
+		{
+			const unsigned int mask = Group::matchEmptyOrDeleted(impl.controls + probe.groupStart());
+			if (mask != 0u) return probe.groupStart() + Group::lowestBit(mask);
+			probe.next();
+		}
+	}
+
+	/*
+	Replaces all deleted buckets with empty ones by moving every value into a new table.
+	*/
+	void rehashNoChecks(size_type newMaxBucketCount)
+	{
+		Control* const oldControls = impl.controls;
+		value_type* const oldSlots = impl.slots;
+		const size_type oldMaxBucketCount = impl.maxBucketCount;
+
+		impl.allocateTable(newMaxBucketCount);
+		if (oldMaxBucketCount != 0u)
+		{
+			for (size_type i = 0u; i != oldMaxBucketCount; ++i)
+			{
+				if (oldControls[i] >= 0)
+				{
+					const std::size_t hash = mix(impl.hash(oldSlots[i]));
+					const size_type bucket = findEmptyOrDeleted(hash);
+					relocate(oldSlots + i, 1u, impl.slots + bucket);
+					impl.controls[bucket] = h2(hash);
+				}
+			}
+			impl.deallocateSlots(oldSlots, oldMaxBucketCount);
+			impl.deallocateControls(oldControls, Impl::groupCount(oldMaxBucketCount));
+		}
+	}
+
+	/*
+	Makes room for one more value. Deleted buckets are cleared out without growing when they are at least a quarter of the load threshold.
+	*/
+	void reserveOneMore()
+	{
+		if (impl.mSize + impl.deletedCount < impl.loadThreshold) return;
+		if (impl.maxBucketCount == 0u)
+		{
+			rehashNoChecks(groupSize);
+		}
+		else if (impl.deletedCount >= impl.loadThreshold / 4u)
+		{
+			rehashNoChecks(impl.maxBucketCount);
+		}
+		else
+		{
+			rehashNoChecks(impl.maxBucketCount * 2u);
+		}
+	}
+
+	size_type insertNoChecks(value_type&& value)
+	{
+		reserveOneMore();
+		const std::size_t hash = mix(impl.hash(value));
+		const size_type bucket = findEmptyOrDeleted(hash);
+		if (impl.controls[bucket] == deletedControl) --impl.deletedCount;
+		new(&impl.slots[bucket]) value_type(std::move(value));
+		impl.controls[bucket] = h2(hash);
+		++impl.mSize;
+		return bucket;
+	}
+
+	template<class... Key>
+	size_type findImpl(const Key&... value) const
+	{
+		if (impl.maxBucketCount == 0u) return 0u;
+		const std::size_t hash = mix(impl.hash(value...));
+		const Control control = h2(hash);
+		ProbeSequence probe(hash, impl.maxBucketCount);
+		while (true)
+		{
+			const Control* const group = impl.controls + probe.groupStart();
+			for (unsigned int mask = Group::match(group, control); mask != 0u; mask &= mask - 1u)
+			{
+				const size_type bucket = probe.groupStart() + Group::lowestBit(mask);
+				if (impl.equal(impl.slots[bucket], value...)) return bucket;
+			}
+			if (Group::matchEmpty(group) != 0u) return impl.maxBucketCount;
+			probe.next();
+		}
+	}
+
+	static size_type roundUpToPowerOf2(size_type v)
+	{
+		--v;
+		constexpr auto numberOfBitsInSizeType = (size_type)(sizeof(size_type) * CHAR_BIT);
+		for (size_type i = (size_type)1u; i != numberOfBitsInSizeType; i *= (size_type)2u)
+		{
+			v |= v >> i;
+		}
+		++v;
+		return v;
+	}
+
+	iterator makeIterator(size_type bucket) noexcept
+	{
+		return iterator(impl.controls + bucket, impl.slots + bucket);
+	}
+
+	const_iterator makeIterator(size_type bucket) const noexcept
+	{
+		return const_iterator(impl.controls + bucket, impl.slots + bucket);
+	}
+public:
+	SwissHashSet() noexcept = default;
+
+	explicit SwissHashSet(const Allocator& allocator) noexcept : impl(allocator) {}
+
+	SwissHashSet(SwissHashSet&&) noexcept = default;
+
+	SwissHashSet(const SwissHashSet&) = default;
+
+	~SwissHashSet() noexcept = default;
+
+	void operator=(SwissHashSet&& other)
+	{
+		impl = std::move(other.impl);
+	}
+
+	void operator=(const SwissHashSet& other)
+	{
+		impl = other.impl;
+	}
+
+	iterator begin()
+	{
+		if (impl.mSize == 0u) return end();
+		iterator ret = makeIterator(0u);
+		if (*ret.control < sentinelControl) ++ret;
+		return ret;
+	}
+
+	const_iterator begin() const
+	{
+		if (impl.mSize == 0u) return end();
+		const_iterator ret = makeIterator(0u);
+		if (*ret.control < sentinelControl) ++ret;
+		return ret;
+	}
+
+	const_iterator cbegin() const
+	{
+		return begin();
+	}
+
+	iterator end()
+	{
+		return makeIterator(impl.maxBucketCount);
+	}
+
+	const_iterator end() const
+	{
+		return makeIterator(impl.maxBucketCount);
+	}
+
+	const_iterator cend() const
+	{
+		return end();
+	}
+
+	bool empty() const noexcept
+	{
+		return impl.mSize == 0u;
+	}
+
+	size_type size() const noexcept
+	{
+		return impl.mSize;
+	}
+
+	size_type loadThreshold() const noexcept
+	{
+		return impl.loadThreshold;
+	}
+
+	size_type max_size() const noexcept
+	{
+		return std::numeric_limits<size_type>::max() / 8u * 7u;
+	}
+
+	/*
+	Doesn't check if value is already in the set.
+	*/
+	void insert(value_type value)
+	{
+		insertNoChecks(std::move(value));
+	}
+
+	iterator insertAndGet(value_type value)
+	{
+		return makeIterator(insertNoChecks(std::move(value)));
+	}
+
+	template<class... Key>
+	iterator find(const Key&... value)
+	{
+		return makeIterator(findImpl(value...));
+	}
+
+	template<class... Key>
+	const_iterator find(const Key&... value) const
+	{
+		return makeIterator(findImpl(value...));
+	}
+
+	template<class... Key>
+	bool contains(const Key&... values) const
+	{
+		return findImpl(values...) != impl.maxBucketCount;
+	}
+
+	void clear()
+	{
+		if (impl.maxBucketCount == 0u) return;
+		if (impl.mSize != 0u)
+		{
+			for (size_type i = 0u; i != impl.maxBucketCount; ++i)
+			{
+				if (impl.controls[i] >= 0) impl.slots[i].~value_type();
+			}
+		}
+		std::memset(impl.controls, emptyControl, impl.maxBucketCount);
+		impl.mSize = 0u;
+		impl.deletedCount = 0u;
+	}
+
+	void erase(const_iterator pos)
+	{
+		const size_type bucket = static_cast<size_type>(pos.control - impl.controls);
+		impl.slots[bucket].~value_type();
+		--impl.mSize;
+		/*
+		Probing only moves past a group once it is full and a full group never gets an empty bucket back,
+		so if this group still has an empty bucket no lookup depends on this bucket being occupied.
+		*/
+		const Control* const group = impl.controls + (bucket & ~(groupSize - 1u));
+		if (Group::matchEmpty(group) != 0u)
+		{
+			impl.controls[bucket] = emptyControl;
+		}
+		else
+		{
+			impl.controls[bucket] = deletedControl;
+			++impl.deletedCount;
+		}
+	}
+
+	void erase(iterator pos)
+	{
+		erase((const_iterator)pos);
+	}
+
+	template<class... Key>
+	void erase(const Key&... values)
+	{
+		const size_type bucket = findImpl(values...);
+		if (bucket != impl.maxBucketCount)
+		{
+			erase(makeIterator(bucket));
+		}
+	}
+
+	template<class F>
+	void consume(F&& f)
+	{
+		if (impl.mSize != 0u)
+		{
+			for (size_type i = 0u; i != impl.maxBucketCount; ++i)
+			{
+				if (impl.controls[i] >= 0)
+				{
+					f(std::move(impl.slots[i]));
+					impl.slots[i].~value_type();
+				}
+			}
+			impl.mSize = 0u;
+		}
+		clear();
+	}
+
+	void shrink_to_size(size_type size)
+	{
+		assert(size >= impl.mSize);
+		if (size >= impl.loadThreshold) return; //already small enough
+		size_type newMaxBucketCount = roundUpToPowerOf2(size + size / 7u + 1u);
+		if (newMaxBucketCount < groupSize) newMaxBucketCount = groupSize;
+		if (newMaxBucketCount >= impl.maxBucketCount) return;
+		rehashNoChecks(newMaxBucketCount);
+	}
+};
+
+#undef SWISS_HASH_SET_SSE2
@@ -0,0 +1,23 @@
+#pragma once
+#include <atomic>
+
+/*
+Counts how many predecessors of a continuation have finished.
+The last predecessor to finish is told to run the continuation and the counter resets itself so it can be reused.
+*/
+class TaskCounter
+{
+	std::atomic<unsigned int> mFinishedCount = 0u;
+public:
+	/*
+	Must be called once by each of predecessorCount predecessors when they finish. Returns true for the last one.
+	The counter is reset before returning true so the continuation can safely destroy it.
+	*/
+	bool finished(unsigned int predecessorCount) noexcept
+	{
+		//uses memory_order_acq_rel because the last predecessor needs to see the work done by the others and the others need to release their work
+		if (mFinishedCount.fetch_add(1u, std::memory_order_acq_rel) != predecessorCount - 1u) return false;
+		mFinishedCount.store(0u, std::memory_order_relaxed);
+		return true;
+	}
+};
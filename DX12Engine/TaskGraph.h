@@ -0,0 +1,108 @@
+#pragma once
+#include "TaskCounter.h"
+#include "ResizingArray.h"
+#include "Delegate.h"
+#include <cstddef>
+#include <cassert>
+
+/*
+A static graph of tasks that can be built once and run every frame without allocating.
+When a node's task finishes, every successor whose predecessors have all finished is pushed onto its queue.
+Nodes must be run on primary threads unless all of their successors are background nodes.
+*/
+template<class ThreadResources>
+class TaskGraph
+{
+public:
+	using Task = Delegate<void(ThreadResources& threadResources)>;
+
+	enum class QueueType : unsigned char
+	{
+		currentPhase, //runs in the phase that its last predecessor finished in
+		primary, //runs the next time phase phaseIndex runs
+		background,
+	};
+
+	class Node
+	{
+		friend class TaskGraph<ThreadResources>;
+
+		Task mTask;
+		ResizingArray<Node*> mSuccessors;
+		TaskCounter mFinishedPredecessors;
+		unsigned int mPredecessorCount = 0u;
+		std::size_t mPhaseIndex;
+		QueueType mQueueType;
+
+		static void run(void* context, ThreadResources& threadResources)
+		{
+			Node& node = *static_cast<Node*>(context);
+			node.mTask(threadResources);
+			for (Node* successor : node.mSuccessors)
+			{
+				if (successor->mFinishedPredecessors.finished(successor->mPredecessorCount))
+				{
+					successor->schedule(threadResources);
+				}
+			}
+		}
+	public:
+		Node(Task task, QueueType queueType = QueueType::currentPhase, std::size_t phaseIndex = 0u) :
+			mTask(task),
+			mPhaseIndex(phaseIndex),
+			mQueueType(queueType)
+		{}
+
+		Node(const Node&) = delete;
+		Node& operator=(const Node&) = delete;
+
+		/*
+		Pushes the node onto its queue without waiting for predecessors.
+		*/
+		void schedule(ThreadResources& threadResources)
+		{
+			switch (mQueueType)
+			{
+			case QueueType::currentPhase:
+				threadResources.taskShedular.pushCurrentPhaseTask({ this, run });
+				break;
+			case QueueType::primary:
+				threadResources.taskShedular.pushPrimaryTask(mPhaseIndex, { this, run });
+				break;
+			case QueueType::background:
+				threadResources.taskShedular.pushBackgroundTask({ this, run });
+				break;
+			}
+		}
+	};
+private:
+	ResizingArray<Node*> mNodes;
+public:
+	/*
+	Nodes and dependencies can only be added while the graph isn't running.
+	*/
+	void addNode(Node& node)
+	{
+		mNodes.push_back(&node);
+	}
+
+	static void addDependency(Node& predecessor, Node& successor)
+	{
+		predecessor.mSuccessors.push_back(&successor);
+		++successor.mPredecessorCount;
+	}
+
+	/*
+	Schedules every node without predecessors. Can only be called again after every node in the graph has run.
+	*/
+	void start(ThreadResources& threadResources)
+	{
+		for (Node* node : mNodes)
+		{
+			if (node->mPredecessorCount == 0u)
+			{
+				node->schedule(threadResources);
+			}
+		}
+	}
+};
@@ -0,0 +1,123 @@
+#pragma once
+#if defined(TASK_SHEDULAR_REPLAY)
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/*
+The order that each TaskShedular thread took tasks from the primary queues in, so that a run can be repeated exactly.
+While recording, every take from a queue is numbered. When replaying, each thread takes from the same queues in the same order
+and waits until all earlier takes from a queue have happened before taking from it.
+Only compiled in when TASK_SHEDULAR_REPLAY is defined.
+Replays only match if the same tasks are pushed in the same order on each thread, so tasks must not depend on timing.
+Threads also start in the recorded order as that decides their index in the barrier.
+Background tasks, tasks pushed from other threads and which threads leave the barrier to do background tasks aren't recorded.
+*/
+class TaskSchedule
+{
+public:
+	enum class Mode : unsigned char
+	{
+		record,
+		replay,
+	};
+
+	class Action
+	{
+	public:
+		unsigned int victim; //index of the thread whose queue was taken from or endPhase
+		unsigned int takeIndex; //number of earlier takes from the queue this phase
+		unsigned int count; //number of tasks taken, more than one when stealing half of a queue
+	};
+	constexpr static unsigned int endPhase = ~0u; //the thread ran out of tasks and called the next phase task
+private:
+	std::unique_ptr<std::vector<Action>[]> mActions;
+	std::unique_ptr<unsigned int[]> mStartOrder; //mStartOrder[i] is the number of threads that started before thread i
+	unsigned int mThreadCount;
+	Mode mMode;
+	std::atomic<bool> mHasDiverged = false;
+public:
+	TaskSchedule(unsigned int threadCount, Mode mode) : mActions(new std::vector<Action>[threadCount]), mStartOrder(new unsigned int[threadCount]()), mThreadCount(threadCount), mMode(mode) {}
+
+	Mode mode() const noexcept
+	{
+		return mMode;
+	}
+
+	/*
+	Switches between recording and replaying. Can't be called while a TaskShedular is using the schedule.
+	*/
+	void setMode(Mode mode) noexcept
+	{
+		mMode = mode;
+		mHasDiverged.store(false, std::memory_order_relaxed);
+	}
+
+	unsigned int threadCount() const noexcept
+	{
+		return mThreadCount;
+	}
+
+	std::vector<Action>& actions(unsigned int threadIndex) noexcept
+	{
+		return mActions[threadIndex];
+	}
+
+	const std::vector<Action>& actions(unsigned int threadIndex) const noexcept
+	{
+		return mActions[threadIndex];
+	}
+
+	unsigned int& startOrder(unsigned int threadIndex) noexcept
+	{
+		return mStartOrder[threadIndex];
+	}
+
+	/*
+	Set when a thread can't do what was recorded, for example because different tasks were pushed.
+	Every thread then stops replaying so that threads waiting for a take that will never happen don't wait forever.
+	*/
+	bool hasDiverged() const noexcept
+	{
+		return mHasDiverged.load(std::memory_order_relaxed);
+	}
+
+	void diverge() noexcept
+	{
+		mHasDiverged.store(true, std::memory_order_relaxed);
+	}
+
+	void write(std::ostream& stream) const
+	{
+		stream.write(reinterpret_cast<const char*>(&mThreadCount), sizeof(mThreadCount));
+		stream.write(reinterpret_cast<const char*>(mStartOrder.get()), mThreadCount * sizeof(unsigned int));
+		for (unsigned int i = 0u; i != mThreadCount; ++i)
+		{
+			const unsigned long long actionCount = mActions[i].size();
+			stream.write(reinterpret_cast<const char*>(&actionCount), sizeof(actionCount));
+			stream.write(reinterpret_cast<const char*>(mActions[i].data()), static_cast<std::streamsize>(actionCount * sizeof(Action)));
+		}
+	}
+
+	/*
+	Reads a schedule written by write. Returns false if the stream doesn't hold a schedule for the same number of threads.
+	*/
+	bool read(std::istream& stream)
+	{
+		unsigned int threadCount;
+		if (!stream.read(reinterpret_cast<char*>(&threadCount), sizeof(threadCount)) || threadCount != mThreadCount) return false;
+		if (!stream.read(reinterpret_cast<char*>(mStartOrder.get()), mThreadCount * sizeof(unsigned int))) return false;
+		for (unsigned int i = 0u; i != mThreadCount; ++i)
+		{
+			unsigned long long actionCount;
+			if (!stream.read(reinterpret_cast<char*>(&actionCount), sizeof(actionCount))) return false;
+			mActions[i].resize(static_cast<std::size_t>(actionCount));
+			if (!stream.read(reinterpret_cast<char*>(mActions[i].data()), static_cast<std::streamsize>(actionCount * sizeof(Action)))) return false;
+		}
+		return true;
+	}
+};
+#endif
@@ -3,26 +3,103 @@
 #include "BackgroundQueue.h"
 #include "PrimaryTaskFromOtherThreadQueue.h"
 #include "ThreadBarrier.h"
-#include "Delegate.h"
+#include "InlineDelegate.h"
+#include "TaskCounter.h"
+#include "TaskTrace.h"
+#include "CpuTopology.h"
+#include "TaskSchedule.h"
+#include "TimerWheel.h"
+#include "ResizingArray.h"
 #include <array>
 #include "makeArray.h"
 #include <cstddef>
 #include <cassert>
 #include <atomic>
 #include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <immintrin.h> //_mm_pause
+#if defined(TASK_SHEDULAR_TRACING)
+#include <ostream>
+#endif
 
-template<class ThreadResources>
+/*
+Each frame is split into numberOfPhases phases separated by barriers. Each phase has its own double buffered primary queues,
+one for the current frame and one for tasks pushed for the next time the phase runs.
+*/
+template<class ThreadResources, std::size_t numberOfPhases = 2u>
 class TaskShedular
 {
-private:
-	constexpr static std::size_t numberOfPrimaryQueues = 2u; //can't change this yet as we still have update1 and update2
+	static_assert(numberOfPhases != 0u, "TaskShedular needs at least one phase");
 public:
-	using Task = Delegate<void(ThreadResources& threadResources)>;
+	constexpr static std::size_t numberOfPrimaryQueues = numberOfPhases;
+	constexpr static std::size_t lastPhaseIndex = numberOfPrimaryQueues - 1u;
+
+	/*
+	Tasks can carry a few values by value. See InlineDelegate.
+	*/
+	using Task = InlineDelegate<void(ThreadResources& threadResources)>;
 	using NextPhaseTask = bool(*)(ThreadResources& threadResources, void* context);
+	using Clock = std::chrono::steady_clock;
+
+	class StealStatistics
+	{
+	public:
+		unsigned long long stealAttempts;
+		unsigned long long successfulSteals;
+		unsigned long long stolenTasks; //includes the extra tasks taken when stealing half of a queue
+	};
+
+	class ElasticSettings
+	{
+	public:
+		unsigned int idleFramesBeforeParking; //zero turns parking off
+		std::size_t wakeQueueDepth; //a parked thread is woken when more tasks than this are queued for a phase when it starts
+	};
+
+	class BackgroundStatistics
+	{
+	public:
+		Clock::duration runTime; //time spent running background tasks
+		Clock::duration deferredTime; //how long background tasks were put off for because frames were late, counted when they restart
+		unsigned int deferredCount; //number of times a thread skipped or stopped running background tasks because the frame was late
+	};
+
+private:
+	class DelayedTask
+	{
+	public:
+		Task task;
+		const char* name;
+		unsigned int queueIndex; //a phase index or numberOfPrimaryQueues plus a background priority
+	};
 
+	/*
+	A delayed task given up by a thread that parked.
+	*/
+	class HandedOverTask
+	{
+	public:
+		DelayedTask delayedTask;
+		std::uint64_t dueTick;
+		bool isFrameTask; //dueTick is a frame number instead of milliseconds since the TaskShedular was made
+	};
+public:
 	class ThreadLocal
 	{
 	private:
+		/*
+		Number of times all other queues are searched before giving up and calling the next phase task.
+		The thread spins for twice as long after each failed search.
+		*/
+		constexpr static unsigned int maxStealRounds = 4u;
+		constexpr static unsigned int initialBackoffSpinCount = 16u;
+		/*
+		Number of frames in a row a thread can skip background tasks because the frame is late before it runs one anyway.
+		*/
+		constexpr static unsigned int maxDeferredFrames = 8u;
+
 		class PrimaryQueue
 		{
 		public:
@@ -34,10 +111,37 @@ public:
 		WorkStealingQueue<Task>* mCurrentQueue;
 		BackgroundQueue<Task> mBackgroundQueue;
 
+		TimerWheel<DelayedTask> mFrameTimers; //ticks are frames
+		TimerWheel<DelayedTask> mTimeTimers; //ticks are milliseconds since the TaskShedular was made
+
 		ThreadBarrier::ThreadLocal barrier;
+		TaskTraceBuffer<Task> mTrace;
 	
 		unsigned int mIndex;
 		unsigned int mCurrentBackgroundQueueIndex;
+		/*
+		The other threads ordered from nearest to furthest in hardware. mVictimGroupEnds[d] is the end of the threads at distance d.
+		Without a CpuTopology every thread is in one group.
+		*/
+		std::unique_ptr<unsigned int[]> mVictims;
+		unsigned int mVictimGroupEnds[CpuTopology::distanceCount];
+		unsigned int mDeferredFrameCount = 0u; //frames in a row that background tasks were deferred
+		unsigned int mIdleFrameCount = 0u; //frames in a row that this thread didn't run any primary tasks
+		bool mRanTaskThisFrame = false;
+		Clock::time_point mDeferredSince;
+#if defined(TASK_SHEDULAR_REPLAY)
+		std::size_t mReplayPosition = 0u;
+#endif
+
+		//Only written by the thread that owns this ThreadLocal but can be read by any thread.
+		std::atomic<unsigned long long> mStealAttempts = 0u;
+		std::atomic<unsigned long long> mSuccessfulSteals = 0u;
+		std::atomic<unsigned long long> mStolenTasks = 0u;
+
+		static void increment(std::atomic<unsigned long long>& counter, unsigned long long amount = 1u) noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
 
 		void swap(WorkStealingQueue<Task>*& lhs, WorkStealingQueue<Task>*& rhs)
 		{
@@ -46,6 +150,20 @@ public:
 			rhs = temp;
 		}
 
+		void runTask(Task& task, ThreadResources& threadResources)
+		{
+			mTrace.record(TaskTraceEventType::taskBegin, task);
+			task(threadResources);
+			mTrace.record(TaskTraceEventType::taskEnd);
+		}
+
+		std::size_t currentPhaseIndex() const noexcept
+		{
+			std::size_t phaseIndex = 0u;
+			while (primaryQueues[phaseIndex].currentQueue != mCurrentQueue) ++phaseIndex;
+			return phaseIndex;
+		}
+
 		static unsigned int lockAndGetNextBackgroundQueue(unsigned int currentIndex, unsigned int threadCount, BackgroundQueue<Task>** backgroundQueues)
 		{
 			while (true)
@@ -56,63 +174,406 @@ public:
 			}
 		}
 
-		void runBackgroundTasks(TaskShedular& taskShedular, ThreadResources& threadResources, unsigned int currentBackgroundQueueIndex)
+		void deferBackgroundTasks(TaskShedular& taskShedular, Clock::time_point now) noexcept
+		{
+			if (mDeferredFrameCount == 0u) mDeferredSince = now;
+			++mDeferredFrameCount;
+			taskShedular.mDeferredCount.fetch_add(1u, std::memory_order_relaxed);
+		}
+
+		/*
+		Called when background tasks stop being put off, because they run or because there are none left waiting. Counts how long they waited.
+		*/
+		void endDeferral(TaskShedular& taskShedular, Clock::time_point now) noexcept
+		{
+			if (mDeferredFrameCount == 0u) return;
+			taskShedular.mDeferredTime.fetch_add((now - mDeferredSince).count(), std::memory_order_relaxed);
+			mDeferredFrameCount = 0u;
+		}
+
+		/*
+		Runs tasks from the locked queue until it is empty or the frame that is running goes over budget.
+		*/
+		void runBackgroundTasks(TaskShedular& taskShedular, ThreadResources& threadResources, unsigned int currentBackgroundQueueIndex, Clock::time_point startTime)
 		{
 			Task task;
 			auto& queue = *taskShedular.mBackgroundQueues[currentBackgroundQueueIndex];
-			while (queue.pop(task))
+			Clock::time_point now;
+			while (true)
 			{
-				task(threadResources);
+				now = Clock::now();
+				if (taskShedular.isFrameLate(now))
+				{
+					if (!queue.empty()) deferBackgroundTasks(taskShedular, now);
+					else endDeferral(taskShedular, now);
+					break;
+				}
+				if (!queue.pop(task))
+				{
+					endDeferral(taskShedular, now);
+					break;
+				}
+				runTask(task, threadResources);
 			}
 			queue.unlock();
+			taskShedular.mBackgroundRunTime.fetch_add((now - startTime).count(), std::memory_order_relaxed);
+			mTrace.record(TaskTraceEventType::backgroundEnd);
 		}
 
-		template<void(*prepairForUpdate2)(ThreadResources& threadResources, void* context)>
+		template<void(*prepairForPhase)(ThreadResources& threadResources, void* context, std::size_t phaseIndex)>
 		void getIntoCorrectStateAfterDoingBackgroundTasks(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
 		{
+			mTrace.record(TaskTraceEventType::barrierBegin);
 			taskShedular.barrier.addThread(barrier);
+			mTrace.record(TaskTraceEventType::barrierEnd);
 
-			if (taskShedular.mCurrentWorkStealingQueues[mIndex] == primaryQueues[0].currentQueue)
+			//The current row of queues tells us which phase is running and which of each phase's queues belongs to this frame.
+			const std::size_t rowIndex = static_cast<std::size_t>(taskShedular.mCurrentWorkStealingQueues - taskShedular.mWorkStealingQueuesArray.get()) / taskShedular.mThreadCount;
+			const std::size_t bufferIndex = rowIndex / numberOfPrimaryQueues;
+			const std::size_t phaseIndex = rowIndex % numberOfPrimaryQueues;
+			for (std::size_t i = 0u; i != numberOfPrimaryQueues; ++i)
 			{
-				primaryQueues[1].currentQueue->resetIfInvalid();
-				primaryQueues[1].nextQueue->resetIfInvalid();
-				primaryQueues[0].nextQueue->resetIfInvalid();
+				auto& primaryQueue = primaryQueues[i];
+				//Phases that have started this frame use this frame's queue. Later phases still use last frame's queue.
+				const auto expectedCurrentQueue = &primaryQueue.queues[i <= phaseIndex ? bufferIndex : 1u - bufferIndex];
+				if (primaryQueue.currentQueue != expectedCurrentQueue)
+				{
+					swap(primaryQueue.currentQueue, primaryQueue.nextQueue);
+				}
+				if (i != phaseIndex)
+				{
+					primaryQueue.currentQueue->resetIfInvalid();
+				}
+				primaryQueue.nextQueue->resetIfInvalid();
+			}
+			mCurrentQueue = primaryQueues[phaseIndex].currentQueue;
+			mTrace.record(TaskTraceEventType::phaseStart, Task(), nullptr, static_cast<unsigned int>(phaseIndex));
+			releaseDelayedTasks(taskShedular);
 
-				swap(primaryQueues[1].currentQueue, primaryQueues[1].nextQueue);
+			prepairForPhase(threadResources, context, phaseIndex);
+		}
+
+		/*
+		Pushes the delayed tasks that are due. A task for the running phase goes in its current queue, other primary tasks go in the next
+		queue of their phase like pushPrimaryTask.
+		*/
+		void releaseDelayedTasks(TaskShedular& taskShedular)
+		{
+			if (taskShedular.mHasHandedOverTasks.load(std::memory_order_relaxed)) adoptHandedOverTasks(taskShedular);
+			const auto release = [this](DelayedTask&& delayedTask)
+			{
+				if (delayedTask.queueIndex >= numberOfPrimaryQueues)
+				{
+					pushBackgroundTask(delayedTask.task, static_cast<BackgroundPriority>(delayedTask.queueIndex - numberOfPrimaryQueues), delayedTask.name);
+				}
+				else if (primaryQueues[delayedTask.queueIndex].currentQueue == mCurrentQueue)
+				{
+					pushCurrentPhaseTask(delayedTask.task, delayedTask.name);
+				}
+				else
+				{
+					pushPrimaryTask(delayedTask.queueIndex, delayedTask.task, delayedTask.name);
+				}
+			};
+			mFrameTimers.advance(taskShedular.mFrameNumber.load(std::memory_order_relaxed), release);
+			if (mTimeTimers.size() != 0u) mTimeTimers.advance(taskShedular.millisecondsSinceStart(Clock::now()), release);
+		}
 
-				mCurrentQueue = primaryQueues[0].currentQueue;
+		/*
+		A parked thread can't release its delayed tasks so it gives them to the primary threads before it sleeps.
+		*/
+		void handOverDelayedTasks(TaskShedular& taskShedular)
+		{
+			if (mFrameTimers.size() == 0u && mTimeTimers.size() == 0u) return;
+			std::lock_guard<std::mutex> lock(taskShedular.mParkMutex);
+			auto& handedOverTasks = taskShedular.mHandedOverTasks;
+			mFrameTimers.removeAll([&handedOverTasks](DelayedTask&& delayedTask, std::uint64_t dueTick)
+				{
+					handedOverTasks.push_back({ std::move(delayedTask), dueTick, true });
+				});
+			mTimeTimers.removeAll([&handedOverTasks](DelayedTask&& delayedTask, std::uint64_t dueTick)
+				{
+					handedOverTasks.push_back({ std::move(delayedTask), dueTick, false });
+				});
+			taskShedular.mHasHandedOverTasks.store(true, std::memory_order_relaxed);
+		}
+
+		/*
+		Takes the delayed tasks given up by parked threads keeping their due ticks.
+		*/
+		void adoptHandedOverTasks(TaskShedular& taskShedular)
+		{
+			ResizingArray<HandedOverTask> handedOverTasks;
+			{
+				std::lock_guard<std::mutex> lock(taskShedular.mParkMutex);
+				handedOverTasks.swap(taskShedular.mHandedOverTasks);
+				taskShedular.mHasHandedOverTasks.store(false, std::memory_order_relaxed);
 			}
-			else if (taskShedular.mCurrentWorkStealingQueues[mIndex] == primaryQueues[1].currentQueue)
+			if (mTimeTimers.size() == 0u) mTimeTimers.advance(taskShedular.millisecondsSinceStart(Clock::now()), [](DelayedTask&&) {});
+			for (auto& handedOverTask : handedOverTasks)
 			{
-				primaryQueues[1].nextQueue->resetIfInvalid();
-				primaryQueues[0].currentQueue->resetIfInvalid();
-				primaryQueues[0].nextQueue->resetIfInvalid();
+				auto& timers = handedOverTask.isFrameTask ? mFrameTimers : mTimeTimers;
+				timers.push(std::move(handedOverTask.delayedTask), handedOverTask.dueTick);
+			}
+		}
+
+		void pushDelayedTask(TaskShedular& taskShedular, DelayedTask delayedTask, Clock::duration delay)
+		{
+			const Clock::time_point now = Clock::now();
+			if (mTimeTimers.size() == 0u) mTimeTimers.advance(taskShedular.millisecondsSinceStart(now), [](DelayedTask&&) {});
+			//Rounded up so the task is never released early.
+			mTimeTimers.push(delayedTask, taskShedular.millisecondsSinceStart(now + delay + std::chrono::milliseconds(1) - Clock::duration(1)));
+		}
+
+		/*
+		Must be called after the barrier at the end of phase phaseIndex.
+		*/
+		template<std::size_t phaseIndex>
+		void startNextPhase() noexcept
+		{
+			constexpr std::size_t nextPhaseIndex = phaseIndex == lastPhaseIndex ? 0u : phaseIndex + 1u;
+			primaryQueues[phaseIndex].currentQueue->reset();
+			swap(primaryQueues[nextPhaseIndex].currentQueue, primaryQueues[nextPhaseIndex].nextQueue);
+			mCurrentQueue = primaryQueues[nextPhaseIndex].currentQueue;
+			mTrace.record(TaskTraceEventType::phaseStart, Task(), nullptr, static_cast<unsigned int>(nextPhaseIndex));
+		}
 
-				prepairForUpdate2(threadResources, context);
+		/*
+		Takes half of the tasks in victimQueue after the first one has been stolen so that the next few tasks don't need to be stolen.
+		Returns the number of tasks stolen including the first one.
+		*/
+		unsigned long long stealHalf(WorkStealingQueue<Task>& victimQueue)
+		{
+			std::ptrdiff_t extraTaskCount = victimQueue.size() / 2;
+			unsigned long long stolenTaskCount = 1u;
+			Task task;
+			while (extraTaskCount != 0 && victimQueue.steal(task))
+			{
+				mCurrentQueue->push(task);
+				--extraTaskCount;
+				++stolenTaskCount;
 			}
-			else if (taskShedular.mCurrentWorkStealingQueues[mIndex] == primaryQueues[0].nextQueue)
+			increment(mStolenTasks, stolenTaskCount);
+			return stolenTaskCount;
+		}
+
+		/*
+		Steals from victimQueue and then half of what is left. Returns the number of tasks stolen which is zero if the queue was empty.
+		*/
+		unsigned long long stealFrom(unsigned int victimIndex, WorkStealingQueue<Task>& victimQueue, Task& task)
+		{
+			increment(mStealAttempts);
+			if (!victimQueue.steal(task)) return 0u;
+			increment(mSuccessfulSteals);
+			const unsigned long long stolenTaskCount = stealHalf(victimQueue);
+			mTrace.record(TaskTraceEventType::steal, Task(), nullptr, victimIndex, static_cast<unsigned int>(stolenTaskCount));
+			return stolenTaskCount;
+		}
+
+		/*
+		Searches the other threads' queues, nearest first, until tryStealFrom returns true. Within each group of threads at the same distance the search starts from a random one
+		so that idle threads don't all pick the same victim.
+		Backs off exponentially between searches as tasks can still be pushed by threads that are running.
+		*/
+		template<class TryStealFrom>
+		bool steal(const unsigned int threadCount, ThreadResources& threadResources, TryStealFrom&& tryStealFrom)
+		{
+			if (threadCount == 1u) return false;
+			unsigned int backoffSpinCount = initialBackoffSpinCount;
+			for (unsigned int round = 0u;; ++round)
 			{
-				primaryQueues[1].currentQueue->resetIfInvalid();
-				primaryQueues[1].nextQueue->resetIfInvalid();
-				primaryQueues[0].currentQueue->resetIfInvalid();
+				unsigned int groupBegin = 0u;
+				for (const unsigned int groupEnd : mVictimGroupEnds)
+				{
+					const unsigned int groupSize = groupEnd - groupBegin;
+					if (groupSize == 0u) continue;
+					const unsigned int start = threadResources.randomNumberGenerator(groupSize);
+					for (unsigned int i = 0u; i != groupSize; ++i)
+					{
+						if (tryStealFrom(mVictims[groupBegin + (start + i) % groupSize])) return true;
+					}
+					groupBegin = groupEnd;
+				}
+				if (round == maxStealRounds) return false;
+				for (unsigned int i = 0u; i != backoffSpinCount; ++i)
+				{
+					_mm_pause();
+				}
+				backoffSpinCount *= 2u;
+			}
+		}
+
+		bool findTaskWithoutSchedule(TaskShedular& taskShedular, WorkStealingQueue<Task>** currentWorkStealingQueues, WorkStealingQueue<Task>* currentQueue, ThreadResources& threadResources, Task& task)
+		{
+			if (currentQueue->pop(task)) return true;
+			return steal(taskShedular.mThreadCount, threadResources, [this, currentWorkStealingQueues, &task](unsigned int victimIndex)
+				{
+					return stealFrom(victimIndex, *currentWorkStealingQueues[victimIndex], task) != 0u;
+				});
+		}
 
-				swap(primaryQueues[0].currentQueue, primaryQueues[0].nextQueue);
+#if defined(TASK_SHEDULAR_REPLAY)
+		bool recordFindTask(TaskShedular& taskShedular, TaskSchedule& schedule, WorkStealingQueue<Task>** currentWorkStealingQueues, WorkStealingQueue<Task>* currentQueue,
+			ThreadResources& threadResources, Task& task)
+		{
+			auto queueStates = taskShedular.mReplayQueueStates.get() + (currentWorkStealingQueues - taskShedular.mWorkStealingQueuesArray.get());
+			auto& actions = schedule.actions(mIndex);
+			//Takes happen while holding the queue's lock so that they are numbered in the order they happened.
+			const auto takeWhileLocked = [queueStates, &actions](unsigned int victimIndex, auto&& take)
+			{
+				auto& queueState = queueStates[victimIndex];
+				while (queueState.lock.test_and_set(std::memory_order_acquire)) _mm_pause();
+				const auto takenCount = static_cast<unsigned int>(take());
+				if (takenCount != 0u)
+				{
+					const unsigned int takeIndex = queueState.takeCount.load(std::memory_order_relaxed);
+					queueState.takeCount.store(takeIndex + 1u, std::memory_order_relaxed);
+					actions.push_back({ victimIndex, takeIndex, takenCount });
+				}
+				queueState.lock.clear(std::memory_order_release);
+				return takenCount != 0u;
+			};
 
-				mCurrentQueue = primaryQueues[0].currentQueue;
+			if (takeWhileLocked(mIndex, [currentQueue, &task]() { return currentQueue->pop(task) ? 1u : 0u; })) return true;
+			if (steal(taskShedular.mThreadCount, threadResources, [&](unsigned int victimIndex)
+				{
+					return takeWhileLocked(victimIndex, [&]() { return stealFrom(victimIndex, *currentWorkStealingQueues[victimIndex], task); });
+				}))
+			{
+				return true;
 			}
-			else //if(taskShedular.mCurrentWorkStealingQueues[mIndex] == primaryQueues[1].nextQueue)
+			actions.push_back({ TaskSchedule::endPhase, 0u, 0u });
+			return false;
+		}
+
+		/*
+		Does the next recorded action once every earlier take from the same queue has happened.
+		Goes back to normal scheduling when the recording runs out or the replay stops matching it.
+		*/
+		bool replayFindTask(TaskShedular& taskShedular, TaskSchedule& schedule, WorkStealingQueue<Task>** currentWorkStealingQueues, WorkStealingQueue<Task>* currentQueue,
+			ThreadResources& threadResources, Task& task)
+		{
+			const auto& actions = schedule.actions(mIndex);
+			if (mReplayPosition == actions.size() || schedule.hasDiverged())
+			{
+				return findTaskWithoutSchedule(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task);
+			}
+			const TaskSchedule::Action action = actions[mReplayPosition];
+			++mReplayPosition;
+			if (action.victim == TaskSchedule::endPhase) return false;
+
+			auto& queueState = taskShedular.mReplayQueueStates[(currentWorkStealingQueues - taskShedular.mWorkStealingQueuesArray.get()) + action.victim];
+			auto& victimQueue = *currentWorkStealingQueues[action.victim];
+			//Waits for earlier takes from the queue and for the tasks to be pushed.
+			const auto waitFor = [&schedule](auto&& isReady)
+			{
+				while (!isReady())
+				{
+					if (schedule.hasDiverged()) return false;
+					_mm_pause();
+				}
+				return true;
+			};
+			if (!waitFor([&]() { return queueState.takeCount.load(std::memory_order_acquire) == action.takeIndex; }))
 			{
-				primaryQueues[1].currentQueue->resetIfInvalid();
-				primaryQueues[0].currentQueue->resetIfInvalid();
-				primaryQueues[0].nextQueue->resetIfInvalid();
+				return findTaskWithoutSchedule(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task);
+			}
+			if (action.victim == mIndex)
+			{
+				//Tasks in this thread's own queue were pushed by this thread so they are either there now or never will be.
+				if (!victimQueue.pop(task))
+				{
+					schedule.diverge();
+					return findTaskWithoutSchedule(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task);
+				}
+			}
+			else
+			{
+				if (!waitFor([&]() { return victimQueue.steal(task); }))
+				{
+					return findTaskWithoutSchedule(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task);
+				}
+				increment(mStealAttempts);
+				increment(mSuccessfulSteals);
+				unsigned int stolenTaskCount = 1u;
+				Task extraTask;
+				while (stolenTaskCount != action.count && waitFor([&]() { return victimQueue.steal(extraTask); }))
+				{
+					mCurrentQueue->push(extraTask);
+					++stolenTaskCount;
+				}
+				increment(mStolenTasks, stolenTaskCount);
+				mTrace.record(TaskTraceEventType::steal, Task(), nullptr, action.victim, stolenTaskCount);
+			}
+			queueState.takeCount.store(action.takeIndex + 1u, std::memory_order_release);
+			return true;
+		}
+#endif
 
-				swap(primaryQueues[0].currentQueue, primaryQueues[0].nextQueue);
-				swap(primaryQueues[1].currentQueue, primaryQueues[1].nextQueue);
+		bool findTask(TaskShedular& taskShedular, WorkStealingQueue<Task>** currentWorkStealingQueues, WorkStealingQueue<Task>* currentQueue, ThreadResources& threadResources, Task& task)
+		{
+#if defined(TASK_SHEDULAR_REPLAY)
+			if (taskShedular.mSchedule != nullptr)
+			{
+				if (taskShedular.mSchedule->mode() == TaskSchedule::Mode::record)
+				{
+					return recordFindTask(taskShedular, *taskShedular.mSchedule, currentWorkStealingQueues, currentQueue, threadResources, task);
+				}
+				return replayFindTask(taskShedular, *taskShedular.mSchedule, currentWorkStealingQueues, currentQueue, threadResources, task);
+			}
+#endif
+			return findTaskWithoutSchedule(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task);
+		}
 
-				mCurrentQueue = primaryQueues[1].currentQueue;
+		void findVictims(const TaskShedular& taskShedular)
+		{
+			const unsigned int threadCount = taskShedular.mThreadCount;
+			mVictims.reset(new unsigned int[threadCount]);
+			unsigned int victimCount = 0u;
+			for (unsigned int distance = 0u; distance != CpuTopology::distanceCount; ++distance)
+			{
+				for (unsigned int i = 1u; i != threadCount; ++i)
+				{
+					unsigned int victimIndex = mIndex + i;
+					if (victimIndex >= threadCount) victimIndex -= threadCount;
+					const unsigned int victimDistance = taskShedular.mTopology != nullptr ?
+						static_cast<unsigned int>(taskShedular.mTopology->distance(mIndex, victimIndex)) : CpuTopology::distanceCount - 1u;
+					if (victimDistance == distance)
+					{
+						mVictims[victimCount] = victimIndex;
+						++victimCount;
+					}
+				}
+				mVictimGroupEnds[distance] = victimCount;
+			}
+		}
 
-				prepairForUpdate2(threadResources, context);
+		/*
+		Calls startBarrier with a function that the barrier calls once this thread has its place.
+		When replaying, threads wait for their turn so that they get the same places as when recording.
+		*/
+		template<class StartBarrier>
+		void startInScheduleOrder([[maybe_unused]] TaskShedular& taskShedular, StartBarrier&& startBarrier)
+		{
+#if defined(TASK_SHEDULAR_REPLAY)
+			TaskSchedule* schedule = taskShedular.mSchedule;
+			if (schedule != nullptr)
+			{
+				if (schedule->mode() == TaskSchedule::Mode::replay)
+				{
+					const unsigned int startOrder = schedule->startOrder(mIndex);
+					while (taskShedular.mStartedThreadCount.load(std::memory_order_acquire) != startOrder && !schedule->hasDiverged()) _mm_pause();
+				}
+				startBarrier([&taskShedular, schedule, this]()
+					{
+						const unsigned int startedThreadCount = taskShedular.mStartedThreadCount.load(std::memory_order_relaxed);
+						if (schedule->mode() == TaskSchedule::Mode::record) schedule->startOrder(mIndex) = startedThreadCount;
+						taskShedular.mStartedThreadCount.store(startedThreadCount + 1u, std::memory_order_release);
+					});
+				return;
 			}
+#endif
+			startBarrier([]() {});
 		}
 
 		void start(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
@@ -122,41 +583,37 @@ public:
 			while (true)
 			{
 				Task task;
-				bool found = currentQueue->pop(task);
-				if (found)
+				if (findTask(taskShedular, currentWorkStealingQueues, currentQueue, threadResources, task))
 				{
-					task(threadResources);
+					runTask(task, threadResources);
+					mRanTaskThisFrame = true;
 				}
 				else
 				{
-					for (auto i = mIndex + 1u;; ++i)
-					{
-						if (i == taskShedular.mThreadCount) i = 0u;
-						if (i == mIndex)
-						{
-							const auto nextPhaseTask = taskShedular.mNextPhaseTask;
-							bool shouldQuit = nextPhaseTask(threadResources, context);
-							if (shouldQuit) return;
-							currentWorkStealingQueues = taskShedular.mCurrentWorkStealingQueues;
-							currentQueue = mCurrentQueue;
-							break;
-						}
-						found = currentWorkStealingQueues[i]->pop(task);
-						if (found)
-						{
-							task(threadResources);
-							break;
-						}
-					}
+					const auto nextPhaseTask = taskShedular.mNextPhaseTask;
+					bool shouldQuit = nextPhaseTask(threadResources, context);
+					if (shouldQuit) return;
+					currentWorkStealingQueues = taskShedular.mCurrentWorkStealingQueues;
+					currentQueue = mCurrentQueue;
 				}
 			}
 		}
 	public:
-		ThreadLocal(unsigned int index, TaskShedular& taskShedular)
+		ThreadLocal(unsigned int index, TaskShedular& taskShedular) :
+			mFrameTimers(taskShedular.mFrameNumber.load(std::memory_order_relaxed)),
+			mTimeTimers(taskShedular.millisecondsSinceStart(Clock::now()))
 		{
 			mIndex = index;
 			mCurrentBackgroundQueueIndex = index;
+			findVictims(taskShedular);
+			if (taskShedular.mTopology != nullptr)
+			{
+				taskShedular.mTopology->pinCurrentThread(index);
+			}
 			taskShedular.mBackgroundQueues[index] = &mBackgroundQueue;
+#if defined(TASK_SHEDULAR_TRACING)
+			taskShedular.mTraceBuffers[index] = &mTrace;
+#endif
 			const auto threadCount = taskShedular.mThreadCount;
 			for(auto& queue : primaryQueues)
 			{
@@ -182,21 +639,96 @@ public:
 		template<class F>
 		void stop(TaskShedular& taskShedular, F&& f)
 		{
+			taskShedular.wakeAllParkedThreads();
 			taskShedular.barrier.stop(taskShedular.mThreadCount, std::forward<F>(f));
 		}
 
 		/*
-		Must be called from primary thread
+		Must be called from primary thread.
+		name must be a string literal or outlive the TaskShedular. It is only used when tracing.
 		*/
-		void pushPrimaryTask(std::size_t index, Task task)
+		void pushPrimaryTask(std::size_t index, Task task, const char* name = nullptr)
 		{
 			assert(index < numberOfPrimaryQueues);
+			mTrace.record(TaskTraceEventType::push, task, name, static_cast<unsigned int>(index));
 			primaryQueues[index].nextQueue->push(std::move(task));
 		}
 
-		void pushBackgroundTask(Task item)
+		/*
+		Must be called from primary thread while it is running a primary task.
+		The task will be run in the current phase instead of the next time the phase occurs.
+		*/
+		void pushCurrentPhaseTask(Task task, const char* name = nullptr)
+		{
+			mTrace.record(TaskTraceEventType::push, task, name, static_cast<unsigned int>(currentPhaseIndex()));
+			mCurrentQueue->push(std::move(task));
+		}
+
+		void pushBackgroundTask(Task item, BackgroundPriority priority = BackgroundPriority::normal, const char* name = nullptr)
+		{
+			mTrace.record(TaskTraceEventType::push, item, name, static_cast<unsigned int>(numberOfPrimaryQueues + static_cast<std::size_t>(priority)));
+			mBackgroundQueue.push(std::move(item), priority);
+		}
+
+		/*
+		Must be called from primary thread. The task is pushed with pushPrimaryTask at the start of the frame frameCount frames after this one,
+		so it runs in phase index of that frame. If this thread is running background tasks then, it is pushed when the thread rejoins the primary threads.
+		*/
+		void pushPrimaryTaskAfterFrames(std::size_t index, unsigned long long frameCount, Task task, const char* name = nullptr)
+		{
+			assert(index < numberOfPrimaryQueues && frameCount != 0u);
+			mFrameTimers.push({ task, name, static_cast<unsigned int>(index) }, mFrameTimers.currentTick() + frameCount);
+		}
+
+		/*
+		Must be called from primary thread. The task is pushed at the start of the first frame after delay has passed. Delays are rounded up to milliseconds.
+		*/
+		void pushPrimaryTaskAfter(TaskShedular& taskShedular, std::size_t index, Clock::duration delay, Task task, const char* name = nullptr)
+		{
+			assert(index < numberOfPrimaryQueues);
+			pushDelayedTask(taskShedular, { task, name, static_cast<unsigned int>(index) }, delay);
+		}
+
+		void pushBackgroundTaskAfterFrames(unsigned long long frameCount, Task item, BackgroundPriority priority = BackgroundPriority::normal, const char* name = nullptr)
+		{
+			assert(frameCount != 0u);
+			mFrameTimers.push({ item, name, static_cast<unsigned int>(numberOfPrimaryQueues + static_cast<std::size_t>(priority)) }, mFrameTimers.currentTick() + frameCount);
+		}
+
+		void pushBackgroundTaskAfter(TaskShedular& taskShedular, Clock::duration delay, Task item, BackgroundPriority priority = BackgroundPriority::normal, const char* name = nullptr)
+		{
+			pushDelayedTask(taskShedular, { item, name, static_cast<unsigned int>(numberOfPrimaryQueues + static_cast<std::size_t>(priority)) }, delay);
+		}
+
+		/*
+		Can be called from any thread. The values are only approximate while tasks are being pushed or run.
+		*/
+		typename BackgroundQueue<Task>::Statistics backgroundQueueStatistics(BackgroundPriority priority) const noexcept
+		{
+			return mBackgroundQueue.statistics(priority);
+		}
+
+		/*
+		Must be called from primary thread. Only an estimate as other threads can be stealing from the queue.
+		An empty queue means there is nothing for idle threads to steal from this thread.
+		*/
+		std::ptrdiff_t currentPhaseTaskCount() const noexcept
+		{
+			return mCurrentQueue->size();
+		}
+
+		/*
+		Only an estimate as other threads can be popping from the queue.
+		An empty queue means there is nothing for idle threads to take from this thread.
+		*/
+		bool backgroundQueueEmpty() const noexcept
+		{
+			return mBackgroundQueue.empty();
+		}
+
+		constexpr static std::size_t primaryQueueCount() noexcept
 		{
-			mBackgroundQueue.push(std::move(item));
+			return numberOfPrimaryQueues;
 		}
 
 		/*
@@ -207,6 +739,14 @@ public:
 			return mIndex;
 		}
 
+		/*
+		Can be called from any thread. The values are only approximate while this thread is running.
+		*/
+		StealStatistics stealStatistics() const noexcept
+		{
+			return { mStealAttempts.load(std::memory_order_relaxed), mSuccessfulSteals.load(std::memory_order_relaxed), mStolenTasks.load(std::memory_order_relaxed) };
+		}
+
 		/*
 		An index in the range [0, primaryThreadCount)
 		*/
@@ -215,66 +755,118 @@ public:
 			return barrier.index;
 		}
 		
-		void endUpdate1(TaskShedular& taskShedular, NextPhaseTask nextPhaseTask) noexcept
+		/*
+		Ends a phase that isn't the last phase in the frame.
+		*/
+		template<std::size_t phaseIndex>
+		void endPhase(TaskShedular& taskShedular, NextPhaseTask nextPhaseTask) noexcept
 		{
+			static_assert(phaseIndex < lastPhaseIndex, "The last phase must be ended with endFrameMain, endFramePrimary or endFrameBackground");
+			mTrace.record(TaskTraceEventType::barrierBegin);
 			taskShedular.barrier.sync([&taskShedular, nextPhaseTask]()
 				{
 					taskShedular.mNextPhaseTask = nextPhaseTask;
-					taskShedular.endUpdate<0>();
+					taskShedular.advancePhase<phaseIndex>();
 				});
+			mTrace.record(TaskTraceEventType::barrierEnd);
 
-			primaryQueues[0].currentQueue->reset();
-			swap(primaryQueues[1].currentQueue, primaryQueues[1].nextQueue);
-			mCurrentQueue = primaryQueues[1].currentQueue;
+			startNextPhase<phaseIndex>();
 		}
 
-		void endUpdate2Main(TaskShedular& taskShedular, NextPhaseTask nextPhaseTask)
+		/*
+		Ends the last phase in the frame. Must be called by exactly one thread once all other primary threads can no longer call the next phase task.
+		*/
+		void endFrameMain(TaskShedular& taskShedular, NextPhaseTask nextPhaseTask)
 		{
 			taskShedular.mNextPhaseTask = nextPhaseTask;
-			taskShedular.endUpdate<1>();
-			endUpdate2Primary(taskShedular);
+			taskShedular.advancePhase<lastPhaseIndex>();
+			endFramePrimary(taskShedular);
 		}
 
-		void endUpdate2Primary(TaskShedular& taskShedular)
+		void endFramePrimary(TaskShedular& taskShedular)
 		{
+			mTrace.record(TaskTraceEventType::barrierBegin);
 			taskShedular.barrier.sync([](){});
+			mTrace.record(TaskTraceEventType::barrierEnd);
 
-			primaryQueues[1].currentQueue->reset();
-			swap(primaryQueues[0].currentQueue, primaryQueues[0].nextQueue);
-			mCurrentQueue = primaryQueues[0].currentQueue;
+			startNextPhase<lastPhaseIndex>();
+			releaseDelayedTasks(taskShedular);
 		}
 
-		template<void(*prepairForUpdate2)(ThreadResources& threadResources, void* context)>
-		void endUpdate2Background(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
+		/*
+		Ends the last phase in the frame. If there are background tasks, they are run and the thread rejoins the primary threads
+		in whichever phase is running when they finish. prepairForPhase is called with the index of that phase.
+		*/
+		template<void(*prepairForPhase)(ThreadResources& threadResources, void* context, std::size_t phaseIndex)>
+		void endFrameBackground(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
 		{
+			mIdleFrameCount = mRanTaskThisFrame ? 0u : mIdleFrameCount + 1u;
+			mRanTaskThisFrame = false;
+
 			unsigned int currentQueueIndex = lockAndGetNextBackgroundQueue(mCurrentBackgroundQueueIndex, taskShedular.mThreadCount, taskShedular.mBackgroundQueues.get());
 			mCurrentBackgroundQueueIndex = currentQueueIndex;
-			
+			auto& queue = *taskShedular.mBackgroundQueues[currentQueueIndex];
+
+			//A late frame needs every thread for the next frame so background tasks wait unless they have already waited too long.
+			const Clock::time_point startTime = Clock::now();
+			const bool shouldDefer = mDeferredFrameCount != maxDeferredFrames && taskShedular.isFrameLate(startTime);
+			if (shouldDefer && !queue.empty()) deferBackgroundTasks(taskShedular, startTime);
+			else endDeferral(taskShedular, startTime);
 			Task task;
-			if (taskShedular.mBackgroundQueues[currentQueueIndex]->pop(task))
+			if (!shouldDefer && queue.pop(task))
 			{
+				mTrace.record(TaskTraceEventType::barrierBegin);
 				taskShedular.barrier.syncAndRemoveThread(barrier, [](){});
+				mTrace.record(TaskTraceEventType::barrierEnd);
 
-				primaryQueues[1].currentQueue->reset();
+				primaryQueues[lastPhaseIndex].currentQueue->reset();
 
-				task(threadResources);
+				mTrace.record(TaskTraceEventType::backgroundBegin, Task(), nullptr, currentQueueIndex);
+				runTask(task, threadResources);
 
-				runBackgroundTasks(taskShedular, threadResources, currentQueueIndex);
-				getIntoCorrectStateAfterDoingBackgroundTasks<prepairForUpdate2>(taskShedular, threadResources, context);
+				runBackgroundTasks(taskShedular, threadResources, currentQueueIndex, startTime);
+				getIntoCorrectStateAfterDoingBackgroundTasks<prepairForPhase>(taskShedular, threadResources, context);
 			}
 			else
 			{
-				taskShedular.mBackgroundQueues[currentQueueIndex]->unlock();
-				endUpdate2Primary(taskShedular);
+				queue.unlock();
+				const unsigned int idleFramesBeforeParking = taskShedular.mElasticSettings.idleFramesBeforeParking;
+				if (!shouldDefer && idleFramesBeforeParking != 0u && mIdleFrameCount >= idleFramesBeforeParking)
+				{
+					park<prepairForPhase>(taskShedular, threadResources, context);
+				}
+				else
+				{
+					endFramePrimary(taskShedular);
+				}
 			}
 		}
+
+		/*
+		Leaves the primary threads and sleeps until there is more work than the other threads can keep up with or the TaskShedular is stopping.
+		*/
+		template<void(*prepairForPhase)(ThreadResources& threadResources, void* context, std::size_t phaseIndex)>
+		void park(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
+		{
+			mTrace.record(TaskTraceEventType::barrierBegin);
+			taskShedular.barrier.syncAndRemoveThread(barrier, [](){});
+			mTrace.record(TaskTraceEventType::barrierEnd);
+
+			primaryQueues[lastPhaseIndex].currentQueue->reset();
+			handOverDelayedTasks(taskShedular);
+			taskShedular.waitUntilWoken();
+			mIdleFrameCount = 0u;
+			getIntoCorrectStateAfterDoingBackgroundTasks<prepairForPhase>(taskShedular, threadResources, context);
+		}
 		
 		/*
 		Should be called by a thread that can only do primary tasks.
 		*/
 		void startPrimary(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
 		{
-			taskShedular.barrier.startCannotLeave(barrier);
+			mTrace.record(TaskTraceEventType::barrierBegin);
+			startInScheduleOrder(taskShedular, [&taskShedular, this](auto&& onStarted) { taskShedular.barrier.startCannotLeave(barrier, onStarted); });
+			mTrace.record(TaskTraceEventType::barrierEnd);
 			start(taskShedular, threadResources, context);
 		}
 
@@ -283,7 +875,9 @@ public:
 		*/
 		void startBackground(TaskShedular& taskShedular, ThreadResources& threadResources, void* context)
 		{
-			taskShedular.barrier.startCanLeave(barrier);
+			mTrace.record(TaskTraceEventType::barrierBegin);
+			startInScheduleOrder(taskShedular, [&taskShedular, this](auto&& onStarted) { taskShedular.barrier.startCanLeave(barrier, onStarted); });
+			mTrace.record(TaskTraceEventType::barrierEnd);
 			start(taskShedular, threadResources, context);
 		}
 	};
@@ -291,36 +885,155 @@ private:
 	std::unique_ptr<WorkStealingQueue<Task>*[]> mWorkStealingQueuesArray;
 	WorkStealingQueue<Task>** mCurrentWorkStealingQueues;
 	std::unique_ptr<BackgroundQueue<Task>*[]> mBackgroundQueues;
+#if defined(TASK_SHEDULAR_TRACING)
+	std::unique_ptr<TaskTraceBuffer<Task>*[]> mTraceBuffers;
+#endif
 	unsigned int mThreadCount;
+	const CpuTopology* mTopology;
+#if defined(TASK_SHEDULAR_REPLAY)
+	class ReplayQueueState
+	{
+	public:
+		std::atomic<unsigned int> takeCount = 0u;
+		std::atomic_flag lock = ATOMIC_FLAG_INIT;
+	};
+	std::unique_ptr<ReplayQueueState[]> mReplayQueueStates; //one for each queue in mWorkStealingQueuesArray
+	TaskSchedule* mSchedule = nullptr;
+	std::atomic<unsigned int> mStartedThreadCount = 0u;
+#endif
+	std::atomic<Clock::rep> mFrameBudget = 0; //zero means background tasks are never deferred
+	std::atomic<Clock::rep> mFrameStartTime;
+	const Clock::time_point mCreationTime;
+	std::atomic<unsigned long long> mFrameNumber = 0u;
+	std::atomic<Clock::rep> mBackgroundRunTime = 0;
+	std::atomic<Clock::rep> mDeferredTime = 0;
+	std::atomic<unsigned int> mDeferredCount = 0u;
+	BackgroundStatistics mLastFrameBackgroundStatistics = {};
+	ElasticSettings mElasticSettings = { 0u, 0u };
+	std::atomic<unsigned int> mParkedThreadCount = 0u;
+	unsigned int mWakeCount = 0u; //number of parked threads that have been told to wake but haven't yet
+	bool mIsStopping = false;
+	std::mutex mParkMutex;
+	std::condition_variable mParkCondition;
+	ResizingArray<HandedOverTask> mHandedOverTasks; //guarded by mParkMutex
+	std::atomic<bool> mHasHandedOverTasks = false;
 	NextPhaseTask mNextPhaseTask;
 	ThreadBarrier barrier;
 	std::array<PrimaryTaskFromOtherThreadQueue, numberOfPrimaryQueues> primaryFromOtherThreadQueues;
 
-	template<unsigned int phaseIndex>
-	void endUpdate() noexcept
+	std::uint64_t millisecondsSinceStart(Clock::time_point time) const noexcept
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - mCreationTime).count());
+	}
+
+	void waitUntilWoken()
+	{
+		std::unique_lock<std::mutex> lock(mParkMutex);
+		mParkedThreadCount.fetch_add(1u, std::memory_order_relaxed);
+		while (mWakeCount == 0u && !mIsStopping) mParkCondition.wait(lock);
+		if (mWakeCount != 0u) --mWakeCount;
+		mParkedThreadCount.fetch_sub(1u, std::memory_order_relaxed);
+	}
+
+	void wakeParkedThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mParkMutex);
+			if (mWakeCount >= mParkedThreadCount.load(std::memory_order_relaxed)) return;
+			++mWakeCount;
+		}
+		mParkCondition.notify_one();
+	}
+
+	void wakeAllParkedThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mParkMutex);
+			mIsStopping = true;
+		}
+		mParkCondition.notify_all();
+	}
+
+	/*
+	A parked thread is woken when the frame that just ended was over budget or had background tasks left over,
+	or when a lot of tasks are waiting for the phase that is starting. Called once per phase with the new row of queues current.
+	*/
+	template<std::size_t phaseIndex>
+	bool shouldWakeParkedThread(bool isFrameOverBudget) const noexcept
+	{
+		if (isFrameOverBudget) return true;
+		if constexpr (phaseIndex == lastPhaseIndex)
+		{
+			for (unsigned int i = 0u; i != mThreadCount; ++i)
+			{
+				if (mBackgroundQueues[i] != nullptr && !mBackgroundQueues[i]->empty()) return true;
+			}
+		}
+		std::size_t queuedTaskCount = 0u;
+		for (unsigned int i = 0u; i != mThreadCount; ++i)
+		{
+			if (mCurrentWorkStealingQueues[i] != nullptr) queuedTaskCount += static_cast<std::size_t>(mCurrentWorkStealingQueues[i]->size());
+		}
+		return queuedTaskCount > mElasticSettings.wakeQueueDepth;
+	}
+
+	template<std::size_t phaseIndex>
+	void advancePhase() noexcept
 	{
 		static_assert(phaseIndex < numberOfPrimaryQueues);
+#if defined(TASK_SHEDULAR_REPLAY)
+		//Every thread has finished with the phase's queues so they are numbered from zero next time.
+		auto queueStates = mReplayQueueStates.get() + (mCurrentWorkStealingQueues - mWorkStealingQueuesArray.get());
+		for (unsigned int i = 0u; i != mThreadCount; ++i)
+		{
+			queueStates[i].takeCount.store(0u, std::memory_order_relaxed);
+		}
+#endif
 		mCurrentWorkStealingQueues += mThreadCount;
-		if constexpr (phaseIndex == (numberOfPrimaryQueues - 1u))
+		bool isFrameOverBudget = false;
+		if constexpr (phaseIndex == lastPhaseIndex)
 		{
-			if (mCurrentWorkStealingQueues == (mWorkStealingQueuesArray.get() + mThreadCount * 4u))
+			isFrameOverBudget = isFrameLate(Clock::now());
+			mFrameStartTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+			mFrameNumber.store(mFrameNumber.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+			mLastFrameBackgroundStatistics = { Clock::duration(mBackgroundRunTime.exchange(0, std::memory_order_relaxed)),
+				Clock::duration(mDeferredTime.exchange(0, std::memory_order_relaxed)), mDeferredCount.exchange(0u, std::memory_order_relaxed) };
+			if (mCurrentWorkStealingQueues == (mWorkStealingQueuesArray.get() + mThreadCount * 2u * numberOfPrimaryQueues))
 			{
 				mCurrentWorkStealingQueues = mWorkStealingQueuesArray.get();
 			}
 		}
+		if (mParkedThreadCount.load(std::memory_order_relaxed) != 0u && shouldWakeParkedThread<phaseIndex>(isFrameOverBudget))
+		{
+			wakeParkedThread();
+		}
 	}
 public:
-	TaskShedular(unsigned int numberOfThreads, NextPhaseTask nextPhaseTask) :
+	/*
+	If topology isn't null, each ThreadLocal pins the thread that constructs it to topology.processor(index) and steals from the nearest threads first.
+	Threads with close indices are close in hardware so the queues of nearby threads are next to each other in each phase's row of queues.
+	topology must outlive the TaskShedular.
+	*/
+	TaskShedular(unsigned int numberOfThreads, NextPhaseTask nextPhaseTask, const CpuTopology* topology = nullptr) :
 		primaryFromOtherThreadQueues{ makeArray<numberOfPrimaryQueues>([](std::size_t i)
 			{
 				return PrimaryTaskFromOtherThreadQueue(i);
 			}) },
 		mNextPhaseTask(nextPhaseTask),
 		barrier(numberOfThreads),
-		mWorkStealingQueuesArray(new WorkStealingQueue<Task>*[numberOfThreads * 2u * numberOfPrimaryQueues]),
-		mBackgroundQueues(new BackgroundQueue<Task>*[numberOfThreads]),
+		mWorkStealingQueuesArray(new WorkStealingQueue<Task>*[numberOfThreads * 2u * numberOfPrimaryQueues]()),
+		mBackgroundQueues(new BackgroundQueue<Task>*[numberOfThreads]()),
+#if defined(TASK_SHEDULAR_TRACING)
+		mTraceBuffers(new TaskTraceBuffer<Task>*[numberOfThreads]),
+#endif
+#if defined(TASK_SHEDULAR_REPLAY)
+		mReplayQueueStates(new ReplayQueueState[numberOfThreads * 2u * numberOfPrimaryQueues]),
+#endif
 		mCurrentWorkStealingQueues(mWorkStealingQueuesArray.get()),
-		mThreadCount(numberOfThreads)
+		mThreadCount(numberOfThreads),
+		mTopology(topology),
+		mFrameStartTime(Clock::now().time_since_epoch().count()),
+		mCreationTime(Clock::now())
 {}
 
 	unsigned int threadCount() const noexcept
@@ -328,6 +1041,72 @@ public:
 		return mThreadCount;
 	}
 
+#if defined(TASK_SHEDULAR_TRACING)
+	/*
+	Writes what every thread has recorded as Chrome trace event JSON that can be opened in chrome://tracing or Perfetto.
+	Can only be called while no threads are running tasks, for example after stop has finished.
+	*/
+	void writeChromeTrace(std::ostream& stream) const
+	{
+		::writeChromeTrace(stream, mTraceBuffers.get(), mThreadCount);
+	}
+#endif
+
+#if defined(TASK_SHEDULAR_REPLAY)
+	/*
+	Records the order tasks are taken in into schedule or replays it depending on the schedule's mode. Pass nullptr to stop.
+	Can only be called before any threads have started or while no threads are running tasks. schedule must outlive its use.
+	*/
+	void setSchedule(TaskSchedule* schedule) noexcept
+	{
+		assert(schedule == nullptr || schedule->threadCount() == mThreadCount);
+		mSchedule = schedule;
+	}
+#endif
+
+	/*
+	Background tasks are put off while the current frame has taken longer than budget so that late frames get every thread.
+	Threads stop running background tasks when the frame they would rejoin goes over budget. A budget of zero turns this off.
+	Can be called from any thread.
+	*/
+	void setFrameBudget(Clock::duration budget) noexcept
+	{
+		mFrameBudget.store(budget.count(), std::memory_order_relaxed);
+	}
+
+	bool isFrameLate(Clock::time_point now) const noexcept
+	{
+		const Clock::rep budget = mFrameBudget.load(std::memory_order_relaxed);
+		return budget != 0 && (now.time_since_epoch().count() - mFrameStartTime.load(std::memory_order_relaxed)) > budget;
+	}
+
+	/*
+	Lets threads started with startBackground park when they haven't run a primary task for settings.idleFramesBeforeParking frames in a row.
+	One parked thread is woken at the start of each phase where the last frame was over budget or more than settings.wakeQueueDepth tasks are queued.
+	A thread gives its delayed tasks to the primary threads when it parks. Can only be called before any threads have started.
+	*/
+	void setElasticSettings(const ElasticSettings& settings) noexcept
+	{
+		mElasticSettings = settings;
+	}
+
+	/*
+	Can be called from any thread. Only approximate while threads are parking or waking.
+	*/
+	unsigned int parkedThreadCount() const noexcept
+	{
+		return mParkedThreadCount.load(std::memory_order_relaxed);
+	}
+
+	/*
+	Background work done and deferred during the last frame.
+	Must be called by the thread that calls endFrameMain.
+	*/
+	const BackgroundStatistics& lastFrameBackgroundStatistics() const noexcept
+	{
+		return mLastFrameBackgroundStatistics;
+	}
+
 	unsigned int lockAndGetPrimaryThreadCount() noexcept
 	{
 		return barrier.lockAndGetThreadCount();
@@ -365,7 +1144,7 @@ public:
 
 	class StopRequest
 	{
-		friend class TaskShedular<ThreadResources>;
+		friend class TaskShedular;
 		using Self = StopRequest;
 
 		class PrimaryFromOtherStopRequest : public PrimaryTaskFromOtherThreadQueue::StopRequest
@@ -379,15 +1158,15 @@ public:
 				stopRequest(stopRequest1) {}
 		};
 
-		constexpr static std::size_t numberOfComponents = numberOfPrimaryQueues;
-		std::atomic<std::size_t> numberOfComponentsStopped = 0u;
+		constexpr static unsigned int numberOfComponents = static_cast<unsigned int>(numberOfPrimaryQueues);
+		TaskCounter componentsStopped;
 		std::array<PrimaryFromOtherStopRequest, numberOfPrimaryQueues> primaryFromOtherStopRequests;
 		void(*callback)(StopRequest& stopRequest, void* tr);
 
 		static void componentStopped(PrimaryTaskFromOtherThreadQueue::StopRequest& request, void* tr)
 		{
 			auto& stopRequest = *static_cast<PrimaryFromOtherStopRequest&>(request).stopRequest;
-			if(stopRequest.numberOfComponentsStopped.fetch_add(1u, std::memory_order_acq_rel) == (numberOfComponents - 1u))
+			if(stopRequest.componentsStopped.finished(numberOfComponents))
 			{
 				stopRequest.callback(stopRequest, tr);
 			}
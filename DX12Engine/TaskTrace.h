@@ -0,0 +1,217 @@
+#pragma once
+#include <cstddef>
+#if defined(TASK_SHEDULAR_TRACING)
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#endif
+
+/*
+Records what a TaskShedular thread is doing so that a frame can be viewed in chrome://tracing or Perfetto.
+Tracing is only compiled in when TASK_SHEDULAR_TRACING is defined. Otherwise every function does nothing and TaskTraceBuffer is empty.
+*/
+enum class TaskTraceEventType : unsigned char
+{
+	taskBegin,
+	taskEnd,
+	push, //arg0 is the queue, 0 to phaseCount - 1 for primary queues and phaseCount + priority for background queues
+	steal, //arg0 is the victim thread, arg1 is the number of tasks stolen
+	barrierBegin,
+	barrierEnd,
+	phaseStart, //arg0 is the phase index
+	backgroundBegin, //arg0 is the index of the thread whose background queue is being run
+	backgroundEnd,
+};
+
+#if defined(TASK_SHEDULAR_TRACING)
+/*
+A ring buffer of events that only the owning thread writes to. Old events are overwritten when it is full.
+*/
+template<class Task>
+class TaskTraceBuffer
+{
+public:
+	constexpr static std::size_t capacity = 65536u; //must be a power of two
+
+	class Event
+	{
+	public:
+		Task task;
+		const char* name;
+		long long time; //nanoseconds
+		unsigned int arg0;
+		unsigned int arg1;
+		TaskTraceEventType type;
+	};
+private:
+	std::unique_ptr<Event[]> mEvents;
+	std::atomic<std::size_t> mCount;
+
+	static long long now() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+public:
+	TaskTraceBuffer() : mEvents(new Event[capacity]), mCount(0u) {}
+
+	void record(TaskTraceEventType type, Task task = Task(), const char* name = nullptr, unsigned int arg0 = 0u, unsigned int arg1 = 0u) noexcept
+	{
+		const std::size_t count = mCount.load(std::memory_order_relaxed);
+		Event& event = mEvents[count & (capacity - 1u)];
+		event.task = task;
+		event.name = name;
+		event.time = now();
+		event.arg0 = arg0;
+		event.arg1 = arg1;
+		event.type = type;
+		mCount.store(count + 1u, std::memory_order_release);
+	}
+
+	/*
+	Calls f with every event that is still in the buffer from oldest to newest. The owning thread must not be recording.
+	*/
+	template<class F>
+	void forEachEvent(F&& f) const
+	{
+		const std::size_t count = mCount.load(std::memory_order_acquire);
+		const std::size_t begin = count > capacity ? count - capacity : 0u;
+		for (std::size_t i = begin; i != count; ++i)
+		{
+			f(mEvents[i & (capacity - 1u)]);
+		}
+	}
+
+	void clear() noexcept
+	{
+		mCount.store(0u, std::memory_order_relaxed);
+	}
+};
+
+/*
+Writes the events from every thread as Chrome trace event JSON. None of the threads can be recording.
+Tasks are named with the name they were last pushed with.
+*/
+template<class Task>
+void writeChromeTrace(std::ostream& stream, TaskTraceBuffer<Task>* const* buffers, unsigned int threadCount)
+{
+	using Event = typename TaskTraceBuffer<Task>::Event;
+	std::unordered_map<Task, const char*, typename Task::Hash> taskNames;
+	long long startTime = 0;
+	bool foundFirstEvent = false;
+	for (unsigned int i = 0u; i != threadCount; ++i)
+	{
+		buffers[i]->forEachEvent([&](const Event& event)
+			{
+				if (!foundFirstEvent || event.time < startTime)
+				{
+					startTime = event.time;
+					foundFirstEvent = true;
+				}
+				if (event.type == TaskTraceEventType::push && event.name != nullptr)
+				{
+					taskNames[event.task] = event.name;
+				}
+			});
+	}
+
+	const auto writeString = [&stream](const char* string)
+	{
+		stream << '"';
+		for (; *string != '\0'; ++string)
+		{
+			if (*string == '"' || *string == '\\') stream << '\\';
+			stream << *string;
+		}
+		stream << '"';
+	};
+
+	stream << "{\"traceEvents\":[";
+	bool isFirstEvent = true;
+	for (unsigned int i = 0u; i != threadCount; ++i)
+	{
+		if (!isFirstEvent) stream << ',';
+		isFirstEvent = false;
+		stream << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":\"thread " << i << "\"}}";
+
+		unsigned int depth = 0u; //the oldest events might have been overwritten so ends without a begin are skipped
+		buffers[i]->forEachEvent([&](const Event& event)
+			{
+				const char* name;
+				char phase;
+				switch (event.type)
+				{
+				case TaskTraceEventType::taskBegin:
+				{
+					auto taskName = taskNames.find(event.task);
+					name = taskName != taskNames.end() ? taskName->second : "task";
+					phase = 'B';
+					break;
+				}
+				case TaskTraceEventType::barrierBegin:
+					name = "barrier";
+					phase = 'B';
+					break;
+				case TaskTraceEventType::backgroundBegin:
+					name = "background tasks";
+					phase = 'B';
+					break;
+				case TaskTraceEventType::taskEnd:
+				case TaskTraceEventType::barrierEnd:
+				case TaskTraceEventType::backgroundEnd:
+					if (depth == 0u) return;
+					name = "";
+					phase = 'E';
+					break;
+				case TaskTraceEventType::push:
+					name = event.name != nullptr ? event.name : "push";
+					phase = 'i';
+					break;
+				case TaskTraceEventType::steal:
+					name = "steal";
+					phase = 'i';
+					break;
+				default: //TaskTraceEventType::phaseStart
+					name = "phase start";
+					phase = 'i';
+					break;
+				}
+				if (phase == 'B') ++depth;
+				else if (phase == 'E') --depth;
+
+				stream << ",\n{\"name\":";
+				writeString(name);
+				stream << ",\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":" << i << ",\"ts\":" << static_cast<double>(event.time - startTime) / 1000.0;
+				switch (event.type)
+				{
+				case TaskTraceEventType::push:
+					stream << ",\"cat\":\"push\",\"s\":\"t\",\"args\":{\"queue\":" << event.arg0 << '}';
+					break;
+				case TaskTraceEventType::steal:
+					stream << ",\"cat\":\"steal\",\"s\":\"t\",\"args\":{\"victim\":" << event.arg0 << ",\"tasks\":" << event.arg1 << '}';
+					break;
+				case TaskTraceEventType::phaseStart:
+					stream << ",\"cat\":\"phase\",\"s\":\"p\",\"args\":{\"phase\":" << event.arg0 << '}';
+					break;
+				case TaskTraceEventType::backgroundBegin:
+					stream << ",\"cat\":\"background\",\"args\":{\"queue\":" << event.arg0 << '}';
+					break;
+				default:
+					break;
+				}
+				stream << '}';
+			});
+	}
+	stream << "\n]}\n";
+}
+#else
+template<class Task>
+class TaskTraceBuffer
+{
+public:
+	void record(TaskTraceEventType, Task = Task(), const char* = nullptr, unsigned int = 0u, unsigned int = 0u) noexcept {}
+
+	void clear() noexcept {}
+};
+#endif
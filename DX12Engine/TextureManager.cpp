@@ -12,14 +12,16 @@ TextureManager::TextureManager(AsynchronousFileManager& asynchronousFileManager1
 
 void TextureManager::unloadTexture(UnloadRequest& unloadRequest, void* tr)
 {
-	auto texurePtr = textures.find({ unloadRequest.start, unloadRequest.end });
-	auto& texture = texurePtr->second;
-	texture.numUsers -= 1u;
-	if(texture.numUsers == 0u)
+	textures.visitAndMaybeErase({ unloadRequest.start, unloadRequest.end }, [&](Texture& texture)
 	{
-		graphicsEngine.descriptorAllocator.deallocate(texture.descriptorIndex);
-		textures.erase(texurePtr);
-	}
+		texture.numUsers -= 1u;
+		if(texture.numUsers == 0u)
+		{
+			graphicsEngine.descriptorAllocator.deallocate(texture.descriptorIndex);
+			return true;
+		}
+		return false;
+	});
 	unloadRequest.deleteReadRequest(unloadRequest, tr);
 }
 
@@ -106,13 +108,11 @@ ID3D12Resource* TextureManager::createTexture(const TextureStreamingRequest& upl
 	return resource.steal();
 }
 
-void TextureManager::loadTextureFromMemory(const unsigned char* buffer, TextureStreamingRequest& uploadRequest,
-	void(*streamResource)(StreamingManager::StreamingRequest* request, void* tr))
+unsigned long TextureManager::loadTextureFromMemory(const unsigned char* buffer, TextureStreamingRequest& uploadRequest)
 {
 	const DDSFileLoader::DdsHeaderDx12& header = *reinterpret_cast<const DDSFileLoader::DdsHeaderDx12*>(buffer);
 	bool valid = DDSFileLoader::validateDdsHeader(header);
 	if(!valid) throw false;
-	uploadRequest.streamResource = streamResource;
 	uploadRequest.width = header.width;
 	uploadRequest.height = header.height;
 	uploadRequest.format = header.dxgiFormat;
@@ -127,17 +127,20 @@ void TextureManager::loadTextureFromMemory(const unsigned char* buffer, TextureS
 		uploadRequest.arraySize = (uint16_t)header.arraySize;
 	}
 	uploadRequest.depth = (uint16_t)header.depth;
-	uploadRequest.resourceSize = (unsigned long)DDSFileLoader::alignedResourceSize(uploadRequest.width, uploadRequest.height, uploadRequest.depth,
+	return (unsigned long)DDSFileLoader::alignedResourceSize(uploadRequest.width, uploadRequest.height, uploadRequest.depth,
 		uploadRequest.mipLevels, uploadRequest.arraySize, uploadRequest.format);
 }
 
 void TextureManager::notifyTextureReady(TextureStreamingRequest* request, void* tr)
 {
-	auto& texture = textures[request->resourceLocation];
-	texture.lastRequest = nullptr;
-	texture.resource.set() = request->resource;
 	const unsigned int discriptorIndex = request->discriptorIndex;
-	texture.descriptorIndex = discriptorIndex;
+	textures.visit(request->resourceLocation, [&](Texture& texture)
+	{
+		texture.lastRequest = nullptr;
+		texture.resource.set() = request->resource;
+		texture.descriptorIndex = discriptorIndex;
+	});
+	//no more requests can be added after lastRequest is cleared
 	do
 	{
 		auto old = request;
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "D3D12Resource.h"
-#include <unordered_map>
 #include <atomic>
 #include "StreamingManager.h"
 #include "DDSFileLoader.h"
@@ -9,6 +8,9 @@
 #include "IOCompletionQueue.h"
 #include "ActorQueue.h"
 #include "ResourceLocation.h"
+#include "ConcurrentHashMap.h"
+#include "Coroutine.h"
+#include "PoolAllocated.h"
 class GraphicsEngine;
 
 class TextureManager
@@ -34,7 +36,7 @@ public:
 		}
 	};
 
-	class TextureStreamingRequest : public StreamingManager::StreamingRequest, public Message
+	class TextureStreamingRequest : public Message, public PoolAllocated
 	{
 	public:
 		ResourceLocation resourceLocation;
@@ -82,7 +84,10 @@ private:
 	};
 
 	ActorQueue messageQueue;
-	std::unordered_map<ResourceLocation, Texture, Hash> textures;
+	/*
+	Changed by the actor and by load and unload when the texture is already loaded, so that those don't wait for the actor.
+	*/
+	ConcurrentHashMap<ResourceLocation, Texture, Hash> textures;
 	AsynchronousFileManager& asynchronousFileManager;
 	StreamingManager& streamingManager;
 	GraphicsEngine& graphicsEngine;
@@ -91,110 +96,81 @@ private:
 
 	void notifyTextureReady(TextureStreamingRequest* request, void* tr);
 
-	template<class ThreadResources>
-	static void copyFinished(void* requester, void* tr)
-	{
-		TextureStreamingRequest& request = *static_cast<TextureStreamingRequest*>(requester);
-		ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
+	/*
+	Returns the size the texture needs in the upload buffer.
+	*/
+	static unsigned long loadTextureFromMemory(const unsigned char* buffer, TextureStreamingRequest& uploadRequest);
 
-		request.deleteStreamingRequest = [](StreamingManager::StreamingRequest* request1, void* tr)
-		{
-			auto& threadResources = *static_cast<ThreadResources*>(tr);
-			TextureStreamingRequest& request = *static_cast<TextureStreamingRequest*>(request1);
-			TextureManager& textureManager = *request.textureManager;
-			
-			request.textureAction = Action::notifyReady;
-			textureManager.addMessage(request, threadResources);
-		};
-		StreamingManager& streamingManager = request.textureManager->streamingManager;
-		streamingManager.uploadFinished(&request, threadResources);
-	}
-	
 	template<class ThreadResources>
-	static void textureStreamResource(StreamingManager::StreamingRequest* request, void* tr)
+	static Coroutine streamTexture([[maybe_unused]] ThreadResources& threadResources, TextureStreamingRequest& request)
 	{
-		ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
-		threadResources.taskShedular.pushBackgroundTask({request, [](void* requester, ThreadResources&)
-		{
-			TextureStreamingRequest& uploadRequest = *static_cast<TextureStreamingRequest*>(requester);
-			std::size_t resourceSize = DDSFileLoader::resourceSize(uploadRequest.width, uploadRequest.height, uploadRequest.depth, uploadRequest.mipLevels, uploadRequest.arraySize, uploadRequest.format);
-			constexpr std::size_t fileOffset = sizeof(DDSFileLoader::DdsHeaderDx12);
+		TextureManager& textureManager = *request.textureManager;
+		AsynchronousFileManager& asynchronousFileManager = textureManager.asynchronousFileManager;
+		constexpr std::size_t fileOffset = sizeof(DDSFileLoader::DdsHeaderDx12);
+		const unsigned long long dataStart = request.resourceLocation.start + fileOffset;
 
-			uploadRequest.start = uploadRequest.resourceLocation.start + fileOffset;
-			uploadRequest.end = uploadRequest.start + resourceSize;
-			uploadRequest.fileLoadedCallback = [](AsynchronousFileManager::ReadRequest& request, AsynchronousFileManager& asynchronousFileManager, void* tr, const unsigned char* buffer)
-			{
-				TextureStreamingRequest& uploadRequest = static_cast<TextureStreamingRequest&>(request);
-				ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
-				StreamingManager::ThreadLocal& streamingManager = threadResources.streamingManager;
-				uploadRequest.resource = createTexture(uploadRequest, uploadRequest.textureManager->graphicsEngine, uploadRequest.discriptorIndex);
-
-				DDSFileLoader::copyResourceToGpu(uploadRequest.resource, uploadRequest.uploadResource, uploadRequest.uploadResourceOffset, uploadRequest.width, uploadRequest.height,
-					uploadRequest.depth, uploadRequest.mipLevels, uploadRequest.arraySize, uploadRequest.format, uploadRequest.uploadBufferCurrentCpuAddress, buffer, &streamingManager.copyCommandList());
+		Coroutine::ReadRequest<ThreadResources> headerRequest(request.resourceLocation.start, dataStart);
+		co_await headerRequest.read(asynchronousFileManager);
+		Coroutine::StreamingRequest<ThreadResources> uploadRequest(loadTextureFromMemory(headerRequest.data(), request));
+		co_await headerRequest.discard(asynchronousFileManager);
 
-				uploadRequest.deleteReadRequest = [](AsynchronousFileManager::ReadRequest& request1, void* tr)
-				{
-					TextureStreamingRequest& uploadRequest = static_cast<TextureStreamingRequest&>(request1);
-					ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
-					StreamingManager::ThreadLocal& streamingManager = threadResources.streamingManager;
+		co_await uploadRequest.allocateUploadSpace(textureManager.streamingManager);
 
-					streamingManager.addCopyCompletionEvent(&uploadRequest, copyFinished<ThreadResources>);
-				};
-				asynchronousFileManager.discard(uploadRequest);
-			};
-			uploadRequest.textureManager->asynchronousFileManager.read(uploadRequest);
-		} });
-	}
+		const std::size_t resourceSize = DDSFileLoader::resourceSize(request.width, request.height, request.depth, request.mipLevels, request.arraySize, request.format);
+		Coroutine::ReadRequest<ThreadResources> dataRequest(dataStart, dataStart + resourceSize);
+		ThreadResources& copyingThreadResources = co_await dataRequest.read(asynchronousFileManager);
+		request.resource = createTexture(request, textureManager.graphicsEngine, request.discriptorIndex);
+		DDSFileLoader::copyResourceToGpu(request.resource, uploadRequest.uploadResource, uploadRequest.uploadResourceOffset, request.width, request.height,
+			request.depth, request.mipLevels, request.arraySize, request.format, uploadRequest.uploadBufferCurrentCpuAddress, dataRequest.data(),
+			&copyingThreadResources.streamingManager.copyCommandList());
 
-	static void loadTextureFromMemory(const unsigned char* buffer, TextureStreamingRequest& uploadRequest,
-		void(*streamResource)(StreamingManager::StreamingRequest* request, void* tr));
+		//The copy has to be waited for on the thread that recorded it, so this is done before the file data is discarded.
+		co_await uploadRequest.copyFinished();
+		co_await dataRequest.discard(asynchronousFileManager);
+		ThreadResources& threadResources1 = co_await uploadRequest.freeUploadSpace(textureManager.streamingManager);
 
-	template<class ThreadResources>
-	void loadTextureUncached(TextureStreamingRequest* request)
-	{
-		request->textureManager = this;
-		request->start = request->resourceLocation.start;
-		request->end = request->start + sizeof(DDSFileLoader::DdsHeaderDx12);
-		request->fileLoadedCallback = [](AsynchronousFileManager::ReadRequest& request, AsynchronousFileManager& asynchronousFileManager, void*, const unsigned char* buffer)
-		{
-			TextureStreamingRequest& uploadRequest = static_cast<TextureStreamingRequest&>(request);
-			loadTextureFromMemory(buffer, uploadRequest, textureStreamResource<ThreadResources>);
-			asynchronousFileManager.discard(request);
-		};
-		request->deleteReadRequest = [](AsynchronousFileManager::ReadRequest& request1, void* tr)
-		{
-			ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
-			auto& request = static_cast<TextureStreamingRequest&>(request1);
-			StreamingManager& streamingManager = request.textureManager->streamingManager;
-			streamingManager.addUploadRequest(&request, threadResources);
-		};
-		asynchronousFileManager.read(*request);
+		request.textureAction = Action::notifyReady;
+		textureManager.addMessage(request, threadResources1);
 	}
 
 	template<class ThreadResources>
 	void loadTexture(ThreadResources& threadResources, TextureStreamingRequest* request)
 	{
-		Texture& texture = textures[request->resourceLocation];
-		texture.numUsers += 1u;
-		if(texture.numUsers == 1u)
+		bool needsLoading = false;
+		bool isLoaded = false;
+		unsigned int descriptorIndex;
+		textures.visitOrInsert(request->resourceLocation, [&](Texture& texture)
 		{
+			texture.numUsers += 1u;
+			if(texture.numUsers == 1u)
+			{
+				texture.lastRequest = request;
+				request->nextTextureRequest = nullptr;
+				needsLoading = true;
+				return;
+			}
+			//the resource is loaded or loading
+			if(texture.lastRequest == nullptr)
+			{
+				//The resource is loaded
+				descriptorIndex = texture.descriptorIndex;
+				isLoaded = true;
+				return;
+			}
+			//the resourse is loading
+			texture.lastRequest->nextTextureRequest = request;
 			texture.lastRequest = request;
 			request->nextTextureRequest = nullptr;
-
-			loadTextureUncached<ThreadResources>(request);
-			return;
+		});
+		if(needsLoading)
+		{
+			request->textureManager = this;
+			streamTexture(threadResources, *request);
 		}
-		//the resource is loaded or loading
-		if(texture.lastRequest == nullptr)
+		else if(isLoaded)
 		{
-			//The resource is loaded
-			request->textureLoaded(*request, &threadResources, texture.descriptorIndex);
-			return;
+			request->textureLoaded(*request, &threadResources, descriptorIndex);
 		}
-		//the resourse is loading
-		texture.lastRequest->nextTextureRequest = request;
-		texture.lastRequest = request;
-		request->nextTextureRequest = nullptr;
 	}
 
 	/*the texture must no longer be in use, including by the GPU*/
@@ -243,9 +219,28 @@ public:
 	TextureManager(AsynchronousFileManager& asynchronousFileManager, StreamingManager& streamingManager, GraphicsEngine& graphicsEngine);
 	~TextureManager() = default;
 
+	/*
+	If the texture is already loaded request.textureLoaded is called before this returns.
+	*/
 	template<class ThreadResources>
 	void load(TextureStreamingRequest& request, ThreadResources& threadResources)
 	{
+		bool isLoaded = false;
+		unsigned int descriptorIndex;
+		textures.visit(request.resourceLocation, [&](Texture& texture)
+		{
+			if(texture.lastRequest == nullptr)
+			{
+				texture.numUsers += 1u;
+				descriptorIndex = texture.descriptorIndex;
+				isLoaded = true;
+			}
+		});
+		if(isLoaded)
+		{
+			request.textureLoaded(request, &threadResources, descriptorIndex);
+			return;
+		}
 		request.textureAction = Action::load;
 		addMessage(request, threadResources);
 	}
@@ -253,6 +248,21 @@ public:
 	template<class ThreadResources>
 	void unload(UnloadRequest& request, ThreadResources& threadResources)
 	{
+		//only the last user needs the actor to free the texture
+		bool isUnloaded = false;
+		textures.visit({ request.start, request.end }, [&](Texture& texture)
+		{
+			if(texture.numUsers > 1u)
+			{
+				texture.numUsers -= 1u;
+				isUnloaded = true;
+			}
+		});
+		if(isUnloaded)
+		{
+			request.deleteReadRequest(request, &threadResources);
+			return;
+		}
 		request.textureAction = Action::unload;
 		addMessage(request, threadResources);
 	}
@@ -1,8 +1,25 @@
 #pragma once
 #include <mutex>
-#include <condition_variable>
 #include <atomic>
+#include <thread>
+#include <immintrin.h> //_mm_pause
+#if defined(_WIN32)
+#include <windows.h>
+#undef min
+#undef max
+#pragma comment(lib, "Synchronization.lib") //WaitOnAddress and WakeByAddressAll
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#endif
 
+/*
+A barrier that primary threads can join and leave.
+Threads arrive with a single atomic add. Only the last thread to arrive takes the mutex, every other thread spins on the generation for a while
+and then sleeps until it changes. The mutex is also used by threads that are starting, joining or leaving.
+*/
 class ThreadBarrier
 {
 	struct DoublyLinked
@@ -21,22 +38,95 @@ public:
 		ThreadLocal() {}
 	};
 private:
+	constexpr static unsigned long long threadCountLockedBit = 0x8000000000000000u;
+	constexpr static unsigned int maxSpinCount = 1024u; //number of times the generation is checked before sleeping
+
 	std::mutex mutex;
-	std::condition_variable conditionVariable;
-	unsigned int generation = 0u;
-	unsigned int waitingCount = 0u;
-	std::atomic<unsigned long> threadCount;
+	unsigned int spinCount; //zero if there is only one hardware thread as spinning would stop the last thread from arriving
+	std::atomic<unsigned int> generation = 0u;
+	std::atomic<unsigned int> sleepingCount = 0u;
+	/*
+	The high 32 bits are the number of threads with the top bit set when the thread count is locked.
+	The low 32 bits are the number of threads waiting so a thread can tell if it is the last to arrive with one atomic operation.
+	*/
+	std::atomic<unsigned long long> state;
 	long increaseInThreads = 0u;
+	unsigned int stoppedCount = 0u; //number of threads that have called stop
+	bool isStopped = false;
 	ThreadLocal* threadsToRemove = nullptr;
 	DoublyLinked threadLocals{ &threadLocals, &threadLocals }; //previous is end of list, next is start of list.
 
+	static unsigned int getWaitingCount(unsigned long long state) noexcept
+	{
+		return static_cast<unsigned int>(state & 0xffffffffu);
+	}
+
+	static unsigned int getThreadCount(unsigned long long state) noexcept
+	{
+		return static_cast<unsigned int>((state >> 32u) & 0x7fffffffu);
+	}
+
+	static void waitOnAddress(std::atomic<unsigned int>& address, unsigned int oldValue) noexcept
+	{
+#if defined(_WIN32)
+		WaitOnAddress(&address, &oldValue, sizeof(oldValue), INFINITE);
+#elif defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<unsigned int*>(&address), FUTEX_WAIT_PRIVATE, oldValue, nullptr, nullptr, 0);
+#else
+		(void)address;
+		(void)oldValue;
+		std::this_thread::yield();
+#endif
+	}
+
+	static void wakeAllOnAddress(std::atomic<unsigned int>& address) noexcept
+	{
+#if defined(_WIN32)
+		WakeByAddressAll(&address);
+#elif defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<unsigned int*>(&address), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+		(void)address;
+#endif
+	}
+
+	void waitForNextGeneration(unsigned int oldGeneration) noexcept
+	{
+		for (unsigned int i = 0u; i != spinCount; ++i)
+		{
+			if (generation.load(std::memory_order_acquire) != oldGeneration) return;
+			_mm_pause();
+		}
+		//sleepingCount must be increased before the generation is checked so the last thread to arrive either sees it or we see the new generation.
+		sleepingCount.fetch_add(1u, std::memory_order_seq_cst);
+		while (generation.load(std::memory_order_seq_cst) == oldGeneration)
+		{
+			waitOnAddress(generation, oldGeneration);
+		}
+		sleepingCount.fetch_sub(1u, std::memory_order_relaxed);
+	}
+
+	/*
+	Must be called with the mutex locked by the last thread to arrive.
+	*/
+	void startNextGeneration() noexcept
+	{
+		generation.fetch_add(1u, std::memory_order_seq_cst);
+		if (sleepingCount.load(std::memory_order_seq_cst) != 0u)
+		{
+			wakeAllOnAddress(generation);
+		}
+	}
+
 	template<class F>
-	void syncHelper(std::unique_lock<std::mutex> lock, F&& f)
+	void syncHelper(F&& f)
 	{
-		++waitingCount;
-		auto oldThreadCount = threadCount.load(std::memory_order_relaxed) & 0x7fffffff;
-		if (waitingCount == oldThreadCount)
+		//This thread can't see an older generation as it has already waited for the current one to start.
+		const unsigned int oldGeneration = generation.load(std::memory_order_relaxed);
+		const unsigned long long newState = state.fetch_add(1u, std::memory_order_acq_rel) + 1u;
+		if (getWaitingCount(newState) == getThreadCount(newState))
 		{
+			std::unique_lock<std::mutex> lock(mutex);
 			while (threadsToRemove != nullptr)
 			{
 				auto threadLocalToReindex = threadLocals.previous;
@@ -51,30 +141,27 @@ private:
 
 				auto toReindex = static_cast<ThreadLocal*>(threadLocalToReindex);
 				toReindex->index = threadsToRemove->index;
-			
+
 				threadsToRemove = threadsToRemove->previousToRemove;
 				--increaseInThreads;
 			}
-			threadCount.store(oldThreadCount + increaseInThreads, std::memory_order_relaxed); //unlock and increase by increaseInThreads
+			const unsigned int oldThreadCount = getThreadCount(state.load(std::memory_order_relaxed));
+			state.store(static_cast<unsigned long long>(oldThreadCount + increaseInThreads) << 32u, std::memory_order_relaxed); //unlock, increase by increaseInThreads and reset the waiting count
 			increaseInThreads = 0u;
-			waitingCount = 0u;
-			++generation;
 			f();
-			lock.unlock();
-			conditionVariable.notify_all();
+			startNextGeneration();
 		}
 		else
 		{
-			conditionVariable.wait(lock, [&gen = generation, oldGen = generation]() { return gen != oldGen; });
-			lock.unlock();
+			waitForNextGeneration(oldGeneration);
 		}
 	}
 
 	void start(std::unique_lock<std::mutex> lock)
 	{
-		++waitingCount;
-		auto oldThreadCount = threadCount.load(std::memory_order_relaxed) & 0x7fffffff;
-		if (waitingCount == oldThreadCount)
+		const unsigned long long newState = state.fetch_add(1u, std::memory_order_acq_rel) + 1u;
+		const unsigned int waitingCount = getWaitingCount(newState);
+		if (waitingCount == getThreadCount(newState))
 		{
 			unsigned long index = waitingCount - increaseInThreads;
 			while (threadsToRemove != nullptr)
@@ -89,124 +176,156 @@ private:
 				threadsToRemove = threadsToRemove->previousToRemove;
 			}
 			increaseInThreads = 0u;
-			waitingCount = 0u;
-			++generation;
-			lock.unlock();
-			conditionVariable.notify_all();
+			state.fetch_sub(waitingCount, std::memory_order_relaxed);
+			startNextGeneration();
 		}
 		else
 		{
-			conditionVariable.wait(lock, [&gen = generation, oldGen = generation]() { return gen != oldGen; });
+			const unsigned int oldGeneration = generation.load(std::memory_order_relaxed);
 			lock.unlock();
+			waitForNextGeneration(oldGeneration);
 		}
 	}
 public:
-	ThreadBarrier(unsigned int threadCount1) : threadCount(threadCount1) {}
+	ThreadBarrier(unsigned int threadCount1) :
+		spinCount(std::thread::hardware_concurrency() > 1u ? maxSpinCount : 0u),
+		state(static_cast<unsigned long long>(threadCount1) << 32u)
+	{}
 
 	/*
 	Will have an index that never changes and is in the range [0, number of threads that can't leave) but can never call syncAndRemoveThread.
+	Indices are given in the order threads start. onStarted is called while holding the mutex once the thread has been given its place.
 	*/
-	void startCannotLeave(ThreadLocal& threadLocal)
+	template<class F>
+	void startCannotLeave(ThreadLocal& threadLocal, F&& onStarted)
 	{
 		std::unique_lock<std::mutex> lock(mutex);
-		threadLocal.index = waitingCount - increaseInThreads;
+		threadLocal.index = getWaitingCount(state.load(std::memory_order_relaxed)) - increaseInThreads;
+		onStarted();
 
 		start(std::move(lock));
 	}
 
+	void startCannotLeave(ThreadLocal& threadLocal)
+	{
+		startCannotLeave(threadLocal, []() {});
+	}
+
 	/*
 	Can call syncAndRemoveThread and addThread but index can change after calling sync.
+	onStarted is called while holding the mutex once the thread has been given its place.
 	*/
-	void startCanLeave(ThreadLocal& threadLocal)
+	template<class F>
+	void startCanLeave(ThreadLocal& threadLocal, F&& onStarted)
 	{
 		std::unique_lock<std::mutex> lock(mutex);
 		++increaseInThreads;
 		threadLocal.previousToRemove = threadsToRemove;
 		threadsToRemove = &threadLocal;
+		onStarted();
 
 		start(std::move(lock));
 	}
 
+	void startCanLeave(ThreadLocal& threadLocal)
+	{
+		startCanLeave(threadLocal, []() {});
+	}
+
 	template<class F>
 	void sync(F&& f)
 	{
-		syncHelper(std::unique_lock<std::mutex>(mutex), std::forward<F>(f));
+		syncHelper(std::forward<F>(f));
 	}
 
 	template<class F>
 	void syncAndRemoveThread(ThreadLocal& threadLocal, F&& f)
 	{
-		std::unique_lock<std::mutex> lock(mutex);
-		if (threadLocal.next == &threadLocals)
-		{
-			//threadLocal is last in threadLocals so it can be removed without changing other indices.
-			--increaseInThreads;
-			threadLocal.previous->next = threadLocal.next;
-			threadLocal.next->previous = threadLocal.previous;
-		}
-		else
 		{
-			//threadLocal isn't last in threadLocals so it can't be removed without changing the last index which can't be changed yet as it might be in use by another thread.
-			threadLocal.previousToRemove = threadsToRemove;
-			threadsToRemove = &threadLocal;
+			std::lock_guard<std::mutex> lock(mutex);
+			if (threadLocal.next == &threadLocals)
+			{
+				//threadLocal is last in threadLocals so it can be removed without changing other indices.
+				--increaseInThreads;
+				threadLocal.previous->next = threadLocal.next;
+				threadLocal.next->previous = threadLocal.previous;
+			}
+			else
+			{
+				//threadLocal isn't last in threadLocals so it can't be removed without changing the last index which can't be changed yet as it might be in use by another thread.
+				threadLocal.previousToRemove = threadsToRemove;
+				threadsToRemove = &threadLocal;
+			}
 		}
-		syncHelper(std::move(lock), std::forward<F>(f));
+		syncHelper(std::forward<F>(f));
 	}
 
 	void addThread(ThreadLocal& threadLocal)
 	{
 		std::unique_lock<std::mutex> lock(mutex);
 		bool threadCountIsLocked = false;
-		auto oldThreadCount = threadCount.load(std::memory_order_relaxed);
+		auto oldState = state.load(std::memory_order_relaxed);
 		do
 		{
-			if ((oldThreadCount & 0x80000000) != 0)
+			//The thread can't join a phase that every thread has already finished so it waits for the next one.
+			const unsigned int waitingCount = getWaitingCount(oldState);
+			if ((oldState & threadCountLockedBit) != 0u || (waitingCount != 0u && waitingCount == getThreadCount(oldState)))
 			{
 				threadCountIsLocked = true;
 				break;
 			}
-		} while (!threadCount.compare_exchange_weak(oldThreadCount, oldThreadCount + 1u, std::memory_order_relaxed, std::memory_order_relaxed));
+		} while (!state.compare_exchange_weak(oldState, oldState + (1ull << 32u), std::memory_order_relaxed, std::memory_order_relaxed));
 
-		threadLocal.index = (oldThreadCount & 0x7fffffff) + increaseInThreads;
+		threadLocal.index = getThreadCount(oldState) + increaseInThreads;
 		threadLocal.previous = threadLocals.previous;
 		threadLocal.next = &threadLocals;
 		threadLocals.previous->next = &threadLocal;
 		threadLocals.previous = &threadLocal;
 
-		if (threadCountIsLocked)
+		//Once a thread has called stop the barrier never completes again so the thread joins straight away and calls stop itself.
+		if (threadCountIsLocked && stoppedCount == 0u)
 		{
 			++increaseInThreads;
-			conditionVariable.wait(lock, [&gen = generation, oldGen = generation]() { return gen != oldGen; });
+			const unsigned int oldGeneration = generation.load(std::memory_order_relaxed);
+			lock.unlock();
+			waitForNextGeneration(oldGeneration);
 		}
 	}
 
 	unsigned int lockAndGetThreadCount()
 	{
-		auto oldThreadCount = threadCount.load(std::memory_order_relaxed);
-		if ((oldThreadCount & 0x80000000) == 0)
+		auto oldState = state.load(std::memory_order_relaxed);
+		if ((oldState & threadCountLockedBit) == 0u)
 		{
 			//The threadCount is unlocked. Atomically lock it and get its value.
-			oldThreadCount = threadCount.fetch_or(0x80000000, std::memory_order_relaxed);
+			oldState = state.fetch_or(threadCountLockedBit, std::memory_order_relaxed);
 		}
-		return static_cast<unsigned int>(oldThreadCount & 0x7fffffff);
+		return getThreadCount(oldState);
 	}
 
+	/*
+	Waits for threadCount threads, including ones that are still doing background tasks, then calls f.
+	Threads that are waiting in addThread are woken so that they can call stop as well.
+	*/
 	template<class F>
 	void stop(unsigned int threadCount, F&& f)
 	{
 		std::unique_lock<std::mutex> lock(mutex);
-		++waitingCount;
-		if (waitingCount == threadCount)
+		++stoppedCount;
+		if (stoppedCount == threadCount)
 		{
 			f();
-			++generation;
-			lock.unlock();
-			conditionVariable.notify_all();
+			isStopped = true;
+			startNextGeneration();
+			return;
 		}
-		else
+		startNextGeneration();
+		while (!isStopped)
 		{
-			conditionVariable.wait(lock, [&gen = generation, oldGen = generation]() { return gen != oldGen; });
+			const unsigned int oldGeneration = generation.load(std::memory_order_relaxed);
 			lock.unlock();
+			waitForNextGeneration(oldGeneration);
+			lock.lock();
 		}
 	}
-};
\ No newline at end of file
+};
@@ -1,233 +1,275 @@
+#pragma once
 #include <new>
-#include <atomic>
+#include <mutex>
 #include <cstddef>
 #include <cstdint>
 #include <cassert>
+#include <utility>
+#if defined(_WIN32)
 #include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/*
+Allocates and frees the memory that MultiThreadedPoolAllocator carves into blocks.
+When hugePages is true the memory is hugePageSize aligned and the OS is asked to back it with huge pages.
+On Windows that needs the lock pages in memory privilege, without it normal pages are used.
+*/
+class PoolSlabMemory
+{
+public:
+	constexpr static std::size_t hugePageSize = 2u * 1024u * 1024u;
+
+	class Slab
+	{
+	public:
+		Slab* next;
+		std::size_t size;
+		bool osLargePages;
+	};
+
+	static Slab* allocate(std::size_t size, bool hugePages)
+	{
+		if(hugePages)
+		{
+			size = (size + hugePageSize - 1u) & ~(hugePageSize - 1u);
+#if defined(_WIN32)
+			const std::size_t largePageMinimum = GetLargePageMinimum();
+			if(largePageMinimum != 0u && size % largePageMinimum == 0u)
+			{
+				void* memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if(memory != nullptr)
+				{
+					return new(memory) Slab{nullptr, size, true};
+				}
+			}
+#endif
+			void* memory = ::operator new(size, std::align_val_t{hugePageSize});
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			madvise(memory, size, MADV_HUGEPAGE);
+#endif
+			return new(memory) Slab{nullptr, size, false};
+		}
+		void* memory = ::operator new(size);
+		return new(memory) Slab{nullptr, size, false};
+	}
+
+	static void deallocate(Slab* slab, bool hugePages) noexcept
+	{
+#if defined(_WIN32)
+		if(slab->osLargePages)
+		{
+			VirtualFree(slab, 0u, MEM_RELEASE);
+			return;
+		}
+#endif
+		if(hugePages)
+		{
+			::operator delete(static_cast<void*>(slab), std::align_val_t{hugePageSize});
+		}
+		else
+		{
+			::operator delete(static_cast<void*>(slab));
+		}
+	}
+};
 
-template<std::size_t size, std::size_t alignment>
+/*
+Allocates blocks of one size and alignment from any thread. Blocks can be freed by any thread, not just the one that allocated them.
+Each thread caches free blocks in two magazines of up to magazineSize blocks, so most allocations and frees don't touch memory shared with other threads.
+A thread that fills both magazines, for example by freeing blocks that another thread allocated, gives a full magazine to a shared depot with one lock.
+A thread that empties both magazines takes a full magazine from the depot, or carves a magazine of new blocks from a slab if the depot is empty.
+Having two magazines stops a thread that allocates and frees around a magazine boundary from going to the depot every time.
+All instantiations with the same arguments share their blocks. Slabs are only freed when the program exits, after all threads using the allocator have exited.
+*/
+template<std::size_t size, std::size_t alignment, std::size_t magazineSize = 32u, std::size_t slabSize = 256u * 1024u, bool hugePages = false>
 class MultiThreadedPoolAllocator
 {
-private:
+	static_assert(magazineSize != 0u, "MultiThreadedPoolAllocator needs room for at least one block in a magazine");
+
+	class FreeBlock
+	{
+	public:
+		FreeBlock* next;
+		FreeBlock* nextMagazine; //only used by the first block of a magazine in the depot
+	};
+
 	static constexpr std::size_t myMax(std::size_t x, std::size_t y)
 	{
 		return x > y ? x : y;
 	}
-	
+
 	static constexpr std::size_t ceilToMultiple(std::size_t size2, std::size_t alignment2)
 	{
 		return size2 % alignment2 == 0 ? size2 : size2 + (alignment2 - size2 % alignment2);
 	}
 
-	static constexpr std::size_t minSize = ceilToMultiple(myMax(size, sizeof(char*)),
-		ceilToMultiple(ceilToMultiple(myMax(alignment, alignof(char*)), alignment),
-			alignof(char*)));
-	static constexpr std::size_t minAlignment = ceilToMultiple(ceilToMultiple(
-		myMax(alignment, alignof(char*)), alignment), alignof(char*));
-	
-#if __cplusplus >= 201703L
-	static constexpr std::size_t hardwareDestructiveInterferenceSize 
-		= std::hardware_destructive_interference_size;
-#else
-	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
-#endif
-	
-	class FreeItem
-	{
-	public:
-		FreeItem* next;
-	};
-	
-	class MemPage
+	static constexpr std::size_t blockAlignment = myMax(alignment, alignof(FreeBlock));
+	static constexpr std::size_t blockSize = ceilToMultiple(myMax(size, sizeof(FreeBlock)), blockAlignment);
+	static constexpr std::size_t firstBlockOffset = ceilToMultiple(sizeof(PoolSlabMemory::Slab), blockAlignment);
+	static_assert(blockAlignment <= alignof(std::max_align_t) || hugePages, "Over aligned blocks need hugePages slabs");
+	static_assert(firstBlockOffset + blockSize * magazineSize <= slabSize, "A slab must hold at least one magazine of blocks");
+
+	class Depot
 	{
-		class Data
+		std::mutex mutex;
+		FreeBlock* fullMagazines = nullptr;
+		FreeBlock* looseBlocks = nullptr; //blocks from magazines that weren't full when their thread exited
+		PoolSlabMemory::Slab* slabs = nullptr;
+		unsigned char* slabCurrent = nullptr;
+		unsigned char* slabEnd = nullptr;
+
+		FreeBlock* carveMagazine()
 		{
-		public:
-			MemPage* next; //Read and written by single thread
-			FreeItem* localFreeItems; //Read and written by single thread
-
-			char padding[MultiThreadedPoolAllocator::hardwareDestructiveInterferenceSize > sizeof(MemPage*) + sizeof(FreeItem*) ?
-				MultiThreadedPoolAllocator::hardwareDestructiveInterferenceSize - sizeof(MemPage*) - sizeof(FreeItem*) : 1u]; //Needs to be padded to prevent false sharing
-			
-			MultiThreadedPoolAllocator* owningAllocator; //Read by multiple threads
-
-			char padding2[MultiThreadedPoolAllocator::hardwareDestructiveInterferenceSize > sizeof(MultiThreadedPoolAllocator*) ?
-				MultiThreadedPoolAllocator::hardwareDestructiveInterferenceSize - sizeof(MultiThreadedPoolAllocator*) : 1u]; //Needs to be padded to prevent false sharing
-
-			std::atomic<FreeItem*> returnedFreeItems; //Read and written by multiple threads
-
-			Data(MemPage* next, MultiThreadedPoolAllocator* owningAllocator) :
-				next{next},
-				owningAllocator{owningAllocator},
-				returnedFreeItems{nullptr},
-				localFreeItems{nullptr} {}
-		};
-		static constexpr std::size_t startOffset =
-			MultiThreadedPoolAllocator::ceilToMultiple(sizeof(Data),
-				MultiThreadedPoolAllocator::minAlignment);
+			if(static_cast<std::size_t>(slabEnd - slabCurrent) < blockSize * magazineSize)
+			{
+				PoolSlabMemory::Slab* slab = PoolSlabMemory::allocate(slabSize, hugePages);
+				slab->next = slabs;
+				slabs = slab;
+				slabCurrent = reinterpret_cast<unsigned char*>(slab) + firstBlockOffset;
+				slabEnd = reinterpret_cast<unsigned char*>(slab) + slab->size;
+			}
+			FreeBlock* magazine = nullptr;
+			for(std::size_t i = 0u; i != magazineSize; ++i)
+			{
+				magazine = new(slabCurrent) FreeBlock{magazine, nullptr};
+				slabCurrent += blockSize;
+			}
+			return magazine;
+		}
 	public:
-		Data data;
-
-		MemPage(MultiThreadedPoolAllocator* owningAllocator, std::size_t totalSize,
-			char* mem, MemPage* next) :
-			data(next, owningAllocator)
+		~Depot()
 		{
-			constexpr auto minSize = MultiThreadedPoolAllocator::minSize;
-			assert(startOffset + minSize >= totalSize && "Allocating a memory page that doesn't have enough space for any pooled items");
-			const char* theEnd = mem + totalSize - minSize;
-			for(char* current = mem + startOffset; 
-				current <= theEnd; current += minSize)
+			while(slabs != nullptr)
 			{
-				FreeItem* const newPtr = new(current) FreeItem{data.localFreeItems};
-				data.localFreeItems = newPtr;
+				PoolSlabMemory::Slab* next = slabs->next;
+				PoolSlabMemory::deallocate(slabs, hugePages);
+				slabs = next;
 			}
 		}
-	};
-	
-	MemPage* freePagesList;
-	std::size_t virtualAllocationGranularity;
-
-	char padding[hardwareDestructiveInterferenceSize > sizeof(MemPage*) + sizeof(std::size_t) ?
-		hardwareDestructiveInterferenceSize - sizeof(MemPage*) - sizeof(std::size_t) : 1u]; //Needs to be padded to prevent false sharing
 
-	std::atomic<MemPage*> returnedFreePages;
-public:
-	MultiThreadedPoolAllocator(std::size_t virtualAllocationGranularity) :
-		freePagesList{nullptr},
-		virtualAllocationGranularity(virtualAllocationGranularity),
-		returnedFreePages{nullptr} {}
-			
-	void* allocate()
-	{
-		if(freePagesList != nullptr)
+		/*
+		Returns a list of blocks and sets count to its length.
+		*/
+		FreeBlock* takeMagazine(std::size_t& count)
 		{
-			MemPage* const page = freePagesList;
-			FreeItem* freeItem = page->data.localFreeItems;
-			if(freeItem != nullptr)
+			std::lock_guard<std::mutex> lock(mutex);
+			if(fullMagazines != nullptr)
 			{
-				page->data.localFreeItems = freeItem->next;
-				freeItem->~FreeItem();
-				return freeItem;
+				FreeBlock* magazine = fullMagazines;
+				fullMagazines = magazine->nextMagazine;
+				count = magazineSize;
+				return magazine;
 			}
-			while(true)
+			if(looseBlocks != nullptr)
 			{
-				//Get items from returned free list
-				FreeItem* returedItems = page->data.returnedFreeItems.load(std::memory_order_relaxed);
-				while(!page->data.returnedFreeItems.compare_exchange_weak(
-					returedItems,
-					nullptr,
-					std::memory_order_acquire,
-					std::memory_order_relaxed)) {};
-				if(returedItems != nullptr)
+				FreeBlock* magazine = looseBlocks;
+				FreeBlock* last = magazine;
+				count = 1u;
+				while(count != magazineSize && last->next != nullptr)
 				{
-					//Add returedItems to localFreeItems
-					page->data.localFreeItems = returedItems->next;
-					//Return first item from localFreeItems
-					returedItems->~FreeItem();
-					return returedItems;
-				}
-				//Try set returned free list to &owningAllocator because mem page is fully allocated
-				FreeItem* expected = nullptr;
-				FreeItem* owningAllocator = reinterpret_cast<FreeItem*>(page->data.owningAllocator);
-				if(page->data.returnedFreeItems.compare_exchange_weak(
-					expected,
-					owningAllocator,
-					std::memory_order_relaxed,
-					std::memory_order_relaxed))
-				{
-					//Remove page from freePages list
-					freePagesList = freePagesList->data.next;
-					return allocate();
+					last = last->next;
+					++count;
 				}
+				looseBlocks = last->next;
+				last->next = nullptr;
+				return magazine;
 			}
+			count = magazineSize;
+			return carveMagazine();
+		}
+
+		void returnMagazine(FreeBlock* magazine)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			magazine->nextMagazine = fullMagazines;
+			fullMagazines = magazine;
 		}
-		//Try to recover returned mem pages
-		MemPage* returnedPages = returnedFreePages.load(std::memory_order_relaxed);
-		while(!returnedFreePages.compare_exchange_weak(
-			returnedPages,
-			nullptr,
-			std::memory_order_acquire,
-			std::memory_order_relaxed)) {};
-		if(returnedPages != nullptr)
+
+		void returnBlocks(FreeBlock* blocks)
 		{
-			freePagesList = returnedPages;
+			if(blocks == nullptr) return;
+			FreeBlock* last = blocks;
+			while(last->next != nullptr) last = last->next;
+			std::lock_guard<std::mutex> lock(mutex);
+			last->next = looseBlocks;
+			looseBlocks = blocks;
 		}
-		else
+	};
+
+	static Depot& depot()
+	{
+		static Depot instance;
+		return instance;
+	}
+
+	class ThreadCache
+	{
+	public:
+		Depot& depot; //keeps the depot alive until this thread's blocks have been returned
+		FreeBlock* loaded = nullptr;
+		std::size_t loadedCount = 0u;
+		FreeBlock* previous = nullptr;
+		std::size_t previousCount = 0u; //always 0 or magazineSize
+
+		ThreadCache() : depot(MultiThreadedPoolAllocator::depot()) {}
+
+		~ThreadCache()
+		{
+			depot.returnBlocks(loaded);
+			if(previousCount != 0u) depot.returnMagazine(previous);
+		}
+
+		void swapMagazines() noexcept
 		{
-			//Allocate mem page using virtual alloc
-			char* newPageMemory = reinterpret_cast<char*>(
-				VirtualAlloc(nullptr, virtualAllocationGranularity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
-			MemPage* newPage = new(newPageMemory) MemPage{this, virtualAllocationGranularity,
-				newPageMemory, freePagesList};
-			freePagesList = newPage;
+			std::swap(loaded, previous);
+			std::swap(loadedCount, previousCount);
 		}
-		return allocate();
+	};
+
+	static ThreadCache& threadCache()
+	{
+		thread_local ThreadCache cache;
+		return cache;
 	}
-		
-	void deallocate(void* ptr)
+public:
+	static void* allocate()
 	{
-		//Get address of mem page
-		MemPage* page = reinterpret_cast<MemPage*>(
-			reinterpret_cast<std::uintptr_t>(ptr) 
-			& static_cast<std::uintptr_t>(virtualAllocationGranularity - 1u));
-		if(page->data.owningAllocator == this)
+		ThreadCache& cache = threadCache();
+		if(cache.loadedCount == 0u)
 		{
-			//Add ptr to free items page
-			FreeItem* const oldFreeItems = page->data.localFreeItems;
-			page->data.localFreeItems = new(ptr) FreeItem{oldFreeItems};
-			//If page was fully allocated, add page to freePagesList of this allocator
-			if(oldFreeItems == nullptr)
+			if(cache.previousCount != 0u)
 			{
-				FreeItem* expected = reinterpret_cast<FreeItem*>(this);
-				if(page->data.returnedFreeItems.compare_exchange_strong(
-					expected,
-					nullptr,
-					std::memory_order_relaxed,
-					std::memory_order_relaxed))
-				{
-					page->data.next = freePagesList;
-					freePagesList = page;
-				}
+				cache.swapMagazines();
+			}
+			else
+			{
+				cache.loaded = cache.depot.takeMagazine(cache.loadedCount);
 			}
 		}
-		else
+		FreeBlock* block = cache.loaded;
+		cache.loaded = block->next;
+		--cache.loadedCount;
+		block->~FreeBlock();
+		return block;
+	}
+
+	static void deallocate(void* ptr) noexcept
+	{
+		assert(ptr != nullptr);
+		ThreadCache& cache = threadCache();
+		if(cache.loadedCount == magazineSize)
 		{
-			//Add ptr to returned free items of page
-			FreeItem* const pageAllocator = reinterpret_cast<FreeItem*>(page->data.owningAllocator);
-			FreeItem* oldReturnedFreeItems = page->data.returnedFreeItems
-				.load(std::memory_order_relaxed);
-			FreeItem* newReturnedFreeItems;
-			bool wasFullyAllocated;
-			do
-			{
-				if(oldReturnedFreeItems == pageAllocator)
-				{
-					newReturnedFreeItems = new(ptr) FreeItem{nullptr};
-					wasFullyAllocated = true;
-				}
-				else
-				{
-					newReturnedFreeItems = new(ptr) FreeItem{oldReturnedFreeItems};
-					wasFullyAllocated = false;
-				}
-			} while(!page->data.returnedFreeItems.compare_exchange_weak(
-				oldReturnedFreeItems,
-				newReturnedFreeItems,
-				std::memory_order_release,
-				std::memory_order_relaxed));
-			//If page was fully allocated, add page to returnedFreePages of owningAllocator
-			if(wasFullyAllocated)
+			if(cache.previousCount != 0u)
 			{
-				std::atomic<MemPage*>& returnedFreePages = page->data.owningAllocator
-					->returnedFreePages;
-				page->data.next = returnedFreePages.load(
-					std::memory_order_relaxed);
-				while(!returnedFreePages.compare_exchange_weak(
-					page->data.next,
-					page,
-					std::memory_order_release,
-					std::memory_order_relaxed)) {}
+				cache.depot.returnMagazine(cache.previous);
+				cache.previous = nullptr;
+				cache.previousCount = 0u;
 			}
+			cache.swapMagazines();
 		}
+		cache.loaded = new(ptr) FreeBlock{cache.loaded, nullptr};
+		++cache.loadedCount;
 	}
-};
\ No newline at end of file
+};
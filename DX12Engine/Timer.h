@@ -5,6 +5,7 @@ class Timer
 {
 	std::chrono::time_point<std::chrono::high_resolution_clock> oldTime;
 	float mFrameTime;
+	float mFrameBudget = 1.0f / 60.0f;
 public:
 	void start();
 	void update();
@@ -12,4 +13,17 @@ public:
 	{
 		return mFrameTime;
 	}
+
+	/*
+	The time in seconds that a frame should take.
+	*/
+	float frameBudget() const
+	{
+		return mFrameBudget;
+	}
+
+	void setFrameBudget(float frameBudget)
+	{
+		mFrameBudget = frameBudget;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+#include "ResizingArray.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+A hierarchical timer wheel holding values until a tick is reached. Ticks can be frames, milliseconds or anything else that only increases.
+Level 0 has a slot for each of the next slotCount ticks, level 1 a slot for each of the next slotCount groups of slotCount ticks and so on.
+Values further in the future than the last level covers wait in an overflow list.
+When the ticks in a higher level slot are reached its values are moved down to the level below.
+Not thread safe.
+*/
+template<class T, std::size_t levelCount = 3u, std::size_t slotBits = 6u>
+class TimerWheel
+{
+	static_assert(levelCount != 0u && slotBits * levelCount < 64u, "TimerWheel needs at least one level and fewer than 64 bits of ticks");
+	constexpr static std::size_t slotCount = std::size_t{ 1u } << slotBits;
+	constexpr static std::uint64_t slotMask = slotCount - 1u;
+
+	class Entry
+	{
+	public:
+		T value;
+		std::uint64_t dueTick;
+	};
+
+	ResizingArray<Entry> mSlots[levelCount][slotCount];
+	ResizingArray<Entry> mOverflow;
+	std::uint64_t mCurrentTick;
+	std::size_t mSize = 0u;
+
+	void insert(Entry&& entry)
+	{
+		for (std::size_t level = 0u; level != levelCount; ++level)
+		{
+			//The entry goes in the lowest level where it is in the same group of slots as the current tick.
+			const std::size_t groupShift = slotBits * (level + 1u);
+			if ((entry.dueTick >> groupShift) == (mCurrentTick >> groupShift))
+			{
+				mSlots[level][(entry.dueTick >> (slotBits * level)) & slotMask].push_back(std::move(entry));
+				return;
+			}
+		}
+		mOverflow.push_back(std::move(entry));
+	}
+
+	void reinsert(ResizingArray<Entry>& entries)
+	{
+		ResizingArray<Entry> temp;
+		temp.swap(entries);
+		for (auto& entry : temp)
+		{
+			insert(std::move(entry));
+		}
+	}
+
+	/*
+	Moves values down from the higher levels whose slots start at the current tick, highest level first.
+	*/
+	void cascade()
+	{
+		//Levels below the first level that isn't at slot 0 have just wrapped around.
+		std::size_t level = 1u;
+		while (level != levelCount && ((mCurrentTick >> (slotBits * level)) & slotMask) == 0u) ++level;
+		if (level == levelCount)
+		{
+			reinsert(mOverflow);
+			--level;
+		}
+		for (; level != 0u; --level)
+		{
+			reinsert(mSlots[level][(mCurrentTick >> (slotBits * level)) & slotMask]);
+		}
+	}
+public:
+	TimerWheel(std::uint64_t currentTick = 0u) : mCurrentTick(currentTick) {}
+
+	std::uint64_t currentTick() const noexcept
+	{
+		return mCurrentTick;
+	}
+
+	std::size_t size() const noexcept
+	{
+		return mSize;
+	}
+
+	/*
+	value is released by the first call to advance that reaches dueTick. A dueTick that has already been reached is released by the next advance.
+	*/
+	void push(T value, std::uint64_t dueTick)
+	{
+		if (dueTick <= mCurrentTick) dueTick = mCurrentTick + 1u;
+		insert(Entry{ std::move(value), dueTick });
+		++mSize;
+	}
+
+	/*
+	Empties the wheel calling f with each value and its due tick in no particular order.
+	*/
+	template<class F>
+	void removeAll(F&& f)
+	{
+		const auto removeEntries = [&f](ResizingArray<Entry>& entries)
+		{
+			for (auto& entry : entries)
+			{
+				f(std::move(entry.value), entry.dueTick);
+			}
+			entries.clear();
+		};
+		for (auto& level : mSlots)
+		{
+			for (auto& slot : level)
+			{
+				removeEntries(slot);
+			}
+		}
+		removeEntries(mOverflow);
+		mSize = 0u;
+	}
+
+	/*
+	Moves the wheel forward to tick calling release with each value that becomes due, in tick order.
+	*/
+	template<class Release>
+	void advance(std::uint64_t tick, Release&& release)
+	{
+		while (mCurrentTick < tick)
+		{
+			if (mSize == 0u)
+			{
+				mCurrentTick = tick;
+				return;
+			}
+			++mCurrentTick;
+			if ((mCurrentTick & slotMask) == 0u) cascade();
+			ResizingArray<Entry>& slot = mSlots[0][mCurrentTick & slotMask];
+			if (slot.size() != 0u)
+			{
+				ResizingArray<Entry> due;
+				due.swap(slot);
+				mSize -= due.size();
+				for (auto& entry : due)
+				{
+					release(std::move(entry.value));
+				}
+				//release can push more values so the emptied slot's memory is only kept if nothing was added.
+				if (slot.size() == 0u)
+				{
+					due.clear();
+					slot.swap(due);
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <type_traits>
+#include <utility> //std::pair
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+/*
+A type is trivially relocatable if moving it to a new address and destroying the original can be done by copying its bytes.
+This is true for trivially copyable types and for most types that only own resources through pointers, such as COM pointer wrappers.
+Types opt in by specializing IsTriviallyRelocatable. Types that point into themselves must not opt in.
+*/
+template<class T>
+class IsTriviallyRelocatable : public std::is_trivially_copyable<T> {};
+
+template<class First, class Second>
+class IsTriviallyRelocatable<std::pair<First, Second>> :
+	public std::bool_constant<IsTriviallyRelocatable<First>::value && IsTriviallyRelocatable<Second>::value> {};
+
+template<class T>
+constexpr bool isTriviallyRelocatable = IsTriviallyRelocatable<std::remove_cv_t<T>>::value;
+
+/*
+Moves count objects from source to uninitialized memory at destination and ends the lifetime of the objects at source.
+The ranges must not overlap.
+*/
+template<class T>
+void relocate(T* source, std::size_t count, T* destination)
+{
+	if constexpr (isTriviallyRelocatable<T>)
+	{
+		if (count != 0u) std::memcpy(static_cast<void*>(destination), static_cast<const void*>(source), count * sizeof(T));
+	}
+	else
+	{
+		for (std::size_t i = 0u; i != count; ++i)
+		{
+			new(destination + i) T(std::move(source[i]));
+			source[i].~T();
+		}
+	}
+}
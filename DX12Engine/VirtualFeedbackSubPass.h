@@ -43,10 +43,26 @@ class VirtualFeedbackSubPass : public RenderSubPass<VirtualPageCamera, D3D12_RES
 
 			const unsigned long totalSize = analyser.textureWidth * analyser.textureHeight * 8u;
 			void* feadBackBuffer = analyser.mapReadbackTexture(totalSize);
-			pageProvider.gatherPageRequests(feadBackBuffer, totalSize);
-			analyser.unmapReadbackTexture();
-			pageProvider.processPageRequests(threadResources, *static_cast<TaskShedular<ThreadResources>*>(analyser.taskShedular), analyser.mipBias, analyser.desiredMipBias);
-		}});
+			const unsigned int threadCount = static_cast<TaskShedular<ThreadResources>*>(analyser.taskShedular)->threadCount();
+			const unsigned int partCount = pageProvider.startGatheringPageRequests(feadBackBuffer, totalSize, threadCount);
+			//other threads help if they are free, parts they don't get to are gathered here
+			for(unsigned int i = 1u; i < partCount; ++i)
+			{
+				threadResources.taskShedular.pushBackgroundTask({requester, gatherPageRequestParts<ThreadResources>}, BackgroundPriority::high);
+			}
+			gatherPageRequestParts<ThreadResources>(requester, threadResources);
+		}}, BackgroundPriority::high);
+	}
+
+	template<class ThreadResources>
+	static void gatherPageRequestParts(void* requester, ThreadResources& threadResources)
+	{
+		VirtualFeedbackSubPass& analyser = *static_cast<VirtualFeedbackSubPass*>(requester);
+		PageProvider& pageProvider = analyser.pageProvider;
+		if(!pageProvider.gatherPageRequestParts()) return;
+		analyser.unmapReadbackTexture();
+		pageProvider.finishGatheringPageRequests();
+		pageProvider.processPageRequests(threadResources, *static_cast<TaskShedular<ThreadResources>*>(analyser.taskShedular), analyser.mipBias, analyser.desiredMipBias);
 	}
 
 	void* mapReadbackTexture(unsigned long totalSize);
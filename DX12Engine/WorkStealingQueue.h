@@ -3,85 +3,191 @@
 #include <memory>
 #include <cstddef>
 #include <cassert>
+#include <type_traits>
+#include <new>
+#include <cstring>
 
+#pragma warning(push)
+#pragma warning(disable:4324) //warns about padding due to over alignment
+
+/*
+A Chase-Lev work stealing deque.
+The owning thread pushes and pops at the bottom without any atomic read-modify-write unless it is racing a thief for the last item.
+Other threads steal from the top using compare and swap.
+Thieves read an item before they know if the steal succeeded so T must be trivially copyable.
+*/
 template<class T, class Alloc = std::allocator<T>>
 class WorkStealingQueue : private Alloc
 {
-	T* mBegin;
-	std::atomic<std::ptrdiff_t> mEndIndex;
-	std::ptrdiff_t mCapacity;
+	static_assert(std::is_trivially_copyable_v<T>, "WorkStealingQueue can only store trivially copyable types");
+#if __cplusplus >= 201703L
+	static constexpr std::size_t hardwareDestructiveInterferenceSize
+		= std::hardware_destructive_interference_size;
+#else
+	static constexpr std::size_t hardwareDestructiveInterferenceSize = 64u;
+#endif
 
-	void resize()
+	class Buffer
 	{
-		std::ptrdiff_t newCapacity = mCapacity * 2;
-		T* newBegin = this->allocate(newCapacity);
-		for (std::ptrdiff_t i = 0; i != mCapacity; ++i)
+	public:
+		T* begin;
+		std::ptrdiff_t capacity; //always a power of two
+	};
+	constexpr static std::size_t maxBufferCount = sizeof(std::size_t) * 8u;
+
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<std::ptrdiff_t> mTop;
+	alignas(hardwareDestructiveInterferenceSize) std::atomic<std::ptrdiff_t> mBottom;
+	std::atomic<Buffer*> mCurrentBuffer;
+	/*
+	Buffers replaced by resize can still be read by thieves so they are kept until reset or resetIfInvalid is called.
+	The current buffer is always the last one in use.
+	*/
+	Buffer mBuffers[maxBufferCount];
+
+	void resize(Buffer& oldBuffer, std::ptrdiff_t top, std::ptrdiff_t bottom)
+	{
+		assert(&oldBuffer != &mBuffers[maxBufferCount - 1u] && "WorkStealingQueue has run out of buffers");
+		Buffer& newBuffer = *(&oldBuffer + 1);
+		newBuffer.capacity = oldBuffer.capacity * 2;
+		newBuffer.begin = this->allocate(static_cast<std::size_t>(newBuffer.capacity));
+		const std::ptrdiff_t oldMask = oldBuffer.capacity - 1;
+		const std::ptrdiff_t newMask = newBuffer.capacity - 1;
+		//copied in runs that don't wrap around either buffer. The old buffer isn't changed as thieves can still be reading it.
+		for (std::ptrdiff_t i = top; i != bottom;)
 		{
-			new(newBegin + i) T(std::move(mBegin[i]));
-			mBegin[i].~T();
+			const std::ptrdiff_t oldIndex = i & oldMask;
+			const std::ptrdiff_t newIndex = i & newMask;
+			std::ptrdiff_t count = bottom - i;
+			if (count > oldBuffer.capacity - oldIndex) count = oldBuffer.capacity - oldIndex;
+			if (count > newBuffer.capacity - newIndex) count = newBuffer.capacity - newIndex;
+			std::memcpy(static_cast<void*>(newBuffer.begin + newIndex), static_cast<const void*>(oldBuffer.begin + oldIndex), static_cast<std::size_t>(count) * sizeof(T));
+			i += count;
 		}
-		this->deallocate(mBegin, mCapacity);
-		mBegin = newBegin;
-		mCapacity = newCapacity;
+		mCurrentBuffer.store(&newBuffer, std::memory_order_release);
 	}
-public:
-	WorkStealingQueue() : mEndIndex(0), mCapacity(128u)
+
+	void freeOldBuffers() noexcept
+	{
+		Buffer* currentBuffer = mCurrentBuffer.load(std::memory_order_relaxed);
+		if (currentBuffer == mBuffers) return;
+		for (Buffer* buffer = mBuffers; buffer != currentBuffer; ++buffer)
+		{
+			this->deallocate(buffer->begin, static_cast<std::size_t>(buffer->capacity));
+		}
+		mBuffers[0] = *currentBuffer;
+		mCurrentBuffer.store(mBuffers, std::memory_order_relaxed);
+	}
+
+	static std::ptrdiff_t roundUpToPowerOfTwo(std::ptrdiff_t value) noexcept
 	{
-		mBegin = this->allocate(128u);
+		std::ptrdiff_t result = 8;
+		while (result < value) result *= 2;
+		return result;
 	}
-	
-	WorkStealingQueue(std::ptrdiff_t capacity) : mEndIndex(0)
+public:
+	WorkStealingQueue() : WorkStealingQueue(128) {}
+
+	WorkStealingQueue(std::ptrdiff_t capacity) : WorkStealingQueue(capacity, Alloc()) {}
+
+	WorkStealingQueue(std::ptrdiff_t capacity, const Alloc& allocator) : Alloc(allocator), mTop(0), mBottom(0)
 	{
-		if(capacity <= 0) capacity = 8;
-		mCapacity = capacity;
-		mBegin = this->allocate(capacity);
+		mCurrentBuffer.store(mBuffers, std::memory_order_relaxed);
+		mBuffers[0].capacity = roundUpToPowerOfTwo(capacity);
+		mBuffers[0].begin = this->allocate(static_cast<std::size_t>(mBuffers[0].capacity));
 	}
-	
+
 	~WorkStealingQueue()
 	{
-		this->deallocate(mBegin, mCapacity);
+		freeOldBuffers();
+		this->deallocate(mBuffers[0].begin, static_cast<std::size_t>(mBuffers[0].capacity));
 	}
-	
+
 	//can only be executed by the thread that owns this queue.
-	//can only be called after the memory effects of all pops are visable and reset/resetIfInvalid has been called.
+	//can be called while other threads are stealing.
 	void push(T item)
 	{
-		std::ptrdiff_t oldEndIndex = mEndIndex.load(std::memory_order_relaxed);
-		std::ptrdiff_t newEndIndex = oldEndIndex + 1;
-		if(newEndIndex == mCapacity)
+		const std::ptrdiff_t bottom = mBottom.load(std::memory_order_relaxed);
+		const std::ptrdiff_t top = mTop.load(std::memory_order_acquire);
+		Buffer* buffer = mCurrentBuffer.load(std::memory_order_relaxed);
+		if (bottom - top >= buffer->capacity - 1)
 		{
-			resize();
+			resize(*buffer, top, bottom);
+			++buffer;
 		}
-		new(mBegin + oldEndIndex) T(std::move(item));
-		mEndIndex.store(newEndIndex, std::memory_order_relaxed);
+		new(buffer->begin + (bottom & (buffer->capacity - 1))) T(std::move(item));
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
 	}
-	
-	//can be called by any thread.
-	//can only be called after the memory effects of all pushes are visable.
+
+	//can only be executed by the thread that owns this queue.
+	//Takes the most recently pushed item.
 	bool pop(T& item)
 	{
-		const std::ptrdiff_t oldEndIndex = mEndIndex.fetch_sub(1, std::memory_order_relaxed) - 1;
-		if(oldEndIndex < 0) return false;
-		item = std::move(mBegin[oldEndIndex]);
-		mBegin[oldEndIndex].~T();
+		const std::ptrdiff_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buffer = mCurrentBuffer.load(std::memory_order_relaxed);
+		mBottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::ptrdiff_t top = mTop.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			//The queue was empty
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+		item = buffer->begin[bottom & (buffer->capacity - 1)];
+		if (top == bottom)
+		{
+			//This is the last item so a thief might be trying to take it too.
+			const bool won = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return won;
+		}
 		return true;
 	}
-	
-	//reset or resetIfInvalid must be called after poping has finished and before pushing starts.
+
+	//can be called by any thread.
+	//Takes the least recently pushed item. Only returns false if the queue was empty.
+	bool steal(T& item)
+	{
+		std::ptrdiff_t top = mTop.load(std::memory_order_acquire);
+		while (true)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const std::ptrdiff_t bottom = mBottom.load(std::memory_order_acquire);
+			if (top >= bottom) return false;
+			const Buffer* buffer = mCurrentBuffer.load(std::memory_order_acquire);
+			item = buffer->begin[top & (buffer->capacity - 1)];
+			if (mTop.compare_exchange_weak(top, top + 1, std::memory_order_seq_cst, std::memory_order_acquire)) return true;
+		}
+	}
+
+	//can be called by any thread.
+	//The result is only an estimate if other threads are using the queue.
+	std::ptrdiff_t size() const noexcept
+	{
+		const std::ptrdiff_t top = mTop.load(std::memory_order_relaxed);
+		const std::ptrdiff_t bottom = mBottom.load(std::memory_order_relaxed);
+		return bottom > top ? bottom - top : 0;
+	}
+
+	//reset or resetIfInvalid must be called after stealing has finished.
 	//can only be executed by the thread that owns this queue.
 	void reset() noexcept
 	{
-		mEndIndex.store(0, std::memory_order_relaxed);
+		mTop.store(0, std::memory_order_relaxed);
+		mBottom.store(0, std::memory_order_relaxed);
+		freeOldBuffers();
 	}
 
 	//resets the queue if it doesn't contain items.
-	//can only be executed by the thread that owns this queue.
+	//can only be executed by the thread that owns this queue while no other threads are stealing from it.
 	void resetIfInvalid() noexcept
 	{
-		std::ptrdiff_t oldEndIndex = mEndIndex.load(std::memory_order_relaxed);
-		if (oldEndIndex < 0)
+		if (mTop.load(std::memory_order_relaxed) >= mBottom.load(std::memory_order_relaxed))
 		{
-			mEndIndex.store(0, std::memory_order_relaxed);
+			reset();
 		}
 	}
-};
\ No newline at end of file
+};
+
+#pragma warning(pop)
\ No newline at end of file
@@ -5,7 +5,7 @@
 #include <cmath>
 #include "Zone.h"
 #include <algorithm>
-#include "PriorityQueue.h"
+#include "IndexedPriorityQueue.h"
 #include "HashSet.h"
 #include "ResizingArray.h"
 #include "WorldManagerStopRequest.h"
@@ -16,79 +16,16 @@ class WorldManager
 public:
 	using StopRequest = WorldManagerStopRequest;
 private:
-	class SearchNode;
-	class SearchNodeTracker
-	{
-	public:
-		SearchNode* node;
-		SearchNodeTracker() = default;
-		SearchNodeTracker(const SearchNodeTracker& other) = delete;
-		SearchNodeTracker(SearchNodeTracker&& other) : node(other.node)
-		{
-			other.node = nullptr;
-			node->queueLocation = this;
-		}
-
-		void operator=(const SearchNodeTracker& other) = delete;
-		void operator=(SearchNodeTracker&& other)
-		{
-			node = other.node;
-			other.node = nullptr;
-			node->queueLocation = this;
-		}
-
-		~SearchNodeTracker()
-		{
-			if(node != nullptr)
-			{
-				node->queueLocation = nullptr;
-			}
-		}
-
-		SearchNode* operator->() const
-		{
-			return node;
-		}
-	};
-
 	class SearchNode
 	{
 	public:
 		SearchNode() noexcept {}
 
 		constexpr SearchNode(float totalDistance1, unsigned long zoneX1, unsigned long zoneY1, unsigned long zoneZ1, unsigned long zoneIndex1,
-			unsigned long worldIndex1, Vector3 anchor1, float distanceFromStartToAnchor1, SearchNodeTracker* queueLocation1) noexcept :
+			unsigned long worldIndex1, Vector3 anchor1, float distanceFromStartToAnchor1) noexcept :
 			totalDistance(totalDistance1), zoneX(zoneX1), zoneY(zoneY1), zoneZ(zoneZ1),
 			zoneIndex(zoneIndex1), worldIndex(worldIndex1), anchor(anchor1),
-			distanceFromStartToAnchor(distanceFromStartToAnchor1), 
-			queueLocation(queueLocation1){}
-
-		SearchNode(SearchNode&& other) noexcept : totalDistance(other.totalDistance), zoneX(other.zoneX), zoneY(other.zoneY), zoneZ(other.zoneZ), zoneIndex(other.zoneIndex),
-			worldIndex(other.worldIndex), anchor(other.anchor), distanceFromStartToAnchor(other.distanceFromStartToAnchor), queueLocation(other.queueLocation)
-		{
-			if(queueLocation != nullptr)
-			{
-				queueLocation->node = this;
-			}
-		}
-
-		void operator=(SearchNode&& other) noexcept
-		{
-			totalDistance = other.totalDistance;
-			zoneX = other.zoneX;
-			zoneY = other.zoneY;
-			zoneZ = other.zoneZ;
-			zoneIndex = other.zoneIndex;
-			worldIndex = other.worldIndex;
-			anchor = other.anchor;
-			distanceFromStartToAnchor = other.distanceFromStartToAnchor;
-			queueLocation = other.queueLocation;
-
-			if (queueLocation != nullptr)
-			{
-				queueLocation->node = this;
-			}
-		}
+			distanceFromStartToAnchor(distanceFromStartToAnchor1) {}
 
 		float totalDistance;
 		unsigned long zoneX;
@@ -98,43 +35,52 @@ private:
 		unsigned long worldIndex;
 		Vector3 anchor;
 		float distanceFromStartToAnchor;
-		SearchNodeTracker* queueLocation;
 	};
 
-	class SearchNodeHasher
+	class SearchNodePriority
 	{
 	public:
-		std::size_t operator()(const SearchNode& node) const noexcept
+		constexpr bool operator()(const SearchNode& lhs, const SearchNode& rhs) const noexcept
 		{
-			return (std::size_t)node.zoneIndex;
+			return lhs.totalDistance > rhs.totalDistance;
 		}
+	};
 
-		std::size_t operator()(unsigned long zoneIndex) const noexcept
-		{
-			return (std::size_t)zoneIndex;
-		}
+	using SearchQueue = IndexedPriorityQueue<SearchNode, SearchNodePriority>;
+	using SearchNodeHandle = SearchQueue::Handle;
+
+	class VisitedZone
+	{
+	public:
+		unsigned long zoneIndex;
+		SearchNodeHandle node;
 	};
 
-	class SearchNodeEqual
+	class VisitedZoneHasher
 	{
 	public:
-		constexpr bool operator()(const SearchNode& lhs, const SearchNode& rhs) const noexcept
+		std::size_t operator()(const VisitedZone& visitedZone) const noexcept
 		{
-			return lhs.zoneIndex == rhs.zoneIndex;
+			return (std::size_t)visitedZone.zoneIndex;
 		}
 
-		constexpr bool operator()(const SearchNode& lhs, unsigned long zoneIndex) const noexcept
+		std::size_t operator()(unsigned long zoneIndex) const noexcept
 		{
-			return lhs.zoneIndex == zoneIndex;
+			return (std::size_t)zoneIndex;
 		}
 	};
 
-	class SearchNodePriority
+	class VisitedZoneEqual
 	{
 	public:
-		constexpr bool operator()(const SearchNodeTracker& lhs, const SearchNodeTracker& rhs) const noexcept
+		constexpr bool operator()(const VisitedZone& lhs, const VisitedZone& rhs) const noexcept
 		{
-			return lhs->totalDistance > rhs->totalDistance;
+			return lhs.zoneIndex == rhs.zoneIndex;
+		}
+
+		constexpr bool operator()(const VisitedZone& lhs, unsigned long zoneIndex) const noexcept
+		{
+			return lhs.zoneIndex == zoneIndex;
 		}
 	};
 
@@ -150,8 +96,8 @@ private:
 	const unsigned int levelOfDetailMaxDistancesCount;
 	unsigned int currentLoadedZonesIndex = 0u;
 	HashSet<unsigned long, std::hash<unsigned long>, std::equal_to<unsigned long>, std::allocator<unsigned long>, unsigned long> loadedZones[2];
-	HashSet<SearchNode, SearchNodeHasher, SearchNodeEqual> visitedNodes;
-	PriorityQueue<SearchNodeTracker, ResizingArray<SearchNodeTracker>, SearchNodePriority> frontierNodes;
+	HashSet<VisitedZone, VisitedZoneHasher, VisitedZoneEqual> visitedNodes;
+	SearchQueue frontierNodes; //holds every node visited in the current search, popped nodes have been loaded
 	StopRequest* mStopRequest = nullptr;
 
 	void load(ThreadResources& threadResources)
@@ -167,17 +113,15 @@ private:
 			const float totalDistance = (Vector3{zoneX * zoneDiameter + zoneRadius, zoneY * zoneDiameter + zoneRadius, zoneZ * zoneDiameter + zoneRadius} - loadedPosition).length();
 			const unsigned long zoneIndex = world.zonesStartIndex + zoneX * (world.sizeY * world.sizeZ) + zoneY * world.sizeZ + zoneZ;
 
-			SearchNodeTracker newNodeTracker;
-			SearchNode newNode = {totalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentWorldIndex, loadedPosition, 0.0f, &newNodeTracker};
-			newNodeTracker.node = &newNode;
-			visitedNodes.insert(std::move(newNode));
-			frontierNodes.push(std::move(newNodeTracker));
+			const SearchNodeHandle node = frontierNodes.push(SearchNode{totalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentWorldIndex, loadedPosition, 0.0f});
+			visitedNodes.insert(VisitedZone{zoneIndex, node});
 		}
 
 		while(!frontierNodes.empty())
 		{
-			SearchNodeTracker currentNodeTracker = frontierNodes.popAndGet();
-			SearchNode* currentNode = currentNodeTracker.node;
+			//copied as visiting other zones adds nodes to frontierNodes which can move the nodes
+			const SearchNode currentNodeValue = frontierNodes[frontierNodes.pop()];
+			const SearchNode* const currentNode = &currentNodeValue;
 			while(currentNode->totalDistance > levelOfDetailMaxDistances[levelOfDetail])
 			{
 				++levelOfDetail;
@@ -204,32 +148,26 @@ private:
 			if(zoneX + 1u != sizeX) //move toward x
 			{
 				visitZone(zoneX + 1u, zoneY, zoneZ, zoneIndex + sizeY * sizeZ, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zoneX != 0u) //move toward -x
 			{
 				visitZone(zoneX - 1u, zoneY, zoneZ, zoneIndex - sizeY * sizeZ, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zoneY + 1 != sizeY) //move toward y
 			{
 				visitZone(zoneX, zoneY + 1u, zoneZ, zoneIndex + sizeZ, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zoneY != 0u) //move toward -y
 			{
 				visitZone(zoneX, zoneY - 1u, zoneZ, zoneIndex - sizeZ, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zoneZ + 1 != sizeZ) //move toward z
 			{
 				visitZone(zoneX, zoneY, zoneZ + 1u, zoneIndex + 1u, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zoneZ != 0u) //move toward -z
 			{
 				visitZone(zoneX, zoneY, zoneZ - 1u, zoneIndex - 1u, currentNode, visitedNodes, frontierNodes, maxTotalDistance);
-				currentNode = currentNodeTracker.node;
 			}
 			if(zone)
 			{
@@ -237,43 +175,50 @@ private:
 			}
 		}
 		visitedNodes.clear();
+		frontierNodes.clear();
 	}
 
-	static void visitZone(unsigned long zoneX, unsigned long zoneY, unsigned long zoneZ, unsigned long zoneIndex, SearchNode* currentNode,
-		HashSet<SearchNode, SearchNodeHasher, SearchNodeEqual>& visitedNodes,
-		PriorityQueue<SearchNodeTracker, ResizingArray<SearchNodeTracker>, SearchNodePriority>& frontierNodes,
-		float maxTotalDistance)
+	/*
+	Nodes that have been popped from frontierNodes aren't changed as their zone has already been loaded.
+	*/
+	static void visitNode(const SearchNode& newNode, HashSet<VisitedZone, VisitedZoneHasher, VisitedZoneEqual>& visitedNodes, SearchQueue& frontierNodes)
 	{
-		const float newTotalDistance = currentNode->distanceFromStartToAnchor + (Vector3{zoneX * zoneDiameter + zoneRadius, zoneY * zoneDiameter + zoneRadius, zoneZ * zoneDiameter + zoneRadius} - currentNode->anchor).length();
-		if(newTotalDistance > maxTotalDistance)
-		{
-			return;
-		}
-
-		auto element = visitedNodes.find(zoneIndex);
+		auto element = visitedNodes.find(newNode.zoneIndex);
 		if(element != visitedNodes.end())
 		{
-			if(element->totalDistance > newTotalDistance)
+			SearchNode& node = frontierNodes[element->node];
+			if(node.totalDistance > newNode.totalDistance && frontierNodes.isQueued(element->node))
 			{
-				element->totalDistance = newTotalDistance;
-				frontierNodes.priorityIncreased(*element->queueLocation);
+				node = newNode;
+				frontierNodes.priorityIncreased(element->node);
 			}
 		}
 		else
 		{
-			SearchNodeTracker newNodeTracker;
-			SearchNode newNode = {newTotalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentNode->worldIndex, currentNode->anchor, currentNode->distanceFromStartToAnchor, &newNodeTracker};
-			newNodeTracker.node = &newNode;
-			visitedNodes.insert(std::move(newNode));
-			frontierNodes.push(std::move(newNodeTracker));
+			visitedNodes.insert(VisitedZone{newNode.zoneIndex, frontierNodes.push(newNode)});
+		}
+	}
+
+	static void visitZone(unsigned long zoneX, unsigned long zoneY, unsigned long zoneZ, unsigned long zoneIndex, const SearchNode* currentNode,
+		HashSet<VisitedZone, VisitedZoneHasher, VisitedZoneEqual>& visitedNodes,
+		SearchQueue& frontierNodes,
+		float maxTotalDistance)
+	{
+		const float newTotalDistance = currentNode->distanceFromStartToAnchor + (Vector3{zoneX * zoneDiameter + zoneRadius, zoneY * zoneDiameter + zoneRadius, zoneZ * zoneDiameter + zoneRadius} - currentNode->anchor).length();
+		if(newTotalDistance > maxTotalDistance)
+		{
+			return;
 		}
+
+		visitNode(SearchNode{newTotalDistance, zoneX, zoneY, zoneZ, zoneIndex, currentNode->worldIndex, currentNode->anchor, currentNode->distanceFromStartToAnchor},
+			visitedNodes, frontierNodes);
 	}
 
-	static void visitPortals(SearchNode* currentNode,
+	static void visitPortals(const SearchNode* currentNode,
 		Zone<ThreadResources>* zones,
 		const World* worlds1,
-		HashSet<SearchNode, SearchNodeHasher, SearchNodeEqual>& visitedNodes,
-		PriorityQueue<SearchNodeTracker, ResizingArray<SearchNodeTracker>, SearchNodePriority>& frontierNodes,
+		HashSet<VisitedZone, VisitedZoneHasher, VisitedZoneEqual>& visitedNodes,
+		SearchQueue& frontierNodes,
 		float maxTotalDistance)
 	{
 		auto& zone = zones[currentNode->zoneIndex];
@@ -297,25 +242,8 @@ private:
 				continue;
 			}
 
-			auto element = visitedNodes.find(newZoneIndex);
-			if(element != visitedNodes.end())
-			{
-				if(element->totalDistance > newTotalDistance)
-				{
-					element->totalDistance = newTotalDistance;
-					element->anchor = newPosition;
-					element->distanceFromStartToAnchor = newDistanceFromStartToAnchor;
-					frontierNodes.priorityIncreased(*element->queueLocation);
-				}
-			}
-			else
-			{
-				SearchNodeTracker newNodeTracker;
-				SearchNode newNode = {newTotalDistance, newZoneX, newZoneY, newZoneZ, newZoneIndex, newWorldIndex, newPosition, newDistanceFromStartToAnchor, &newNodeTracker};
-				newNodeTracker.node = &newNode;
-				visitedNodes.insert(std::move(newNode));
-				frontierNodes.push(std::move(newNodeTracker));
-			}
+			visitNode(SearchNode{newTotalDistance, newZoneX, newZoneY, newZoneZ, newZoneIndex, newWorldIndex, newPosition, newDistanceFromStartToAnchor},
+				visitedNodes, frontierNodes);
 		}
 	}
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <atomic>
+#include "TaskCounter.h"
 #include <limits>
 #include "Range.h"
 #include "Portal.h"
@@ -71,18 +71,15 @@ public:
 	};
 	unsigned int highestSupportedState;
 private:
-	std::atomic<unsigned int> numComponentsLoaded = 0;
+	TaskCounter componentsLoaded;
 	WorldManagerStopRequest* stopRequest = nullptr;
 public:
 	void* context;
 
 	void componentUploaded(TaskShedular<ThreadResources>& taskShedular, unsigned int numComponents)
 	{
-		//uses memory_order_acq_rel because it needs to see all loaded parts if it's the last load job and release it's load job otherwise
-		auto oldNumComponentsLoaded = this->numComponentsLoaded.fetch_add(1u, std::memory_order_acq_rel);
-		if (oldNumComponentsLoaded == numComponents - 1u)
+		if (componentsLoaded.finished(numComponents))
 		{
-			this->numComponentsLoaded.store(0u, std::memory_order_relaxed);
 			finishedCreatingNewState(taskShedular);
 		}
 	}
@@ -277,7 +277,7 @@ namespace Cave
 			switch (zone.newState)
 			{
 			case 0u:
-				threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create });
+				threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create }, BackgroundPriority::low);
 				break;
 			}
 		}
@@ -296,7 +296,7 @@ namespace Cave
 					{
 						auto& zone = *static_cast<Zone<ThreadResources>*>(context);
 						HDResources::destruct(zone, threadResources);
-					} });
+					} }, BackgroundPriority::low);
 				});
 				break;
 			}
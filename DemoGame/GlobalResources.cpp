@@ -393,6 +393,7 @@ GlobalResources::GlobalResources(const unsigned int numberOfThreads, Window::Sta
 	readyToPresentEvent(nullptr, FALSE, FALSE, nullptr)
 {
 	areas.setPosition(playerPosition.location.position, 0u);
+	taskShedular.setFrameBudget(std::chrono::duration_cast<TaskShedular<ThreadResources>::Clock::duration>(std::chrono::duration<float>(timer.frameBudget())));
 	taskShedular.start(mainThreadResources);
 	ioCompletionQueue.start(mainThreadResources);
 	ambientMusic.start(mainThreadResources);
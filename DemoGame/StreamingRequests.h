@@ -153,7 +153,7 @@ private:
 		auto& request = static_cast<Request&>(request1);
 		request.loadingFinished(request, tr, textureDescriptor);
 		auto requests = request.requests;
-		if(requests->numberOfcomponentsLoaded.fetch_add(1u, std::memory_order::memory_order_acq_rel) == (numberOfComponents - 1u))
+		if(requests->numberOfcomponentsLoaded.fetch_add(1u, std::memory_order_acq_rel) == (numberOfComponents - 1u))
 		{
 			ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
 			requests->requestLoaders.~array();
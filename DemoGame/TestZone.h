@@ -285,7 +285,7 @@ public:
 		switch (zone.newState)
 		{
 		case 0u:
-			threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create });
+			threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create }, BackgroundPriority::low);
 			break;
 		}
 	}
@@ -304,7 +304,7 @@ public:
 				{
 					auto& zone = *static_cast<Zone<ThreadResources>*>(context);
 					HDResources::destruct(zone, threadResources);
-				} });
+				} }, BackgroundPriority::low);
 			});
 			break;
 		}
@@ -29,7 +29,7 @@ bool ThreadResources::endUpdate1(ThreadResources& threadResources, void* context
 		globalResources.beforeRender();
 	}
 
-	threadResources.taskShedular.endUpdate1(globalResources.taskShedular, endUpdate2);
+	threadResources.taskShedular.endPhase<0u>(globalResources.taskShedular, endUpdate2);
 
 	threadResources.renderPass.update1After(globalResources.graphicsEngine, globalResources.renderPass, globalResources.rootSignatures.rootSignature, primaryIndex);
 
@@ -54,7 +54,8 @@ void ThreadResources::mainEndUpdate2(ThreadResources& threadResources, void* con
 	threadResources.renderPass.present(primaryThreadCount, globalResources.graphicsEngine, globalResources.window, globalResources.renderPass);
 	bool shouldQuit = globalResources.update();
 
-	threadResources.taskShedular.endUpdate2Main(globalResources.taskShedular, shouldQuit ? GlobalResources::quit : endUpdate1);
+	threadResources.taskShedular.endFrameMain(globalResources.taskShedular, shouldQuit ? GlobalResources::quit : endUpdate1);
+	threadResources.frameArena.startFrame();
 	threadResources.streamingManager.update(globalResources.streamingManager, &threadResources);
 }
 
@@ -71,12 +72,14 @@ void ThreadResources::primaryEndUpdate2(ThreadResources& threadResources, void*
 		globalResources.readyToPresentCount.store(0u, std::memory_order_relaxed);
 	}
 
-	threadResources.taskShedular.endUpdate2Primary(globalResources.taskShedular);
+	threadResources.taskShedular.endFramePrimary(globalResources.taskShedular);
+	threadResources.frameArena.startFrame();
 	threadResources.streamingManager.update(globalResources.streamingManager, &threadResources);
 }
 
-static void backgroundPrepairForUpdate2(ThreadResources& threadResources, void* context)
+static void backgroundPrepairForPhase(ThreadResources& threadResources, void* context, std::size_t phaseIndex)
 {
+	if(phaseIndex != 1u) return;
 	GlobalResources& globalResources = *static_cast<GlobalResources*>(context);
 	threadResources.renderPass.update1After(globalResources.graphicsEngine, globalResources.renderPass, globalResources.rootSignatures.rootSignature, threadResources.taskShedular.primaryIndex());
 }
@@ -93,6 +96,7 @@ void ThreadResources::backgroundEndUpdate2(ThreadResources& threadResources, voi
 		globalResources.readyToPresentEvent.notify();
 		globalResources.readyToPresentCount.store(0u, std::memory_order_relaxed);
 	}
-	threadResources.taskShedular.endUpdate2Background<backgroundPrepairForUpdate2>(globalResources.taskShedular, threadResources, context);
+	threadResources.taskShedular.endFrameBackground<backgroundPrepairForPhase>(globalResources.taskShedular, threadResources, context);
+	threadResources.frameArena.startFrame();
 	threadResources.streamingManager.update(globalResources.streamingManager, &threadResources);
 }
\ No newline at end of file
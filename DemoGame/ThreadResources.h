@@ -5,6 +5,8 @@
 #include <frameBufferCount.h>
 #include <StreamingManager.h>
 #include <TaskShedular.h>
+#include <FrameArena.h>
+#include <CoroutineFramePool.h>
 #include "RenderPass1.h"
 class GlobalResources;
 #undef min
@@ -30,4 +32,6 @@ public:
 	pcg32 randomNumberGenerator;
 	StreamingManager::ThreadLocal streamingManager;
 	RenderPass1::Local renderPass;
+	FrameArena<frameBufferCount> frameArena; //moves to its next frame each time this thread finishes a frame
+	CoroutineFramePool coroutineFramePool;
 };
\ No newline at end of file
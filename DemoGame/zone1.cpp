@@ -898,10 +898,10 @@ namespace
 			switch (zone.newState)
 			{
 			case 0u:
-				threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create });
+				threadResources.taskShedular.pushBackgroundTask({ &zone, &HDResources::create }, BackgroundPriority::low);
 				break;
 			case 1u:
-				threadResources.taskShedular.pushBackgroundTask({ &zone, &MDResources::create });
+				threadResources.taskShedular.pushBackgroundTask({ &zone, &MDResources::create }, BackgroundPriority::low);
 				break;
 			}
 		}
@@ -929,8 +929,9 @@ namespace
 							{
 								RemoveReflectionCameraRequest& request = static_cast<RemoveReflectionCameraRequest&>(task);
 								auto& zone = request.zone;
-								GraphicsEngine& graphicsEngine = static_cast<GlobalResources*>(zone.context)->graphicsEngine;
-								request.camera.destruct(graphicsEngine);
+								auto& globalResources = *static_cast<GlobalResources*>(zone.context);
+								request.camera.destruct(globalResources.graphicsEngine);
+								globalResources.entityGenerator.recycle(request.entity);
 								delete &request;
 
 								ThreadResources& threadResources = *static_cast<ThreadResources*>(tr);
@@ -939,7 +940,7 @@ namespace
 									Zone<ThreadResources>& zone = *static_cast<Zone<ThreadResources>*>(context);
 									auto resource = static_cast<HDResources*>(zone.oldData);
 									resource->destruct(zone, threadResources);
-								} });
+								} }, BackgroundPriority::low);
 							};
 							graphicsEngine.executeWhenGpuFinishesCurrentFrame(request);
 						} });
@@ -960,7 +961,7 @@ namespace
 						auto& zone = *static_cast<Zone<ThreadResources>*>(context);
 						auto resource = static_cast<MDResources*>(zone.oldData);
 						resource->destruct(zone, threadResources);
-					} });
+					} }, BackgroundPriority::low);
 				});
 				break;
 			}